@@ -0,0 +1,48 @@
+//
+//  bench.h
+//  hash_table
+//
+//  Helpers shared by the benchmarks: a monotonic clock, a fast
+//  deterministic PRNG and latency percentiles.
+//
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+static inline uint64_t bench_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// xorshift64*, seeded per thread so runs are reproducible.
+static inline uint64_t bench_rand(uint64_t* state) {
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+static int bench_cmp_u64(const void* a, const void* b) {
+    const uint64_t x = *(const uint64_t*)a;
+    const uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Sorts `samples` in place and returns the `p`th percentile (0-100).
+static inline uint64_t bench_percentile(uint64_t* samples, const size_t n, const double p) {
+    if (n == 0) {
+        return 0;
+    }
+    qsort(samples, n, sizeof(uint64_t), bench_cmp_u64);
+    size_t i = (size_t)(p / 100.0 * (double)(n - 1) + 0.5);
+    return samples[i < n ? i : n - 1];
+}
+
+#endif  // BENCH_H_
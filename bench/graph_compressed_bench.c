@@ -0,0 +1,113 @@
+//
+//  graph_compressed_bench.c
+//  hash_table
+//
+//  Bytes per edge and traversal speed of the string-keyed edge tables,
+//  the float CSR and the compressed adjacency of graph_compressed.h on a
+//  large synthetic road grid, in bucket order and in Hilbert order
+//  (which keeps gaps between neighbour ids small).
+//
+//  usage: graph_compressed_bench [side] [sources]
+//
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/graph_compressed.h"
+#include "../include/graph_elements.h"
+#include "../include/graph_kernels.h"
+#include "../include/graph_reorder.h"
+#include "bench.h"
+#include "road_graph.h"
+
+static int num_sources = 4;
+
+static void report(const char* name, const size_t bytes, const int m, const uint64_t bfs_ns,
+                   const uint64_t sssp_ns) {
+    printf("%-18s %6.2f B/edge  bfs %7.2f ms (%6.1f M edges/s)  sssp %7.2f ms\n", name,
+           (double)bytes / m, bfs_ns / 1e6 / num_sources,
+           (double)m * num_sources / (bfs_ns / 1e3), sssp_ns / 1e6 / num_sources);
+}
+
+// Time BFS and Dijkstra from the same physical sources on the CSR and
+// on its compressed form.
+static void run(const char* order, gk_f32_dir_graph* g) {
+    const int n = g->csr.n;
+    int* hops = malloc(sizeof(int) * n);
+    float* dist = malloc(sizeof(float) * n);
+    int sources[64];
+    for (int s = 0; s < num_sources; s++) {
+        char key[24];
+        road_graph_key(key, s * (n / num_sources));
+        sources[s] = gk_vertex(&g->csr, key);
+    }
+    char name[32];
+
+    uint64_t t0 = bench_now_ns();
+    for (int s = 0; s < num_sources; s++) {
+        gk_f32_dir_bfs(g, sources[s], hops);
+    }
+    const uint64_t csr_bfs = bench_now_ns() - t0;
+    t0 = bench_now_ns();
+    for (int s = 0; s < num_sources; s++) {
+        gk_f32_dir_sssp(g, sources[s], dist);
+    }
+    const uint64_t csr_sssp = bench_now_ns() - t0;
+    snprintf(name, sizeof(name), "csr %s", order);
+    report(name, (n + 1) * sizeof(int) + g->csr.m * (sizeof(int) + sizeof(float)), g->csr.m,
+           csr_bfs, csr_sssp);
+
+    t0 = bench_now_ns();
+    gc_graph* c = gc_build(&g->csr, g->weights);
+    const uint64_t build = bench_now_ns() - t0;
+    if (c == NULL) {
+        exit(1);
+    }
+    t0 = bench_now_ns();
+    for (int s = 0; s < num_sources; s++) {
+        gc_bfs(c, sources[s], hops);
+    }
+    const uint64_t gc_bfs_ns = bench_now_ns() - t0;
+    t0 = bench_now_ns();
+    for (int s = 0; s < num_sources; s++) {
+        gc_sssp(c, sources[s], dist);
+    }
+    const uint64_t gc_sssp_ns = bench_now_ns() - t0;
+    snprintf(name, sizeof(name), "compressed %s", order);
+    report(name, gc_bytes(c), c->m, gc_bfs_ns, gc_sssp_ns);
+    printf("%-18s build %.1f ms, weight step %g\n", "", build / 1e6, c->weight_scale);
+    gc_free(c);
+    free(hops);
+    free(dist);
+}
+
+int main(int argc, char** argv) {
+    const int side = argc > 1 ? atoi(argv[1]) : 700;
+    if (argc > 2) {
+        num_sources = atoi(argv[2]) < 64 ? atoi(argv[2]) : 64;
+    }
+    graph* G = road_graph_grid(side, side, 13);
+#ifdef __SSSE3__
+    printf("*** road grid %dx%d, ssse3 decode\n", side, side);
+#else
+    printf("*** road grid %dx%d, scalar decode\n", side, side);
+#endif
+
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    run("bucket", g);
+    int* perm = gk_order_hilbert(&g->csr);
+    gk_permute(&g->csr, g->weights, sizeof(float), perm);
+    run("hilbert", g);
+    const int m = g->csr.m;
+    free(perm);
+    gk_f32_dir_free(g);
+
+    // The edge tables' footprint is what freeing them returns to malloc
+    const size_t before = mallinfo2().uordblks;
+    delete_edges(G->E);
+    printf("%-18s %6.2f B/edge\n", "hash tables", (double)(before - mallinfo2().uordblks) / m);
+    G->E = create_edges();
+    delete_graph(G);
+    return 0;
+}
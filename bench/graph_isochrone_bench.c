@@ -0,0 +1,86 @@
+//
+//  graph_isochrone_bench.c
+//  hash_table
+//
+//  Thread scaling of delta-stepping on a synthetic road grid: one-to-all
+//  searches from `sources` vertices and isochrones of `budget` metres
+//  from 50 times as many, at 1, 2, 4 and 8 threads, next to serial
+//  Dijkstra over the same CSR. Also shows how the bucket width trades
+//  repeated relaxations against rounds.
+//
+//  usage: graph_isochrone_bench [side] [sources] [budget]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/graph_elements.h"
+#include "../include/graph_isochrone.h"
+#include "../include/graph_kernels.h"
+#include "bench.h"
+#include "road_graph.h"
+
+static int num_sources = 8;
+static float budget = 2000;
+
+static void run(const gk_f32_dir_graph* g, const float delta, const int threads) {
+    gi_searcher* s = gi_new(g, delta, threads);
+    float* dist = malloc(sizeof(float) * g->csr.n);
+    uint64_t t0 = bench_now_ns();
+    for (int i = 0; i < num_sources; i++) {
+        gi_sssp(s, i * (g->csr.n / num_sources), dist);
+    }
+    const double sssp = (bench_now_ns() - t0) / 1e6 / num_sources;
+    const double relaxed = (double)s->relaxed / num_sources / g->csr.n;
+
+    const int num_isochrones = num_sources * 50;
+    long reached = 0;
+    gi_area iso;
+    t0 = bench_now_ns();
+    for (int i = 0; i < num_isochrones; i++) {
+        reached += gi_isochrone(s, (int)((long)i * g->csr.n / num_isochrones), budget, &iso);
+        gi_area_free(&iso);
+    }
+    const double elapsed = (bench_now_ns() - t0) / 1e9;
+    printf("delta %6.1f  %d threads  sssp %8.2f ms  %.2f relaxations/vertex"
+           "  isochrones %8.0f/s  (%ld nodes each)\n", s->delta, threads, sssp, relaxed,
+           num_isochrones / elapsed, reached / num_isochrones);
+    free(dist);
+    gi_del(s);
+}
+
+int main(int argc, char** argv) {
+    const int side = argc > 1 ? atoi(argv[1]) : 400;
+    if (argc > 2) {
+        num_sources = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        budget = (float)atof(argv[3]);
+    }
+    graph* G = road_graph_grid(side, side, 7);
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    printf("*** road grid %dx%d, %d sources, isochrones of %.0f m\n", side, side, num_sources,
+           budget);
+
+    float* dist = malloc(sizeof(float) * g->csr.n);
+    const uint64_t t0 = bench_now_ns();
+    for (int i = 0; i < num_sources; i++) {
+        gk_f32_dir_sssp(g, i * (g->csr.n / num_sources), dist);
+    }
+    printf("dijkstra                  sssp %8.2f ms\n",
+           (bench_now_ns() - t0) / 1e6 / num_sources);
+    free(dist);
+
+    const int threads[] = {1, 2, 4, 8};
+    for (int t = 0; t < 4; t++) {
+        run(g, 0, threads[t]);
+    }
+    const float deltas[] = {25, 400, 1600};
+    for (int d = 0; d < 3; d++) {
+        run(g, deltas[d], 1);
+    }
+
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    return 0;
+}
@@ -0,0 +1,135 @@
+//
+//  graph_kernels_bench.c
+//  hash_table
+//
+//  Storage size, BFS and shortest path time of every compile-time
+//  variant on a synthetic road grid, next to a BFS that walks the
+//  string-keyed `graph` tables directly.
+//
+//  usage: graph_kernels_bench [side] [sources]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/graph_elements.h"
+#include "../include/graph_kernels.h"
+#include "bench.h"
+#include "road_graph.h"
+
+static int num_sources = 8;
+
+// BFS straight over the hash tables, resolving every neighbour by key.
+static int table_bfs(graph* G, const char* src) {
+    nodes_table* N = G->N;
+    int* hops = malloc(sizeof(int) * N->size);
+    int* queue = malloc(sizeof(int) * N->count);
+    for (int i = 0; i < N->size; i++) {
+        hops[i] = -1;
+    }
+    int head = 0;
+    int tail = 0;
+    const int start = find_node_index(N, src);
+    hops[start] = 0;
+    queue[tail++] = start;
+    while (head < tail) {
+        const int u = queue[head++];
+        neighbours* ns = find_neighbours(G->E, N->nodes[u]->key);
+        if (ns == NULL) {
+            continue;
+        }
+        for (int j = 0; j < ns->size; j++) {
+            if (ns->neighbours[j] == NULL) {
+                continue;
+            }
+            const int v = find_node_index(N, ns->neighbours[j]->node);
+            if (hops[v] < 0) {
+                hops[v] = hops[u] + 1;
+                queue[tail++] = v;
+            }
+        }
+    }
+    free(hops);
+    free(queue);
+    return tail;
+}
+
+static void report(const char* name, const int n, const int m, const size_t weight_size,
+                   const uint64_t build_ns, const uint64_t bfs_ns, const uint64_t sssp_ns) {
+    const size_t bytes = (n + 1) * sizeof(int) + m * (sizeof(int) + weight_size);
+    printf("%-14s %6.2f B/edge  build %8.2f ms  bfs %7.2f ms", name,
+           (double)bytes / m, build_ns / 1e6, bfs_ns / 1e6 / num_sources);
+    if (sssp_ns > 0) {
+        printf("  sssp %7.2f ms", sssp_ns / 1e6 / num_sources);
+    }
+    printf("\n");
+}
+
+// Time build, BFS and (for weighted variants) SSSP of variant `name`.
+#define BENCH_UNWEIGHTED(name, G)                                           \
+    do {                                                                    \
+        uint64_t t0 = bench_now_ns();                                       \
+        name##_graph* g = name##_build(G);                                  \
+        const uint64_t build = bench_now_ns() - t0;                         \
+        int* hops = malloc(sizeof(int) * g->csr.n);                         \
+        t0 = bench_now_ns();                                                \
+        for (int s = 0; s < num_sources; s++) {                             \
+            name##_bfs(g, s * (g->csr.n / num_sources), hops);              \
+        }                                                                   \
+        report(#name, g->csr.n, g->csr.m, 0, build, bench_now_ns() - t0, 0); \
+        free(hops);                                                         \
+        name##_free(g);                                                     \
+    } while (0)
+
+#define BENCH_WEIGHTED(name, G)                                             \
+    do {                                                                    \
+        uint64_t t0 = bench_now_ns();                                       \
+        name##_graph* g = name##_build(G);                                  \
+        const uint64_t build = bench_now_ns() - t0;                         \
+        int* hops = malloc(sizeof(int) * g->csr.n);                         \
+        name##_dist* dist = malloc(sizeof(name##_dist) * g->csr.n);         \
+        t0 = bench_now_ns();                                                \
+        for (int s = 0; s < num_sources; s++) {                             \
+            name##_bfs(g, s * (g->csr.n / num_sources), hops);              \
+        }                                                                   \
+        const uint64_t bfs = bench_now_ns() - t0;                           \
+        t0 = bench_now_ns();                                                \
+        for (int s = 0; s < num_sources; s++) {                             \
+            name##_sssp(g, s * (g->csr.n / num_sources), dist);             \
+        }                                                                   \
+        report(#name, g->csr.n, g->csr.m, sizeof(name##_weight), build, bfs, \
+               bench_now_ns() - t0);                                        \
+        free(hops);                                                         \
+        free(dist);                                                         \
+        name##_free(g);                                                     \
+    } while (0)
+
+int main(int argc, char** argv) {
+    const int side = argc > 1 ? atoi(argv[1]) : 300;
+    if (argc > 2) {
+        num_sources = atoi(argv[2]);
+    }
+    uint64_t t0 = bench_now_ns();
+    graph* G = road_graph_grid(side, side, 7);
+    printf("*** road grid %dx%d built in %.1f ms\n", side, side, (bench_now_ns() - t0) / 1e6);
+    graph_stats_dump(G, stdout);
+
+    t0 = bench_now_ns();
+    for (int s = 0; s < num_sources; s++) {
+        char key[24];
+        road_graph_key(key, s * (side * side / num_sources));
+        table_bfs(G, key);
+    }
+    printf("%-14s %27s bfs %7.2f ms\n", "hash tables", "",
+           (bench_now_ns() - t0) / 1e6 / num_sources);
+
+    BENCH_UNWEIGHTED(gk_u_dir, G);
+    BENCH_UNWEIGHTED(gk_u_undir, G);
+    BENCH_WEIGHTED(gk_u32_dir, G);
+    BENCH_WEIGHTED(gk_u32_undir, G);
+    BENCH_WEIGHTED(gk_f32_dir, G);
+    BENCH_WEIGHTED(gk_f32_undir, G);
+
+    delete_graph(G);
+    return 0;
+}
@@ -0,0 +1,136 @@
+//
+//  graph_match_bench.c
+//  hash_table
+//
+//  Throughput of map matching on a synthetic road grid. Traces are
+//  random drives of `length` streets without u-turns, pinged every
+//  `spacing` metres with gaussian noise of `noise` metres. Each thread
+//  count matches the same batch twice: first with empty transition
+//  caches, then again with the caches warm. Accuracy is the share of
+//  pings matched to the street actually driven.
+//
+//  usage: graph_match_bench [side] [traces] [length] [spacing] [noise]
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/graph_elements.h"
+#include "../include/graph_kernels.h"
+#include "../include/graph_match.h"
+#include "bench.h"
+#include "road_graph.h"
+
+static double bench_gaussian(uint64_t* seed) {
+    const double u = (bench_rand(seed) % 1000000 + 1) / 1000001.0;
+    const double v = (bench_rand(seed) % 1000000) / 1000000.0;
+    return sqrt(-2 * log(u)) * cos(2 * M_PI * v);
+}
+
+// One random drive from a random vertex. Returns the number of pings.
+static int drive(const gk_f32_dir_graph* g, const int length, const float spacing,
+                 const float noise, uint64_t* seed, gm_point* points, int* truth) {
+    const gk_csr* csr = &g->csr;
+    int u = (int)(bench_rand(seed) % csr->n);
+    int from = -1;
+    int count = 0;
+    float carry = spacing / 2;
+    for (int s = 0; s < length; s++) {
+        const int degree = csr->offsets[u + 1] - csr->offsets[u];
+        if (degree == 0) {
+            break;
+        }
+        int e = csr->offsets[u] + (int)(bench_rand(seed) % degree);
+        if (csr->targets[e] == from && degree > 1) {
+            e = csr->offsets[u] + (e - csr->offsets[u] + 1) % degree;
+        }
+        const int v = csr->targets[e];
+        const gps* a = csr->nodes[u]->location;
+        const gps* b = csr->nodes[v]->location;
+        const float scale = cosf(*a->lat * (float)M_PI / 180);
+        float at = carry;
+        for (; at < g->weights[e]; at += spacing) {
+            const float f = at / g->weights[e];
+            points[count].lat = *a->lat + f * (*b->lat - *a->lat)
+                                + (float)(bench_gaussian(seed) * noise / 111320.0);
+            points[count].lon = *a->lon + f * (*b->lon - *a->lon)
+                                + (float)(bench_gaussian(seed) * noise / 111320.0 / scale);
+            truth[count++] = e;
+        }
+        carry = at - g->weights[e];
+        from = u;
+        u = v;
+    }
+    return count;
+}
+
+static void run(const gk_f32_dir_graph* g, const gm_trace* traces, const int num_traces,
+                int* const* truth, const int threads) {
+    gm_matcher* m = gm_new(g, 0, 0, 0, threads);
+    gm_result* results = malloc(sizeof(gm_result) * num_traces);
+    for (int pass = 0; pass < 2; pass++) {
+        const unsigned long hits = m->cache_hits;
+        const unsigned long misses = m->cache_misses;
+        const unsigned long points = m->points;
+        const uint64_t t0 = bench_now_ns();
+        gm_match_batch(m, traces, num_traces, results);
+        const double elapsed = (bench_now_ns() - t0) / 1e9;
+        long right = 0;
+        for (int i = 0; i < num_traces; i++) {
+            for (int t = 0; t < traces[i].count; t++) {
+                right += results[i].edges[t] == truth[i][t];
+            }
+            gm_result_free(&results[i]);
+        }
+        const unsigned long lookups = m->cache_hits - hits + m->cache_misses - misses;
+        printf("%d threads  %s  %8.0f traces/s  %9.0f points/s  accuracy %5.1f%%"
+               "  cache hits %5.1f%%\n", threads, pass ? "warm" : "cold", num_traces / elapsed,
+               (m->points - points) / elapsed, 100.0 * right / (m->points - points),
+               lookups ? 100.0 * (m->cache_hits - hits) / lookups : 0);
+    }
+    free(results);
+    gm_del(m);
+}
+
+int main(int argc, char** argv) {
+    const int side = argc > 1 ? atoi(argv[1]) : 200;
+    const int num_traces = argc > 2 ? atoi(argv[2]) : 2000;
+    const int length = argc > 3 ? atoi(argv[3]) : 20;
+    const float spacing = argc > 4 ? (float)atof(argv[4]) : 30;
+    const float noise = argc > 5 ? (float)atof(argv[5]) : 8;
+    graph* G = road_graph_grid(side, side, 7);
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    printf("*** road grid %dx%d, %d traces of %d streets, a ping every %.0f m, noise %.0f m\n",
+           side, side, num_traces, length, spacing, noise);
+
+    // Enough room for the longest streets, stretched by half
+    const int max_points = (int)(length * 300 / spacing) + 2;
+    gm_trace* traces = malloc(sizeof(gm_trace) * num_traces);
+    int** truth = malloc(sizeof(int*) * num_traces);
+    uint64_t seed = 42;
+    long total = 0;
+    for (int i = 0; i < num_traces; i++) {
+        gm_point* points = malloc(sizeof(gm_point) * max_points);
+        truth[i] = malloc(sizeof(int) * max_points);
+        traces[i].count = drive(g, length, spacing, noise, &seed, points, truth[i]);
+        traces[i].points = points;
+        total += traces[i].count;
+    }
+    printf("%.1f pings per trace\n", (double)total / num_traces);
+
+    const int threads[] = {1, 2, 4};
+    for (int t = 0; t < 3; t++) {
+        run(g, traces, num_traces, truth, threads[t]);
+    }
+
+    for (int i = 0; i < num_traces; i++) {
+        free((gm_point*)traces[i].points);
+        free(truth[i]);
+    }
+    free(traces);
+    free(truth);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    return 0;
+}
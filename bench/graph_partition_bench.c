@@ -0,0 +1,78 @@
+//
+//  graph_partition_bench.c
+//  hash_table
+//
+//  Edge cut of the k-d split before and after refinement at K = 2, 4
+//  and 8 partitions of a synthetic road grid, and the time of one-to-all
+//  searches run by a cluster of K worker processes against a single
+//  process Dijkstra over the same CSR. Supersteps and messages count
+//  the traffic through the coordinator.
+//
+//  usage: graph_partition_bench [side] [sources]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../include/graph_elements.h"
+#include "../include/graph_kernels.h"
+#include "../include/graph_partition.h"
+#include "bench.h"
+#include "road_graph.h"
+
+int main(int argc, char** argv) {
+    const int side = argc > 1 ? atoi(argv[1]) : 300;
+    const int num_sources = argc > 2 ? atoi(argv[2]) : 8;
+    graph* G = road_graph_grid(side, side, 7);
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    printf("*** road grid %dx%d, %d edges, %d sources\n", side, side, g->csr.m, num_sources);
+
+    char dir[] = "/tmp/graph_partition_bench.XXXXXX";
+    if (mkdtemp(dir) == NULL) {
+        return 1;
+    }
+    char prefix[64];
+    snprintf(prefix, sizeof(prefix), "%s/part", dir);
+
+    float* dist = malloc(sizeof(float) * g->csr.n);
+    uint64_t t0 = bench_now_ns();
+    for (int i = 0; i < num_sources; i++) {
+        gk_f32_dir_sssp(g, i * (g->csr.n / num_sources), dist);
+    }
+    printf("single process          sssp %8.2f ms\n", (bench_now_ns() - t0) / 1e6 / num_sources);
+
+    const int ks[] = {2, 4, 8};
+    for (int i = 0; i < 3; i++) {
+        const int k = ks[i];
+        int* kd = gp_partition(g, k, 0);
+        t0 = bench_now_ns();
+        int* part = gp_partition(g, k, 8);
+        const double partition = (bench_now_ns() - t0) / 1e6;
+        printf("K=%d  cut k-d %6ld  refined %6ld (%.2f%% of edges)  partition %.1f ms\n", k,
+               gp_edge_cut(&g->csr, kd), gp_edge_cut(&g->csr, part),
+               100.0 * gp_edge_cut(&g->csr, part) / g->csr.m, partition);
+        gp_write(g, part, k, prefix);
+        gp_cluster* c = gp_cluster_start(prefix, k);
+        t0 = bench_now_ns();
+        for (int s = 0; s < num_sources; s++) {
+            gp_cluster_sssp(c, s * (g->csr.n / num_sources), dist);
+        }
+        const double sssp = (bench_now_ns() - t0) / 1e6 / num_sources;
+        printf("     cluster sssp %8.2f ms  %5.1f supersteps  %7.0f messages per search\n", sssp,
+               (double)c->supersteps / num_sources, (double)c->messages / num_sources);
+        gp_cluster_stop(c);
+        for (int p = 0; p < k; p++) {
+            char path[96];
+            snprintf(path, sizeof(path), "%s.%d", prefix, p);
+            unlink(path);
+        }
+        free(kd);
+        free(part);
+    }
+    rmdir(dir);
+    free(dist);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    return 0;
+}
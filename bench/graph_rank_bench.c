@@ -0,0 +1,83 @@
+//
+//  graph_rank_bench.c
+//  hash_table
+//
+//  PageRank and sampled betweenness on a synthetic road grid at 1, 2, 4
+//  and 8 threads: time per power iteration and iterations to converge,
+//  then time per betweenness source and how far a sampled estimate of
+//  the top vertices is from a larger sample. Built twice, plain and
+//  with `-mavx2`, to compare scalar and gathered sums.
+//
+//  usage: graph_rank_bench [side] [samples]
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/graph_elements.h"
+#include "../include/graph_kernels.h"
+#include "../include/graph_rank.h"
+#include "bench.h"
+#include "road_graph.h"
+
+int main(int argc, char** argv) {
+    const int side = argc > 1 ? atoi(argv[1]) : 400;
+    const int samples = argc > 2 ? atoi(argv[2]) : 64;
+    graph* G = road_graph_grid(side, side, 7);
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    printf("*** road grid %dx%d, %d edges%s\n", side, side, g->csr.m,
+#ifdef __AVX2__
+           ", avx2"
+#else
+           ""
+#endif
+    );
+
+    float* rank = malloc(sizeof(float) * g->csr.n);
+    const int threads[] = {1, 2, 4, 8};
+    for (int t = 0; t < 4; t++) {
+        gr_ranker* r = gr_new(&g->csr, g->weights, threads[t]);
+        const uint64_t t0 = bench_now_ns();
+        const int iterations = gr_pagerank(r, 0, 0, 1000, rank);
+        const double elapsed = (bench_now_ns() - t0) / 1e6;
+        printf("pagerank     %d threads  %7.3f ms/iteration  %3d iterations  %8.2f ms\n",
+               threads[t], elapsed / iterations, iterations, elapsed);
+        gr_del(r);
+    }
+
+    // The reference is a sample four times larger
+    float* reference = malloc(sizeof(float) * g->csr.n);
+    float* scores = malloc(sizeof(float) * g->csr.n);
+    gr_ranker* r = gr_new(&g->csr, g->weights, 1);
+    gr_betweenness(r, samples * 4, 99, reference, NULL);
+    gr_del(r);
+    double top = 0;
+    for (int v = 0; v < g->csr.n; v++) {
+        top = fmax(top, reference[v]);
+    }
+    for (int t = 0; t < 4; t++) {
+        r = gr_new(&g->csr, g->weights, threads[t]);
+        const uint64_t t0 = bench_now_ns();
+        gr_betweenness(r, samples, 1, scores, NULL);
+        const double elapsed = (bench_now_ns() - t0) / 1e6;
+        double error = 0;
+        int num_top = 0;
+        for (int v = 0; v < g->csr.n; v++) {
+            if (reference[v] > top / 2) {
+                error += fabs(scores[v] - reference[v]) / reference[v];
+                num_top++;
+            }
+        }
+        printf("betweenness  %d threads  %7.3f ms/source  %3d sources  %8.2f ms"
+               "  %.1f%% off on the top %d\n", threads[t], elapsed / samples, samples, elapsed,
+               100 * error / num_top, num_top);
+        gr_del(r);
+    }
+    free(rank);
+    free(reference);
+    free(scores);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    return 0;
+}
@@ -0,0 +1,104 @@
+//
+//  graph_reorder_bench.c
+//  hash_table
+//
+//  Traversal time on a large synthetic road grid with vertices in
+//  `nodes_table` bucket order, Hilbert order and reverse Cuthill-McKee
+//  order: BFS, Dijkstra and a sweep pulling one value per neighbour.
+//
+//  usage: graph_reorder_bench [side] [sources]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/graph_elements.h"
+#include "../include/graph_kernels.h"
+#include "../include/graph_reorder.h"
+#include "bench.h"
+#include "road_graph.h"
+
+static int num_sources = 4;
+
+static void run(const char* name, gk_f32_dir_graph* g) {
+    const int n = g->csr.n;
+    int* hops = malloc(sizeof(int) * n);
+    float* dist = malloc(sizeof(float) * n);
+    float* value = malloc(sizeof(float) * n);
+    for (int v = 0; v < n; v++) {
+        value[v] = (float)(v % 7);
+    }
+    // The same physical sources in every order
+    int sources[64];
+    for (int s = 0; s < num_sources; s++) {
+        char key[24];
+        road_graph_key(key, s * (n / num_sources));
+        sources[s] = gk_vertex(&g->csr, key);
+    }
+
+    uint64_t t0 = bench_now_ns();
+    for (int s = 0; s < num_sources; s++) {
+        gk_f32_dir_bfs(g, sources[s], hops);
+    }
+    const uint64_t bfs = bench_now_ns() - t0;
+
+    t0 = bench_now_ns();
+    for (int s = 0; s < num_sources; s++) {
+        gk_f32_dir_sssp(g, sources[s], dist);
+    }
+    const uint64_t sssp = bench_now_ns() - t0;
+
+    t0 = bench_now_ns();
+    float total = 0;
+    for (int rep = 0; rep < num_sources; rep++) {
+        for (int v = 0; v < n; v++) {
+            float acc = 0;
+            for (int e = g->csr.offsets[v]; e < g->csr.offsets[v + 1]; e++) {
+                acc += value[g->csr.targets[e]];
+            }
+            dist[v] = acc;
+        }
+        total += dist[rep];
+    }
+    const uint64_t sweep = bench_now_ns() - t0;
+
+    printf("%-8s bandwidth %10.1f  bfs %7.2f ms  sssp %7.2f ms  sweep %6.2f ms (%g)\n",
+           name, gk_bandwidth(&g->csr), bfs / 1e6 / num_sources,
+           sssp / 1e6 / num_sources, sweep / 1e6 / num_sources, total);
+    free(hops);
+    free(dist);
+    free(value);
+}
+
+int main(int argc, char** argv) {
+    const int side = argc > 1 ? atoi(argv[1]) : 700;
+    if (argc > 2) {
+        num_sources = atoi(argv[2]) < 64 ? atoi(argv[2]) : 64;
+    }
+    graph* G = road_graph_grid(side, side, 11);
+    printf("*** road grid %dx%d\n", side, side);
+
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    run("bucket", g);
+
+    uint64_t t0 = bench_now_ns();
+    int* perm = gk_order_hilbert(&g->csr);
+    gk_permute(&g->csr, g->weights, sizeof(float), perm);
+    const uint64_t hilbert_ns = bench_now_ns() - t0;
+    run("hilbert", g);
+    free(perm);
+    gk_f32_dir_free(g);
+
+    g = gk_f32_dir_build(G);
+    t0 = bench_now_ns();
+    perm = gk_order_rcm(&g->csr);
+    gk_permute(&g->csr, g->weights, sizeof(float), perm);
+    const uint64_t rcm_ns = bench_now_ns() - t0;
+    run("rcm", g);
+    free(perm);
+    gk_f32_dir_free(g);
+
+    printf("relabel + relayout: hilbert %.1f ms, rcm %.1f ms\n", hilbert_ns / 1e6, rcm_ns / 1e6);
+    delete_graph(G);
+    return 0;
+}
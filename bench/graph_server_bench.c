@@ -0,0 +1,221 @@
+//
+//  graph_server_bench.c
+//  hash_table
+//
+//  Load generator for graph_server.h. Starts a server over a synthetic
+//  road grid and a table of `side` x `side` keys, then runs closed-loop
+//  clients that each keep `depth` requests in flight on their own
+//  connection, for pipeline depths 1, 16 and 128. Requests are table
+//  lookups, node locations and a share of short routes between
+//  intersections at most 10 blocks apart. Reports throughput and
+//  latency percentiles per depth.
+//
+//  usage: graph_server_bench [side] [seconds] [connections] [workers] [route %]
+//
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/graph_elements.h"
+#include "../include/graph_kernels.h"
+#include "../include/graph_server.h"
+#include "../include/hash_table.h"
+#include "bench.h"
+#include "road_graph.h"
+
+#define MAX_SAMPLES 1000000
+#define REQUEST_BYTES (sizeof(gs_header) + GS_MAX_PAYLOAD)
+
+static const char* socket_path;
+static int side = 200;
+static int depth;
+static int route_percent = 1;
+static atomic_int stop;
+
+typedef struct {
+    long id;
+    uint64_t* samples;
+    size_t count;
+    unsigned long completed;
+    unsigned long errors;
+} client_args;
+
+static size_t put_request(char* buf, const uint32_t id, const int op, const char* key,
+                          const char* other) {
+    const size_t len = gs_put_request(buf, id, op, key, other);
+    if (len == 0) {
+        fprintf(stderr, "key too long for a request: %s\n", key);
+        exit(1);
+    }
+    return len;
+}
+
+static size_t put_random_request(char* buf, const uint32_t id, uint64_t* seed) {
+    char key[24];
+    char other[24];
+    const int kind = bench_rand(seed) % 100;
+    const int i = bench_rand(seed) % (side * side);
+    if (kind < route_percent) {
+        const int x = i % side + (int)(bench_rand(seed) % 21) - 10;
+        const int y = i / side + (int)(bench_rand(seed) % 21) - 10;
+        const int j = (y < 0 ? 0 : y >= side ? side - 1 : y) * side
+                      + (x < 0 ? 0 : x >= side ? side - 1 : x);
+        road_graph_key(key, i);
+        road_graph_key(other, j);
+        return put_request(buf, id, GS_ROUTE, key, other);
+    }
+    if (kind < route_percent + 10) {
+        road_graph_key(key, i);
+        return put_request(buf, id, GS_NODE, key, NULL);
+    }
+    snprintf(key, sizeof(key), "k%d", i);
+    return put_request(buf, id, GS_GET, key, NULL);
+}
+
+static int write_all(const int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        const ssize_t n = write(fd, buf, len);
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Closed loop: every response completes the request in its window slot
+// (`id % depth`) and is replaced by a fresh request in the same slot.
+static void* client(void* arg) {
+    client_args* c = arg;
+    uint64_t seed = 31 + c->id;
+    const int fd = gs_connect(socket_path);
+    uint64_t* sent = malloc(sizeof(uint64_t) * depth);
+    char* out = malloc(REQUEST_BYTES * depth);
+    const size_t in_cap = 1 << 20;
+    char* in = malloc(in_cap);
+    size_t out_len = 0;
+    for (int slot = 0; slot < depth; slot++) {
+        out_len += put_random_request(out + out_len, slot, &seed);
+        sent[slot] = bench_now_ns();
+    }
+    size_t have = 0;
+    while (!atomic_load(&stop)) {
+        if (write_all(fd, out, out_len) < 0) {
+            break;
+        }
+        out_len = 0;
+        const ssize_t n = read(fd, in + have, in_cap - have);
+        if (n <= 0) {
+            break;
+        }
+        have += (size_t)n;
+        size_t at = 0;
+        const uint64_t now = bench_now_ns();
+        gs_header h;
+        while (have - at >= sizeof(h)) {
+            memcpy(&h, in + at, sizeof(h));
+            if (have - at - sizeof(h) < h.len) {
+                break;
+            }
+            at += sizeof(h) + h.len;
+            const int slot = h.id % depth;
+            if (c->count < MAX_SAMPLES) {
+                c->samples[c->count++] = now - sent[slot];
+            }
+            c->completed++;
+            c->errors += h.code == GS_BAD_REQUEST;
+            out_len += put_random_request(out + out_len, h.id + depth, &seed);
+            sent[slot] = now;
+        }
+        memmove(in, in + at, have - at);
+        have -= at;
+    }
+    close(fd);
+    free(sent);
+    free(out);
+    free(in);
+    return NULL;
+}
+
+static void run(const int connections, const double seconds) {
+    atomic_store(&stop, 0);
+    pthread_t* tids = malloc(sizeof(pthread_t) * connections);
+    client_args* args = calloc(connections, sizeof(client_args));
+    const uint64_t start = bench_now_ns();
+    for (long i = 0; i < connections; i++) {
+        args[i].id = i;
+        args[i].samples = malloc(sizeof(uint64_t) * MAX_SAMPLES);
+        pthread_create(&tids[i], NULL, client, &args[i]);
+    }
+    const struct timespec wait = {(time_t)seconds, (long)((seconds - (long)seconds) * 1e9)};
+    nanosleep(&wait, NULL);
+    atomic_store(&stop, 1);
+    uint64_t* all = malloc(sizeof(uint64_t) * MAX_SAMPLES * connections);
+    size_t total = 0;
+    unsigned long completed = 0;
+    unsigned long errors = 0;
+    for (int i = 0; i < connections; i++) {
+        pthread_join(tids[i], NULL);
+        memcpy(all + total, args[i].samples, sizeof(uint64_t) * args[i].count);
+        total += args[i].count;
+        completed += args[i].completed;
+        errors += args[i].errors;
+        free(args[i].samples);
+    }
+    const double elapsed = (bench_now_ns() - start) / 1e9;
+    printf("depth %4d  %9.0f req/s  p50 %8.1f us  p99 %8.1f us  p999 %8.1f us  errors %lu\n",
+           depth, completed / elapsed, bench_percentile(all, total, 50) / 1e3,
+           bench_percentile(all, total, 99) / 1e3, bench_percentile(all, total, 99.9) / 1e3,
+           errors);
+    free(all);
+    free(args);
+    free(tids);
+}
+
+int main(int argc, char** argv) {
+    side = argc > 1 ? atoi(argv[1]) : 200;
+    const double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+    const int connections = argc > 3 ? atoi(argv[3]) : 4;
+    const int workers = argc > 4 ? atoi(argv[4]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (argc > 5) {
+        route_percent = atoi(argv[5]);
+    }
+
+    graph* G = road_graph_grid(side, side, 5);
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    ht_hash_table* table = ht_new();
+    for (int i = 0; i < side * side; i++) {
+        char key[24];
+        char value[32];
+        snprintf(key, sizeof(key), "k%d", i);
+        snprintf(value, sizeof(value), "value %d", i);
+        ht_insert(table, key, value);
+    }
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/graph_server_bench.%d.sock", (int)getpid());
+    socket_path = path;
+    gs_server* s = gs_server_new(socket_path, table, g);
+    if (s == NULL) {
+        return 1;
+    }
+    gs_server_start(s, workers);
+    printf("*** road grid %dx%d, %d connections, %d workers, %d%% routes, %.1f s per run\n",
+           side, side, connections, workers, route_percent, seconds);
+
+    const int depths[] = {1, 16, 128};
+    for (int i = 0; i < 3; i++) {
+        depth = depths[i];
+        run(connections, seconds);
+    }
+
+    gs_server_del(s);
+    ht_del_hash_table(table);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    return 0;
+}
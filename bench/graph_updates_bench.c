@@ -0,0 +1,164 @@
+//
+//  graph_updates_bench.c
+//  hash_table
+//
+//  Update throughput and reader latency while edge weights change under
+//  running shortest-path queries. Compares the versioned pipeline of
+//  graph_updates.h with in-place updates of one weight array behind a
+//  reader/writer lock.
+//
+//  Updates are offered at a fixed rate in 1 ms ticks so both schemes see
+//  the same write load; a rate of 0 pushes as fast as possible.
+//
+//  usage: graph_updates_bench [side] [seconds] [readers] [updates/s]
+//
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/graph_kernels.h"
+#include "../include/graph_updates.h"
+#include "bench.h"
+#include "road_graph.h"
+
+#define MAX_SAMPLES 100000
+
+static gu_graph* live;
+static gk_f32_dir_graph* shared;
+static pthread_rwlock_t shared_lock = PTHREAD_RWLOCK_INITIALIZER;
+static atomic_int stop;
+static atomic_ulong updates;
+static long rate = 100000;
+
+typedef struct {
+    long id;
+    uint64_t* samples;
+    int count;
+} reader_args;
+
+static void random_edge(const gk_csr* csr, uint64_t* seed, int* src, int* dst, int* e) {
+    do {
+        *src = bench_rand(seed) % csr->n;
+    } while (csr->offsets[*src] == csr->offsets[*src + 1]);
+    const int degree = csr->offsets[*src + 1] - csr->offsets[*src];
+    *e = csr->offsets[*src] + bench_rand(seed) % degree;
+    *dst = csr->targets[*e];
+}
+
+static void* producer(void* arg) {
+    uint64_t seed = 99 + (uintptr_t)arg;
+    const gk_csr* csr = live ? &live->topology : &shared->csr;
+    const struct timespec tick = {0, 1000000};
+    long sent = 0;
+    while (!atomic_load(&stop)) {
+        if (rate > 0 && ++sent % (rate / 1000 + 1) == 0) {
+            nanosleep(&tick, NULL);
+        }
+        int src, dst, e;
+        random_edge(csr, &seed, &src, &dst, &e);
+        const float weight = 10.0f + bench_rand(&seed) % 90;
+        if (live) {
+            if (gu_enqueue(live, src, dst, weight) != 0) {
+                sched_yield();
+                continue;
+            }
+        } else {
+            pthread_rwlock_wrlock(&shared_lock);
+            shared->weights[e] = weight;
+            pthread_rwlock_unlock(&shared_lock);
+            atomic_fetch_add(&updates, 1);
+        }
+    }
+    return NULL;
+}
+
+static void* reader(void* arg) {
+    reader_args* r = arg;
+    uint64_t seed = 7 + r->id;
+    const int slot = live ? gu_register_reader(live) : -1;
+    const int n = live ? live->topology.n : shared->csr.n;
+    float* dist = malloc(sizeof(float) * n);
+    while (!atomic_load(&stop) && r->count < MAX_SAMPLES) {
+        const int src = bench_rand(&seed) % n;
+        const uint64_t t0 = bench_now_ns();
+        if (live) {
+            const gk_f32_dir_graph* g = gu_read_begin(live, slot);
+            gk_f32_dir_sssp(g, src, dist);
+            gu_read_end(live, slot);
+        } else {
+            pthread_rwlock_rdlock(&shared_lock);
+            gk_f32_dir_sssp(shared, src, dist);
+            pthread_rwlock_unlock(&shared_lock);
+        }
+        r->samples[r->count++] = bench_now_ns() - t0;
+    }
+    free(dist);
+    return NULL;
+}
+
+static void run(const char* name, const double seconds, const int readers) {
+    atomic_store(&stop, 0);
+    atomic_store(&updates, 0);
+    pthread_t writer;
+    pthread_t* tids = malloc(sizeof(pthread_t) * readers);
+    reader_args* args = calloc(readers, sizeof(reader_args));
+    const uint64_t start = bench_now_ns();
+    pthread_create(&writer, NULL, producer, NULL);
+    for (long i = 0; i < readers; i++) {
+        args[i].id = i;
+        args[i].samples = malloc(sizeof(uint64_t) * MAX_SAMPLES);
+        pthread_create(&tids[i], NULL, reader, &args[i]);
+    }
+    const struct timespec wait = {(time_t)seconds, (long)((seconds - (long)seconds) * 1e9)};
+    nanosleep(&wait, NULL);
+    atomic_store(&stop, 1);
+    pthread_join(writer, NULL);
+    uint64_t* all = malloc(sizeof(uint64_t) * MAX_SAMPLES * readers);
+    size_t total = 0;
+    for (int i = 0; i < readers; i++) {
+        pthread_join(tids[i], NULL);
+        for (int j = 0; j < args[i].count; j++) {
+            all[total++] = args[i].samples[j];
+        }
+        free(args[i].samples);
+    }
+    const double elapsed = (bench_now_ns() - start) / 1e9;
+    const unsigned long applied = live ? live->applied : atomic_load(&updates);
+    printf("%-9s updates %9.0f/s  queries %6zu  p50 %7.2f ms  p99 %7.2f ms  max %7.2f ms",
+           name, applied / elapsed, total, bench_percentile(all, total, 50) / 1e6,
+           bench_percentile(all, total, 99) / 1e6, bench_percentile(all, total, 100) / 1e6);
+    if (live) {
+        printf("  versions %lu reclaimed %lu", live->versions, live->reclaimed);
+    }
+    printf("\n");
+    free(all);
+    free(args);
+    free(tids);
+}
+
+int main(int argc, char** argv) {
+    const int side = argc > 1 ? atoi(argv[1]) : 200;
+    const double seconds = argc > 2 ? atof(argv[2]) : 2.0;
+    const int readers = argc > 3 ? atoi(argv[3]) : 2;
+    if (argc > 4) {
+        rate = atol(argv[4]);
+    }
+    graph* G = road_graph_grid(side, side, 3);
+    printf("*** road grid %dx%d, %d readers, %.1f s per run, %ld updates/s offered\n",
+           side, side, readers, seconds, rate);
+
+    shared = gk_f32_dir_build(G);
+    run("rwlock", seconds, readers);
+    gk_f32_dir_free(shared);
+
+    live = gu_new(gk_f32_dir_build(G), 1 << 16);
+    gu_start_applier(live, 1 << 14);
+    run("versioned", seconds, readers);
+    gu_del(live);
+
+    delete_graph(G);
+    return 0;
+}
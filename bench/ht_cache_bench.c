@@ -0,0 +1,123 @@
+//
+//  ht_cache_bench.c
+//  hash_table
+//
+//  Read-through cache on Zipfian key traces: every request searches the
+//  table and inserts the key on a miss. Compares cache mode against
+//  bounding a plain table by dropping it whenever it outgrows the
+//  budget, for budgets of 1%, 5% and 10% of the keyspace. The second
+//  trace mixes in sequential scans over keys that are never requested
+//  again, one request in `scan %`.
+//
+//  usage: ht_cache_bench [keys] [requests] [zipf s] [scan %]
+//
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/hash_table.h"
+#include "bench.h"
+
+static int num_keys = 1000000;
+static int num_requests = 5000000;
+static double zipf_s = 0.99;
+static int scan_percent = 20;
+
+// Key ids drawn from a Zipf distribution by binary search over its CDF.
+// Ranks are scattered over the id space so popularity does not follow
+// insertion order. Scan requests get ids past `num_keys`, each used once.
+static int* make_trace(const int scans) {
+    double* cdf = malloc(sizeof(double) * num_keys);
+    double sum = 0;
+    for (int i = 0; i < num_keys; i++) {
+        sum += 1.0 / pow(i + 1, zipf_s);
+        cdf[i] = sum;
+    }
+    int* trace = malloc(sizeof(int) * num_requests);
+    uint64_t seed = 23;
+    int next_scan = num_keys;
+    for (int r = 0; r < num_requests; r++) {
+        if (scans && (int)(bench_rand(&seed) % 100) < scan_percent) {
+            trace[r] = next_scan++;
+            continue;
+        }
+        const double u = (bench_rand(&seed) >> 11) * (1.0 / 9007199254740992.0) * sum;
+        int lo = 0;
+        int hi = num_keys - 1;
+        while (lo < hi) {
+            const int mid = (lo + hi) / 2;
+            if (cdf[mid] < u) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        trace[r] = (int)(((uint64_t)lo * 2654435761ULL) % (uint64_t)num_keys);
+    }
+    free(cdf);
+    return trace;
+}
+
+static void run(const char* name, const int* trace, const size_t budget, const int cache) {
+    ht_hash_table* ht = ht_new();
+    if (cache) {
+        ht_enable_cache(ht, budget, 0);
+    }
+    unsigned long hits = 0;
+    unsigned long flushes = 0;
+    char key[24];
+    const uint64_t t0 = bench_now_ns();
+    for (int r = 0; r < num_requests; r++) {
+        snprintf(key, sizeof(key), "obj:%d", trace[r]);
+        if (ht_search(ht, key) != NULL) {
+            hits++;
+            continue;
+        }
+        if (!cache && (size_t)ht->count >= budget) {
+            ht_del_hash_table(ht);
+            ht = ht_new();
+            flushes++;
+        }
+        ht_insert(ht, key, "value");
+    }
+    const uint64_t elapsed = bench_now_ns() - t0;
+    printf("%-6s %-5s budget %7zu  hit ratio %6.2f%%  %6.1f ns/request", name,
+           cache ? "clock" : "flush", budget, 100.0 * hits / num_requests,
+           (double)elapsed / num_requests);
+    if (cache) {
+        printf("  evictions %lu\n", ht->cache->evictions);
+    } else {
+        printf("  flushes %lu\n", flushes);
+    }
+    ht_del_hash_table(ht);
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        num_keys = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        num_requests = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        zipf_s = atof(argv[3]);
+    }
+    if (argc > 4) {
+        scan_percent = atoi(argv[4]);
+    }
+    printf("*** %d keys, %d requests, zipf s %.2f, %d%% scans in the second trace\n",
+           num_keys, num_requests, zipf_s, scan_percent);
+    const char* names[] = {"zipf", "+scan"};
+    const int percents[] = {1, 5, 10};
+    for (int t = 0; t < 2; t++) {
+        int* trace = make_trace(t);
+        for (int p = 0; p < 3; p++) {
+            const size_t budget = (size_t)num_keys * percents[p] / 100;
+            run(names[t], trace, budget, 0);
+            run(names[t], trace, budget, 1);
+        }
+        free(trace);
+    }
+    return 0;
+}
@@ -0,0 +1,130 @@
+//
+//  ht_filter_bench.c
+//  hash_table
+//
+//  Miss-heavy lookups against a table with and without its membership
+//  filter, at several filter sizes. Each lookup has a `miss %` chance
+//  of asking for a key that was never inserted. A share of the keys is
+//  deleted after loading, so misses also walk over tombstones. The
+//  first row searches by recomputing both string hashes at every probe
+//  through `ht_hash`, as `ht_search` used to.
+//
+//  usage: ht_filter_bench [keys] [lookups] [miss %] [deleted %]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/hash_table.h"
+#include "bench.h"
+
+static int num_keys = 1000000;
+static int num_lookups = 2000000;
+static int miss_percent = 90;
+static int deleted_percent = 20;
+
+// `ht_search` before probe sequences were hashed once per lookup.
+static char* search_rehash(ht_hash_table* ht, const char* key) {
+    int i = 0;
+    ht_item* item = ht->items[ht_hash(key, ht->size, i)];
+    while (item != NULL) {
+        if (item->key != NULL && strcmp(item->key, key) == 0) {
+            return item->value;
+        }
+        item = ht->items[ht_hash(key, ht->size, ++i)];
+    }
+    return NULL;
+}
+
+static void key_of(char* buf, const int i) {
+    snprintf(buf, 24, "user:%d", i);
+}
+
+static ht_hash_table* load() {
+    ht_hash_table* ht = ht_new();
+    char key[24];
+    for (int i = 0; i < num_keys; i++) {
+        key_of(key, i);
+        ht_insert(ht, key, "value");
+    }
+    // Deleting every k-th key leaves tombstones but no resize down
+    const int every = deleted_percent > 0 ? 100 / deleted_percent : 0;
+    for (int i = 0; every > 0 && i < num_keys; i += every) {
+        key_of(key, i);
+        ht_delete(ht, key);
+    }
+    return ht;
+}
+
+// Lookups are generated up front so only the searches are timed.
+static char (*make_lookups())[24] {
+    char (*keys)[24] = malloc((size_t)num_lookups * 24);
+    uint64_t seed = 17;
+    for (int i = 0; i < num_lookups; i++) {
+        const int r = bench_rand(&seed) % num_keys;
+        const int miss = (int)(bench_rand(&seed) % 100) < miss_percent;
+        key_of(keys[i], miss ? num_keys + r : r);
+    }
+    return keys;
+}
+
+static void run(const char* name, ht_hash_table* ht, char (*keys)[24], const int rehash) {
+    int found = 0;
+    const uint64_t t0 = bench_now_ns();
+    for (int i = 0; i < num_lookups; i++) {
+        found += (rehash ? search_rehash(ht, keys[i]) : ht_search(ht, keys[i])) != NULL;
+    }
+    const uint64_t elapsed = bench_now_ns() - t0;
+    printf("%-12s %7.1f ns/lookup  found %d", name, (double)elapsed / num_lookups, found);
+    if (ht->filter != NULL) {
+        // False positives among keys known to be absent
+        int positives = 0;
+        int misses = 0;
+        char key[24];
+        for (int i = 0; i < 100000; i++) {
+            key_of(key, 2 * num_keys + i);
+            positives += ht_filter_may_contain(ht->filter, ht_hash64(key));
+            misses++;
+        }
+        printf("  filter %6.2f MB  fpr %6.3f%%", ht_filter_bytes(ht->filter) / 1e6,
+               100.0 * positives / misses);
+    }
+    printf("\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        num_keys = atoi(argv[1]);
+    }
+    if (argc > 2) {
+        num_lookups = atoi(argv[2]);
+    }
+    if (argc > 3) {
+        miss_percent = atoi(argv[3]);
+    }
+    if (argc > 4) {
+        deleted_percent = atoi(argv[4]);
+    }
+    ht_hash_table* ht = load();
+    char (*keys)[24] = make_lookups();
+    printf("*** %d keys (%d%% deleted), %d lookups, %d%% misses\n", num_keys, deleted_percent,
+           num_lookups, miss_percent);
+    ht_stats_dump(ht, stdout);
+
+    run("rehash", ht, keys, 1);
+    run("no filter", ht, keys, 0);
+    const int bits[] = {4, 8, 12, 16};
+    for (int b = 0; b < 4; b++) {
+        char name[24];
+        snprintf(name, sizeof(name), "%d bits/key", bits[b]);
+        const uint64_t t0 = bench_now_ns();
+        ht_enable_filter(ht, bits[b]);
+        const uint64_t build = bench_now_ns() - t0;
+        run(name, ht, keys, 0);
+        printf("%-12s build %.1f ms\n", "", build / 1e6);
+    }
+    free(keys);
+    ht_del_hash_table(ht);
+    return 0;
+}
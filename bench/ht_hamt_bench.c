@@ -0,0 +1,146 @@
+//
+//  ht_hamt_bench.c
+//  hash_table
+//
+//  Persistent map against the open-addressing table. Reports fill time,
+//  the cost of taking a snapshot (a full copy of the table, which is
+//  the only way to freeze `ht_hash_table`), the cost of updates with a
+//  snapshot taken every `interval` of them, and random lookups of
+//  present and absent keys.
+//
+//  usage: ht_hamt_bench [keys] [lookups]
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/hash_table.h"
+#include "../include/ht_hamt.h"
+#include "bench.h"
+
+static int num_keys = 1000000;
+static int num_lookups = 2000000;
+
+static ht_hash_table* copy_table(ht_hash_table* ht) {
+    ht_hash_table* copy = ht_new_capacity(ht->count);
+    for (int i = 0; i < ht->size; i++) {
+        ht_item* item = ht->items[i];
+        if (item != NULL && !ht_is_deleted(item)) {
+            ht_insert(copy, item->key, item->value);
+        }
+    }
+    return copy;
+}
+
+static double lookup_ns(ht_hash_table* ht, ht_hamt* h, char (*keys)[16], long* found) {
+    *found = 0;
+    const uint64_t start = bench_now_ns();
+    for (int i = 0; i < num_lookups; i++) {
+        *found += (ht ? ht_search(ht, keys[i]) : ht_hamt_search(h, keys[i])) != NULL;
+    }
+    return (double)(bench_now_ns() - start) / num_lookups;
+}
+
+// `updates` overwrites of random keys, with a snapshot taken and kept
+// every `interval` of them. Snapshots are dropped at the end, and
+// their cost counted.
+static void bench_updates(ht_hash_table* ht, ht_hamt* h, const int updates, const int interval) {
+    const int num_snapshots = interval ? updates / interval : 0;
+    void** snapshots = malloc((num_snapshots + 1) * sizeof(void*));
+    uint64_t seed = 7;
+    int taken = 0;
+    const uint64_t start = bench_now_ns();
+    for (int i = 0; i < updates; i++) {
+        if (interval && i % interval == 0) {
+            snapshots[taken++] = ht ? (void*)copy_table(ht) : (void*)ht_hamt_snapshot(h);
+        }
+        char key[16];
+        snprintf(key, 16, "k%d", (int)(bench_rand(&seed) % num_keys));
+        if (ht) {
+            ht_insert(ht, key, "updated");
+        } else {
+            ht_hamt_insert(h, key, "updated");
+        }
+    }
+    for (int i = 0; i < taken; i++) {
+        if (ht) {
+            ht_del_hash_table(snapshots[i]);
+        } else {
+            ht_hamt_del(snapshots[i]);
+        }
+    }
+    const double ns = (double)(bench_now_ns() - start) / updates;
+    printf("  %-6s %7d updates, a snapshot every %-6d %9.1f ns/update\n", ht ? "table" : "hamt",
+           updates, interval, ns);
+    free(snapshots);
+}
+
+int main(int argc, char** argv) {
+    num_keys = argc > 1 ? atoi(argv[1]) : num_keys;
+    num_lookups = argc > 2 ? atoi(argv[2]) : num_lookups;
+    printf("*** %d keys, %d random lookups\n", num_keys, num_lookups);
+
+    ht_hash_table* ht = ht_new();
+    ht_hamt* h = ht_hamt_new();
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < num_keys; i++) {
+        char key[16];
+        snprintf(key, 16, "k%d", i);
+        ht_insert(ht, key, key);
+    }
+    const double table_fill = (bench_now_ns() - start) / 1e6;
+    start = bench_now_ns();
+    for (int i = 0; i < num_keys; i++) {
+        char key[16];
+        snprintf(key, 16, "k%d", i);
+        ht_hamt_insert(h, key, key);
+    }
+    const double hamt_fill = (bench_now_ns() - start) / 1e6;
+    printf("fill      table %8.1f ms   hamt %8.1f ms\n", table_fill, hamt_fill);
+
+    start = bench_now_ns();
+    ht_hash_table* copy = copy_table(ht);
+    const double copy_ms = (bench_now_ns() - start) / 1e6;
+    ht_del_hash_table(copy);
+    enum { snapshot_reps = 100000 };
+    start = bench_now_ns();
+    for (int i = 0; i < snapshot_reps; i++) {
+        ht_hamt_del(ht_hamt_snapshot(h));
+    }
+    const double snapshot_ns = (double)(bench_now_ns() - start) / snapshot_reps;
+    printf("snapshot  table %8.1f ms   hamt %8.1f ns\n", copy_ms, snapshot_ns);
+
+    // Table copies are cut off at `max_copies` live at once, to stay in
+    // memory
+    enum { num_updates = 200000, max_copies = 8 };
+    const int intervals[] = {0, 100000, 1000, 10};
+    for (int i = 0; i < 4; i++) {
+        const int interval = intervals[i];
+        const int copies = interval ? num_updates / interval : 0;
+        bench_updates(ht, NULL, copies > max_copies ? interval * max_copies : num_updates,
+                      interval);
+        bench_updates(NULL, h, num_updates, interval);
+    }
+
+    char (*hits)[16] = malloc(sizeof(*hits) * num_lookups);
+    char (*misses)[16] = malloc(sizeof(*misses) * num_lookups);
+    uint64_t seed = 42;
+    for (int i = 0; i < num_lookups; i++) {
+        snprintf(hits[i], 16, "k%d", (int)(bench_rand(&seed) % num_keys));
+        snprintf(misses[i], 16, "m%d", (int)(bench_rand(&seed) % num_keys));
+    }
+    for (int round = 0; round < 2; round++) {
+        char (*keys)[16] = round == 0 ? hits : misses;
+        long table_found;
+        long hamt_found;
+        const double table_ns = lookup_ns(ht, NULL, keys, &table_found);
+        const double hamt_ns = lookup_ns(NULL, h, keys, &hamt_found);
+        printf("%-8s  table %8.1f ns   hamt %8.1f ns   (%ld / %ld found)\n",
+               round == 0 ? "present" : "absent", table_ns, hamt_ns, table_found, hamt_found);
+    }
+    free(hits);
+    free(misses);
+    ht_del_hash_table(ht);
+    ht_hamt_del(h);
+    return 0;
+}
@@ -0,0 +1,137 @@
+//
+//  ht_hugepage_bench.c
+//  hash_table
+//
+//  Lookup latency and dTLB misses of a large table whose bucket array
+//  is backed by base pages, transparent huge pages or reserved huge
+//  pages (`xlarge_policy`). The same keys are inserted into a presized
+//  table each time, then looked up in random order, present and
+//  absent. dTLB load misses and cycles come from `perf_event_open`, for
+//  this process in user space only, and read n/a where the kernel or
+//  hypervisor does not expose them. AnonHugePages is from
+//  /proc/self/smaps_rollup and shows whether THP took effect.
+//
+//  usage: ht_hugepage_bench [keys] [lookups]
+//
+
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../include/hash_table.h"
+#include "../include/xmalloc.h"
+#include "bench.h"
+
+static int counter_open(const uint32_t type, const uint64_t config) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+static long counter_read(const int fd) {
+    long value = 0;
+    if (fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)) {
+        return -1;
+    }
+    return value;
+}
+
+static long anon_huge_kb() {
+    FILE* f = fopen("/proc/self/smaps_rollup", "r");
+    char line[256];
+    long kb = -1;
+    while (f != NULL && fgets(line, sizeof(line), f) != NULL) {
+        if (sscanf(line, "AnonHugePages: %ld kB", &kb) == 1) {
+            break;
+        }
+    }
+    if (f != NULL) {
+        fclose(f);
+    }
+    return kb;
+}
+
+static void print_counter(const char* name, const long value, const int ops) {
+    if (value < 0) {
+        printf("  %s n/a", name);
+    } else {
+        printf("  %s %6.3f", name, (double)value / ops);
+    }
+}
+
+int main(int argc, char** argv) {
+    const int num_keys = argc > 1 ? atoi(argv[1]) : 2000000;
+    const int num_lookups = argc > 2 ? atoi(argv[2]) : 2000000;
+    printf("*** %d keys, %d random lookups\n", num_keys, num_lookups);
+
+    // Keys to look up, laid out in order so only the table is random
+    char (*hits)[16] = malloc((size_t)num_lookups * 16);
+    char (*misses)[16] = malloc((size_t)num_lookups * 16);
+    uint64_t seed = 42;
+    for (int i = 0; i < num_lookups; i++) {
+        snprintf(hits[i], 16, "k%d", (int)(bench_rand(&seed) % num_keys));
+        snprintf(misses[i], 16, "m%d", (int)(bench_rand(&seed) % num_keys));
+    }
+    const int dtlb = counter_open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB
+                                  | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                                  | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+    const int cycles = counter_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+
+    const char* names[] = {"base pages", "THP", "hugetlb"};
+    const int policies[] = {XL_HUGE_NONE, XL_HUGE_THP, XL_HUGE_TLB};
+    for (int p = 0; p < 3; p++) {
+        xlarge_policy(policies[p], XL_NUMA_DEFAULT);
+        xlarge_stats before;
+        xlarge_stats after;
+        xlarge_get_stats(&before);
+        ht_hash_table* ht = ht_new_capacity(num_keys);
+        xlarge_get_stats(&after);
+        char key[16];
+        for (int i = 0; i < num_keys; i++) {
+            snprintf(key, 16, "k%d", i);
+            ht_insert(ht, key, "v");
+        }
+        printf("%-10s  %zu MB of buckets, AnonHugePages %ld MB%s\n", names[p],
+               (size_t)ht->size * sizeof(ht_item*) >> 20, anon_huge_kb() >> 10,
+               after.fallbacks > before.fallbacks ? " (fell back)" : "");
+        for (int round = 0; round < 2; round++) {
+            char (*keys)[16] = round == 0 ? hits : misses;
+            ioctl(dtlb, PERF_EVENT_IOC_RESET, 0);
+            ioctl(cycles, PERF_EVENT_IOC_RESET, 0);
+            ioctl(dtlb, PERF_EVENT_IOC_ENABLE, 0);
+            ioctl(cycles, PERF_EVENT_IOC_ENABLE, 0);
+            const uint64_t t0 = bench_now_ns();
+            long found = 0;
+            for (int i = 0; i < num_lookups; i++) {
+                found += ht_search(ht, keys[i]) != NULL;
+            }
+            const double ns = (double)(bench_now_ns() - t0) / num_lookups;
+            ioctl(dtlb, PERF_EVENT_IOC_DISABLE, 0);
+            ioctl(cycles, PERF_EVENT_IOC_DISABLE, 0);
+            printf("  %-7s %6.1f ns/lookup", round == 0 ? "present" : "absent", ns);
+            print_counter("dTLB misses/lookup", counter_read(dtlb), num_lookups);
+            print_counter("cycles/lookup", counter_read(cycles), num_lookups);
+            printf("  (%ld found)\n", found);
+        }
+        ht_del_hash_table(ht);
+    }
+    if (dtlb >= 0) {
+        close(dtlb);
+    }
+    if (cycles >= 0) {
+        close(cycles);
+    }
+    free(hits);
+    free(misses);
+    return 0;
+}
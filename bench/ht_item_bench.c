@@ -0,0 +1,85 @@
+//
+//  ht_item_bench.c
+//  hash_table
+//
+//  Heap usage and lookup latency of `ht_hash_table` on a realistic
+//  key-length mix: most keys are short ids, some are longer names and
+//  a few are long paths. Built twice by `make build-bench`, with the
+//  default inline buffers and with `-DHT_INLINE_LEN=0`.
+//
+//  usage: ht_item_bench [keys] [lookups]
+//
+
+#include <malloc.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/hash_table.h"
+#include "bench.h"
+
+// 70% 6-12 chars, 25% 13-24 chars, 5% 25-64 chars.
+static int key_length(uint64_t* seed) {
+    const uint64_t r = bench_rand(seed) % 100;
+    if (r < 70) {
+        return 6 + bench_rand(seed) % 7;
+    }
+    if (r < 95) {
+        return 13 + bench_rand(seed) % 12;
+    }
+    return 25 + bench_rand(seed) % 40;
+}
+
+// Unique per `i`: the decimal index followed by filler up to `len`.
+static void make_key(char* buf, const int i, const int len) {
+    int n = snprintf(buf, 80, "%d:", i);
+    while (n < len) {
+        buf[n] = 'a' + (i + n) % 26;
+        n++;
+    }
+    buf[n] = '\0';
+}
+
+int main(int argc, char** argv) {
+    const int num_keys = argc > 1 ? atoi(argv[1]) : 500000;
+    const int lookups = argc > 2 ? atoi(argv[2]) : 2000000;
+
+    uint64_t seed = 42;
+    char (*keys)[80] = malloc((size_t)num_keys * sizeof(*keys));
+    for (int i = 0; i < num_keys; i++) {
+        make_key(keys[i], i, key_length(&seed));
+    }
+
+    const size_t heap_before = mallinfo2().uordblks;
+    ht_hash_table* ht = ht_new();
+    for (int i = 0; i < num_keys; i++) {
+        char value[16];
+        snprintf(value, 16, "%d", i % 100000);
+        ht_insert(ht, keys[i], value);
+    }
+    const size_t heap = mallinfo2().uordblks - heap_before;
+
+    uint64_t start = bench_now_ns();
+    long found = 0;
+    for (int i = 0; i < lookups; i++) {
+        found += ht_search(ht, keys[bench_rand(&seed) % num_keys]) != NULL;
+    }
+    const uint64_t hit_ns = bench_now_ns() - start;
+
+    start = bench_now_ns();
+    for (int i = 0; i < lookups; i++) {
+        char miss[80];
+        make_key(miss, num_keys + (int)(bench_rand(&seed) % num_keys), 10);
+        found += ht_search(ht, miss) != NULL;
+    }
+    const uint64_t miss_ns = bench_now_ns() - start;
+
+    printf("inline %2d: %d keys, heap %.1f MB (%.1f B/item), "
+           "hit %.1f ns, miss %.1f ns (found %ld)\n",
+           HT_INLINE_LEN, num_keys, heap / 1e6, (double)heap / num_keys,
+           (double)hit_ns / lookups, (double)miss_ns / lookups, found);
+
+    ht_del_hash_table(ht);
+    free(keys);
+    return 0;
+}
@@ -0,0 +1,139 @@
+//
+//  ht_sharded_bench.c
+//  hash_table
+//
+//  Compares one `ht_hash_table` behind a global lock with the sharded
+//  map: the worst single-insert pause while growing (dominated by
+//  resizes), and throughput of a 90/10 search/insert mix across threads.
+//
+//  usage: ht_sharded_bench [keys] [threads]
+//
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../include/hash_table.h"
+#include "../include/ht_sharded.h"
+#include "bench.h"
+
+static int num_keys = 200000;
+static int ops_per_thread = 200000;
+
+static ht_hash_table* global_ht;
+static pthread_mutex_t global_lock = PTHREAD_MUTEX_INITIALIZER;
+static ht_sharded_table* sharded;
+
+static void key_for(char* buf, const int i) {
+    snprintf(buf, 32, "key-%d", i);
+}
+
+static void bench_resize_pause(const char* name, const int shard_bits) {
+    ht_hash_table* ht = shard_bits < 0 ? ht_new() : NULL;
+    ht_sharded_table* sh = shard_bits < 0 ? NULL : ht_sharded_new(shard_bits);
+    uint64_t worst = 0;
+    const uint64_t start = bench_now_ns();
+    for (int i = 0; i < num_keys; i++) {
+        char key[32];
+        key_for(key, i);
+        const uint64_t t0 = bench_now_ns();
+        if (ht) {
+            ht_insert(ht, key, "value");
+        } else {
+            ht_sharded_insert(sh, key, "value");
+        }
+        const uint64_t dt = bench_now_ns() - t0;
+        if (dt > worst) {
+            worst = dt;
+        }
+    }
+    const uint64_t total = bench_now_ns() - start;
+    printf("%-14s fill %8.2f ms  worst insert pause %8.3f ms\n",
+           name, total / 1e6, worst / 1e6);
+    if (ht) {
+        ht_del_hash_table(ht);
+    } else {
+        ht_sharded_del(sh);
+    }
+}
+
+static void* mixed_worker(void* arg) {
+    uint64_t seed = 0x9E3779B97F4A7C15ULL * ((uintptr_t)arg + 1);
+    char key[32];
+    for (int i = 0; i < ops_per_thread; i++) {
+        const uint64_t r = bench_rand(&seed);
+        key_for(key, (int)(r % (uint64_t)(num_keys * 2)));
+        const int is_insert = (r >> 40) % 10 == 0;
+        if (sharded) {
+            if (is_insert) {
+                ht_sharded_insert(sharded, key, "value");
+            } else {
+                free(ht_sharded_search(sharded, key));
+            }
+        } else {
+            pthread_mutex_lock(&global_lock);
+            if (is_insert) {
+                ht_insert(global_ht, key, "value");
+            } else {
+                ht_search(global_ht, key);
+            }
+            pthread_mutex_unlock(&global_lock);
+        }
+    }
+    return NULL;
+}
+
+static void bench_throughput(const char* name, const int shard_bits, const int threads) {
+    char key[32];
+    if (shard_bits < 0) {
+        global_ht = ht_new();
+        sharded = NULL;
+    } else {
+        sharded = ht_sharded_new(shard_bits);
+    }
+    for (int i = 0; i < num_keys; i++) {
+        key_for(key, i);
+        if (sharded) {
+            ht_sharded_insert(sharded, key, "value");
+        } else {
+            ht_insert(global_ht, key, "value");
+        }
+    }
+    pthread_t* tids = malloc(sizeof(pthread_t) * threads);
+    const uint64_t start = bench_now_ns();
+    for (long t = 0; t < threads; t++) {
+        pthread_create(&tids[t], NULL, mixed_worker, (void*)t);
+    }
+    for (int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+    }
+    const uint64_t total = bench_now_ns() - start;
+    const double mops = (double)ops_per_thread * threads / (total / 1e3);
+    printf("%-14s %2d threads %8.2f Mops/s\n", name, threads, mops);
+    free(tids);
+    if (sharded) {
+        ht_sharded_del(sharded);
+        sharded = NULL;
+    } else {
+        ht_del_hash_table(global_ht);
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        num_keys = atoi(argv[1]);
+    }
+    const int threads = argc > 2 ? atoi(argv[2]) : 4;
+
+    printf("*** resize pause, %d keys\n", num_keys);
+    bench_resize_pause("single", -1);
+    bench_resize_pause("sharded x16", 4);
+    bench_resize_pause("sharded x64", 6);
+
+    printf("*** 90/10 search/insert throughput\n");
+    for (int t = 1; t <= threads; t *= 2) {
+        bench_throughput("single+lock", -1, t);
+        bench_throughput("sharded x64", 6, t);
+    }
+    return 0;
+}
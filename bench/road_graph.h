@@ -0,0 +1,66 @@
+//
+//  road_graph.h
+//  hash_table
+//
+//  Synthetic road network for the graph benchmarks: a `width` x `height`
+//  grid of intersections with jittered gps locations, two-way streets
+//  to the 4 neighbours and a few missing blocks. Street lengths are the
+//  straight-line distance stretched by up to 50%.
+//
+
+#ifndef ROAD_GRAPH_H_
+#define ROAD_GRAPH_H_
+
+#include <math.h>
+#include <stdio.h>
+
+#include "../include/graph_elements.h"
+#include "bench.h"
+
+static inline void road_graph_key(char* buf, const int i) {
+    snprintf(buf, 24, "n%d", i);
+}
+
+static inline graph* road_graph_grid(const int width, const int height, uint64_t seed) {
+    graph* G = create_graph();
+    float* lat = malloc(sizeof(float) * width * height);
+    float* lon = malloc(sizeof(float) * width * height);
+    char key[24];
+    for (int i = 0; i < width * height; i++) {
+        // Roughly 100m blocks around 42.28N 83.74W
+        lat[i] = 42.28f + (i / width) * 0.0009f + (bench_rand(&seed) % 100) * 0.000002f;
+        lon[i] = -83.74f + (i % width) * 0.0012f + (bench_rand(&seed) % 100) * 0.000002f;
+        road_graph_key(key, i);
+        add_node(G->N, new_node(key, new_gps(lat[i], lon[i])));
+    }
+    for (int i = 0; i < width * height; i++) {
+        const int x = i % width;
+        const int y = i / width;
+        const int next[2] = {x + 1 < width ? i + 1 : -1, y + 1 < height ? i + width : -1};
+        for (int k = 0; k < 2; k++) {
+            const int j = next[k];
+            // Leave out ~5% of the streets
+            if (j < 0 || bench_rand(&seed) % 100 < 5) {
+                continue;
+            }
+            const float dlat = (lat[j] - lat[i]) * 111000.0f;
+            const float dlon = (lon[j] - lon[i]) * 82000.0f;
+            const float length = sqrtf(dlat * dlat + dlon * dlon)
+                                 * (1.0f + (bench_rand(&seed) % 50) / 100.0f);
+            char other[24];
+            road_graph_key(key, i);
+            road_graph_key(other, j);
+            float* d = malloc(sizeof(float));
+            *d = length;
+            add_edge(G->E, key, new_neighbour(other, d));
+            d = malloc(sizeof(float));
+            *d = length;
+            add_edge(G->E, other, new_neighbour(key, d));
+        }
+    }
+    free(lat);
+    free(lon);
+    return G;
+}
+
+#endif  // ROAD_GRAPH_H_
@@ -0,0 +1,69 @@
+//
+//  graph_compressed.h
+//  hash_table
+//
+//  Read-only compressed adjacency for graphs too large to hold as a
+//  `gk_csr` plus weights. Every row stores its sorted targets as gaps
+//  in stream-VByte form (a 2-bit length code per gap, four codes to a
+//  control byte, then the gaps' 1 to 4 significant bytes) and its
+//  weights quantized to 16 bits. Rows are decoded on the fly by
+//  `gc_iter`, four gaps at a time, with SSSE3 shuffles when compiled
+//  with `-mssse3` and a table-driven scalar loop otherwise.
+//
+
+#ifndef GRAPH_COMPRESSED_H_
+#define GRAPH_COMPRESSED_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "graph_kernels.h"
+
+// Row `v` starts at `data + row[v]`:
+//   varint  degree
+//   uint16  quantized weight of every edge, little endian (if weighted)
+//   uint8   ceil(degree / 4) control bytes
+//   uint8   gap bytes
+// The first gap is the zigzag encoded difference between the first
+// target and `v`, so rows of a well ordered graph start small; later
+// gaps are differences between consecutive targets. A weight `q`
+// decodes to `q * weight_scale`. Offsets are 32 bits to keep the index
+// small, so `gc_build` refuses graphs whose rows pass 4 GiB.
+typedef struct {
+    int n;
+    int m;
+    uint32_t* row;
+    uint8_t* data;
+    size_t data_bytes;
+    float weight_scale;
+    int weighted;
+    node** nodes;
+    int* bucket_ids;
+    nodes_table* N;
+} gc_graph;
+
+// Cursor over the edges of one row.
+typedef struct {
+    const uint8_t* control;
+    const uint8_t* gaps;
+    const uint8_t* weights;
+    float weight_scale;
+    int remaining;
+    int target;
+    uint32_t block[4];
+    int block_len;
+    int block_pos;
+} gc_iter;
+
+// Compressed graph API
+gc_graph* gc_build(const gk_csr* csr, const float* weights);
+void gc_free(gc_graph* g);
+size_t gc_bytes(const gc_graph* g);
+int gc_vertex(const gc_graph* g, const char* key);
+int gc_degree(const gc_graph* g, const int v);
+void gc_neighbours(const gc_graph* g, const int v, gc_iter* it);
+int gc_next(gc_iter* it, int* target, float* weight);
+int gc_bfs(const gc_graph* g, const int src, int* hops);
+int gc_sssp(const gc_graph* g, const int src, float* dist);
+
+#endif  // GRAPH_COMPRESSED_H_
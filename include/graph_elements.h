@@ -9,6 +9,7 @@
 #ifndef GRAPH_ELEMENTS_H_
 #define GRAPH_ELEMENTS_H_
 
+#include <stdio.h>
 #include <stdlib.h>
 #include "geography.h"
 
@@ -18,19 +19,22 @@ typedef struct {
     float* distance;
 } neighbour;
 
+// Outgoing edges of the vertex `node`, hashed by
+// the key of the neighbour they lead to
 typedef struct {
+    char* node;
     neighbour** neighbours;
     int size_index;
     int size;
     int count;
 } neighbours;
 
-// Vertex defined by a key
+// Edges of every vertex, hashed by the key of
+// the vertex they leave from
 typedef struct {
     int size_index;
     int size;
     int count;
-    char* node;
     neighbours** neighbours;
 } edges_table;
 
@@ -49,8 +53,8 @@ typedef struct {
 } nodes_table;
 
 typedef struct {
-    nodes_table N;
-    edges_table E;
+    nodes_table* N;
+    edges_table* E;
 } graph;
 
 // ------------------------------------------
@@ -58,19 +62,25 @@ typedef struct {
 
 // Edges
 edges_table* create_edges();
-void add_edge(edges_table* E, neighbour* n);
+neighbour* new_neighbour(const char* node, float* distance);
+void add_edge(edges_table* E, const char* from, neighbour* n);
 void delete_edges(edges_table* E);
-neighbour** find_neighbours(edges_table* E, const char* key);
-neighbours* create_neighbours(const int size_index);
+neighbours* find_neighbours(edges_table* E, const char* key);
+neighbour* find_neighbour(neighbours* ns, const char* key);
+neighbours* create_neighbours(const char* node, const int size_index);
 
 //Nodes
+gps* new_gps(const float lat, const float lon);
+node* new_node(const char* key, gps* location);
 nodes_table* create_nodes();
 void add_node(nodes_table* N, node* n);
 void delete_nodes(nodes_table* N);
 node* find_node(nodes_table* N, const char* key);
+int find_node_index(nodes_table* N, const char* key);
 
 graph* create_graph();
 void delete_graph(graph* G);
+void graph_stats_dump(graph* G, FILE* out);
 
 
 
@@ -0,0 +1,95 @@
+//
+//  graph_isochrone.h
+//  hash_table
+//
+//  One-to-all shortest paths and isochrones by delta-stepping over a
+//  `gk_f32_dir_graph`, with each search spread over a pool of threads.
+//  Tentative distances are grouped in buckets of width `delta`. All
+//  threads relax the vertices of the lowest non-empty bucket together
+//  and then agree on the next bucket. A vertex may be relaxed more
+//  than once, which Dijkstra avoids. In return there is no priority
+//  queue to serialize on. A `delta` near the mean edge weight keeps the
+//  repeats rare on road networks.
+//
+//  An isochrone is every vertex within `budget` of the source, with its
+//  distance and the bounding box of the vertices' locations. Searches
+//  never go past the budget. Only the vertices they reach are reset
+//  afterwards, so small isochrones on large graphs stay cheap.
+//
+
+#ifndef GRAPH_ISOCHRONE_H_
+#define GRAPH_ISOCHRONE_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "graph_kernels.h"
+
+// Growable array of vertex ids.
+typedef struct {
+    int* ids;
+    int len;
+    int cap;
+} gi_vec;
+
+// Per-thread state. `bins[b]` holds the vertices this thread moved into
+// bucket `b`, and `touched` those it reached first.
+typedef struct {
+    gi_vec* bins;
+    int num_bins;
+    gi_vec touched;
+    unsigned long relaxed;
+    char pad[64];
+} gi_local;
+
+// Distances are stored as the bits of non-negative floats, which
+// compare as unsigned integers in the same order, so relaxing is a
+// compare-and-swap on `dist`. The search state is shared by the pool
+// and guarded by barriers between phases. `num_threads` counts the
+// threads actually started, and workers wait on `ready` until the
+// barriers are sized to them.
+typedef struct {
+    const gk_f32_dir_graph* g;
+    float delta;
+    int num_threads;
+    pthread_t* threads;
+    pthread_mutex_t ready;
+    pthread_barrier_t start;
+    pthread_barrier_t phase;
+    int stop;
+
+    _Atomic uint32_t* dist;
+    int* frontier;
+    int frontier_cap;
+    atomic_int frontier_len;
+    atomic_int next_index;
+    atomic_int next_bin;
+    int src;
+    float budget;
+    gi_local* locals;
+
+    unsigned long searches;
+    unsigned long relaxed;
+} gi_searcher;
+
+typedef struct {
+    int count;
+    int* vertices;
+    float* dist;
+    float min_lat;
+    float min_lon;
+    float max_lat;
+    float max_lon;
+} gi_area;
+
+// Delta-stepping API. A `delta` of 0 picks the mean edge weight. The
+// calling thread takes part in every search, so `num_threads` counts
+// it. Searches on one searcher must not overlap.
+gi_searcher* gi_new(const gk_f32_dir_graph* g, const float delta, const int num_threads);
+void gi_del(gi_searcher* s);
+int gi_sssp(gi_searcher* s, const int src, float* dist);
+int gi_isochrone(gi_searcher* s, const int src, const float budget, gi_area* iso);
+void gi_area_free(gi_area* iso);
+
+#endif  // GRAPH_ISOCHRONE_H_
@@ -0,0 +1,214 @@
+//
+//  graph_kernels.h
+//  hash_table
+//
+//  Traversal kernels specialized at compile time on the weight type and
+//  directedness of the graph. `GK_DECLARE_*` and `GK_DEFINE_*` stamp out
+//  a storage type and its kernels, the way a template would. The common
+//  variants are instantiated in graph_kernels.c.
+//
+
+#ifndef GRAPH_KERNELS_H_
+#define GRAPH_KERNELS_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "graph_elements.h"
+#include "xmalloc.h"
+
+// Compressed sparse row snapshot of a `graph`'s topology. Vertices are
+// numbered 0..n-1 in `nodes_table` bucket order and the edges leaving
+// `v` are `targets[offsets[v]]` up to `targets[offsets[v + 1] - 1]`,
+// sorted by target. `nodes[v]` is the vertex's `node` in the graph and
+// `bucket_ids` maps a bucket of `N` back to its vertex id.
+typedef struct {
+    int n;
+    int m;
+    int* offsets;
+    int* targets;
+    node** nodes;
+    int* bucket_ids;
+    nodes_table* N;
+} gk_csr;
+
+// Topology shared by every variant. `gk_build_csr` also returns the
+// edges' distances, in CSR order, through `weights` unless it is NULL,
+// and then fails with -1 if any is negative or NaN.
+int gk_build_csr(gk_csr* csr, graph* G, const int directed, float** weights);
+void gk_free_csr(gk_csr* csr);
+int gk_vertex(const gk_csr* csr, const char* key);
+int gk_bfs(const gk_csr* csr, const int src, int* hops);
+
+// Unweighted variant: topology only, no weight array at all.
+#define GK_DECLARE_UNWEIGHTED(name)                                         \
+    typedef struct {                                                        \
+        gk_csr csr;                                                         \
+    } name##_graph;                                                         \
+    name##_graph* name##_build(graph* G);                                   \
+    void name##_free(name##_graph* g);                                      \
+    int name##_bfs(const name##_graph* g, const int src, int* hops);
+
+#define GK_DEFINE_UNWEIGHTED(name, directed)                                \
+    name##_graph* name##_build(graph* G) {                                  \
+        name##_graph* g = xmalloc(sizeof(name##_graph));                    \
+        gk_build_csr(&g->csr, G, directed, NULL);                           \
+        return g;                                                           \
+    }                                                                       \
+    void name##_free(name##_graph* g) {                                     \
+        gk_free_csr(&g->csr);                                               \
+        free(g);                                                            \
+    }                                                                       \
+    int name##_bfs(const name##_graph* g, const int src, int* hops) {       \
+        return gk_bfs(&g->csr, src, hops);                                  \
+    }
+
+// Lazy binary min-heap of (key, vertex) pairs for the Dijkstra searches:
+// stale entries are skipped on pop instead of being decreased. `push`
+// grows the arrays as needed, so a zeroed heap is ready to use and one
+// kept between searches only allocates until it has seen its largest.
+#define GK_DEFINE_HEAP(name, key_t)                                         \
+    typedef struct {                                                        \
+        key_t* keys;                                                        \
+        int* vertices;                                                      \
+        int len;                                                            \
+        int cap;                                                            \
+    } name;                                                                 \
+    static inline void name##_push(name* h, const key_t key, const int v) { \
+        if (h->len == h->cap) {                                             \
+            h->cap = h->cap ? h->cap * 2 : 256;                             \
+            h->keys = xrealloc(h->keys, (size_t)h->cap * sizeof(key_t));    \
+            h->vertices = xrealloc(h->vertices, (size_t)h->cap * sizeof(int)); \
+        }                                                                   \
+        int i = h->len++;                                                   \
+        while (i > 0 && h->keys[(i - 1) / 2] > key) {                       \
+            h->keys[i] = h->keys[(i - 1) / 2];                              \
+            h->vertices[i] = h->vertices[(i - 1) / 2];                      \
+            i = (i - 1) / 2;                                                \
+        }                                                                   \
+        h->keys[i] = key;                                                   \
+        h->vertices[i] = v;                                                 \
+    }                                                                       \
+    /* Removes the smallest entry, returning its vertex and its key */      \
+    /* through `key`. The heap must not be empty. */                        \
+    static inline int name##_pop(name* h, key_t* key) {                    \
+        *key = h->keys[0];                                                  \
+        const int v = h->vertices[0];                                       \
+        const int len = --h->len;                                           \
+        int hole = 0;                                                       \
+        for (;;) {                                                          \
+            int child = 2 * hole + 1;                                       \
+            if (child >= len) {                                             \
+                break;                                                      \
+            }                                                               \
+            if (child + 1 < len && h->keys[child + 1] < h->keys[child]) {   \
+                child++;                                                    \
+            }                                                               \
+            if (h->keys[len] <= h->keys[child]) {                           \
+                break;                                                      \
+            }                                                               \
+            h->keys[hole] = h->keys[child];                                 \
+            h->vertices[hole] = h->vertices[child];                         \
+            hole = child;                                                   \
+        }                                                                   \
+        h->keys[hole] = h->keys[len];                                       \
+        h->vertices[hole] = h->vertices[len];                               \
+        return v;                                                           \
+    }                                                                       \
+    static inline void name##_free(name* h) {                               \
+        free(h->keys);                                                      \
+        free(h->vertices);                                                  \
+    }
+
+// Heaps keyed by the two distance types of the instantiated variants.
+GK_DEFINE_HEAP(gk_heap_f32, float)
+GK_DEFINE_HEAP(gk_heap_u64, uint64_t)
+
+// Weighted variant: `weights[e]` holds the weight of edge `e` by value
+// in an array parallel to `targets`, converted from the graph's `float*`
+// distances by `from_float`. `build` returns NULL if a distance is
+// negative or NaN.
+// Shortest distances accumulate in `dist_t`, with `dist_inf` marking
+// unreachable vertices.
+#define GK_DECLARE_WEIGHTED(name, weight_t, dist_t)                         \
+    typedef struct {                                                        \
+        gk_csr csr;                                                         \
+        weight_t* weights;                                                  \
+    } name##_graph;                                                         \
+    typedef weight_t name##_weight;                                         \
+    typedef dist_t name##_dist;                                             \
+    name##_graph* name##_build(graph* G);                                   \
+    void name##_free(name##_graph* g);                                      \
+    int name##_bfs(const name##_graph* g, const int src, int* hops);        \
+    int name##_sssp(const name##_graph* g, const int src, dist_t* dist);
+
+#define GK_DEFINE_WEIGHTED(name, weight_t, dist_t, dist_inf, heap, directed, from_float) \
+    name##_graph* name##_build(graph* G) {                                  \
+        name##_graph* g = xmalloc(sizeof(name##_graph));                    \
+        float* distances;                                                   \
+        if (gk_build_csr(&g->csr, G, directed, &distances) < 0) {           \
+            free(g);                                                        \
+            return NULL;                                                    \
+        }                                                                   \
+        g->weights = xmalloc((size_t)g->csr.m * sizeof(weight_t));          \
+        for (int e = 0; e < g->csr.m; e++) {                                \
+            g->weights[e] = from_float(distances[e]);                       \
+        }                                                                   \
+        free(distances);                                                    \
+        return g;                                                           \
+    }                                                                       \
+    void name##_free(name##_graph* g) {                                     \
+        gk_free_csr(&g->csr);                                               \
+        free(g->weights);                                                   \
+        free(g);                                                            \
+    }                                                                       \
+    int name##_bfs(const name##_graph* g, const int src, int* hops) {       \
+        return gk_bfs(&g->csr, src, hops);                                  \
+    }                                                                       \
+    /* Dijkstra with the lazy `heap` keyed by `dist_t`. */                  \
+    int name##_sssp(const name##_graph* g, const int src, dist_t* dist) {   \
+        const gk_csr* csr = &g->csr;                                        \
+        for (int v = 0; v < csr->n; v++) {                                  \
+            dist[v] = dist_inf;                                             \
+        }                                                                   \
+        heap h = {0};                                                       \
+        int settled = 0;                                                    \
+        dist[src] = 0;                                                      \
+        heap##_push(&h, 0, src);                                            \
+        while (h.len > 0) {                                                 \
+            dist_t d;                                                       \
+            const int u = heap##_pop(&h, &d);                               \
+            if (d > dist[u]) {                                              \
+                continue;                                                   \
+            }                                                               \
+            settled++;                                                      \
+            for (int e = csr->offsets[u]; e < csr->offsets[u + 1]; e++) {   \
+                const int v = csr->targets[e];                              \
+                const dist_t nd = d + g->weights[e];                        \
+                if (nd < dist[v]) {                                         \
+                    dist[v] = nd;                                           \
+                    heap##_push(&h, nd, v);                                 \
+                }                                                           \
+            }                                                               \
+        }                                                                   \
+        heap##_free(&h);                                                    \
+        return settled;                                                     \
+    }
+
+// Conversions used by the instantiated variants. `uint32_t` weights
+// hold distances rounded to whole units.
+#define GK_FROM_FLOAT(d) (d)
+#define GK_ROUND_U32(d) ((uint32_t)lrintf(d))
+
+// Instantiated variants: unweighted, `uint32_t` and `float` weights,
+// each directed (edges as stored) and undirected (every edge also
+// traversable backwards).
+GK_DECLARE_UNWEIGHTED(gk_u_dir)
+GK_DECLARE_UNWEIGHTED(gk_u_undir)
+GK_DECLARE_WEIGHTED(gk_u32_dir, uint32_t, uint64_t)
+GK_DECLARE_WEIGHTED(gk_u32_undir, uint32_t, uint64_t)
+GK_DECLARE_WEIGHTED(gk_f32_dir, float, float)
+GK_DECLARE_WEIGHTED(gk_f32_undir, float, float)
+
+#endif  // GRAPH_KERNELS_H_
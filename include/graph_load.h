@@ -0,0 +1,27 @@
+//
+//  graph_load.h
+//  hash_table
+//
+//  Loading a `graph` and a hash table from plain text files, one record
+//  per line, with blank lines and lines starting with `#` ignored.
+//
+//  Graph files hold nodes and directed edges:
+//      node <key> <lat> <lon>
+//      edge <from> <to> <distance>
+//  Table files hold a key and the rest of the line as its value:
+//      <key> <value>
+//
+//  Both loaders return NULL, after printing the offending line to
+//  stderr, if the file can't be read or a line is malformed.
+//
+
+#ifndef GRAPH_LOAD_H_
+#define GRAPH_LOAD_H_
+
+#include "graph_elements.h"
+#include "hash_table.h"
+
+graph* load_graph(const char* path);
+ht_hash_table* load_table(const char* path);
+
+#endif  // GRAPH_LOAD_H_
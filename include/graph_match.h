@@ -0,0 +1,135 @@
+//
+//  graph_match.h
+//  hash_table
+//
+//  Map matching: snapping traces of noisy gps pings to the edges of a
+//  `gk_f32_dir_graph` whose distances are in metres.
+//
+//  Candidates for a ping are the edges passing within `radius` of it,
+//  found through a uniform grid over the nodes' locations. Each edge is
+//  filed under every cell its bounding box overlaps. A hidden Markov
+//  model then picks one candidate per ping. A candidate is likelier the
+//  closer the ping is to it, with gaussian noise of deviation `sigma`.
+//  A step between candidates is likelier the closer the route length
+//  between them is to the straight-line distance between the pings,
+//  with exponential falloff `beta`. Viterbi finds the likeliest
+//  sequence. When no step is possible at all the trace is broken there
+//  and matching starts over.
+//
+//  Route lengths come from Dijkstra searches bounded by a few times the
+//  ping distance. Each worker keeps the lengths it found in a
+//  direct-mapped cache keyed by the pair of vertices, as consecutive
+//  traces on the same roads ask for the same steps over and over.
+//
+//  `gm_match_batch` spreads traces over a pool of threads. Each thread
+//  has its own search state and cache, so nothing is shared but the
+//  read-only graph and grid.
+//
+
+#ifndef GRAPH_MATCH_H_
+#define GRAPH_MATCH_H_
+
+#include <stdint.h>
+
+#include "graph_kernels.h"
+
+#define GM_RADIUS 50.0f
+#define GM_SIGMA 10.0f
+#define GM_BETA 5.0f
+#define GM_MAX_CANDIDATES 8  // at most 32
+#define GM_CACHE_SLOTS (1 << 16)
+
+typedef struct {
+    float lat;
+    float lon;
+} gm_point;
+
+typedef struct {
+    int count;
+    const gm_point* points;
+} gm_trace;
+
+// Ping `i` lies on edge `edges[i]`, at `offsets[i]` of its length from
+// the edge's source, or is unmatched with an edge of -1. `route` lists
+// the vertices driven through, with -1 wherever the trace is broken.
+typedef struct {
+    int count;
+    int* edges;
+    float* offsets;
+    int route_len;
+    int* route;
+    int breaks;
+} gm_result;
+
+typedef struct {
+    uint64_t key;
+    float dist;
+} gm_cache_slot;
+
+// A candidate is the point `offset` of the way along `edge` nearest to
+// the ping, `distance` metres away. `score` and `back` hold the
+// Viterbi state: the best log probability of a path ending here and
+// the candidate it came from.
+typedef struct {
+    int edge;
+    float offset;
+    float distance;
+    float score;
+    int back;
+} gm_candidate;
+
+// Per-thread search state. `dist` and `pred` are only valid for the
+// vertices on `touched`, which are reset before the next search.
+typedef struct {
+    float* dist;
+    int* pred;
+    int* touched;
+    int num_touched;
+    gk_heap_f32 heap;
+    gm_candidate* candidates;
+    int candidates_cap;
+    gm_cache_slot* cache;
+    unsigned long searches;
+    unsigned long hits;
+    unsigned long misses;
+} gm_worker;
+
+// Vertex locations are projected to metres east and north of the
+// south-west corner of the graph, which holds well at city scale.
+typedef struct {
+    const gk_f32_dir_graph* g;
+    float radius;
+    float sigma;
+    float beta;
+    float* x;
+    float* y;
+    int* sources;
+    float lat0;
+    float lon0;
+    float lon_scale;
+    float cell;
+    int cols;
+    int rows;
+    int* cell_offsets;
+    int* cell_edges;
+    int num_threads;
+    gm_worker* workers;
+
+    unsigned long points;
+    unsigned long matched;
+    unsigned long searches;
+    unsigned long cache_hits;
+    unsigned long cache_misses;
+} gm_matcher;
+
+// A `radius`, `sigma` or `beta` of 0 picks the default. `num_threads`
+// counts the calling thread, which takes part in every batch.
+gm_matcher* gm_new(const gk_f32_dir_graph* g, const float radius, const float sigma,
+                   const float beta, const int num_threads);
+void gm_del(gm_matcher* m);
+int gm_candidates(gm_matcher* m, const gm_point p, gm_candidate* out);
+int gm_match(gm_matcher* m, const gm_trace* trace, gm_result* result);
+int gm_match_batch(gm_matcher* m, const gm_trace* traces, const int count, gm_result* results);
+void gm_result_free(gm_result* result);
+
+#endif  // GRAPH_MATCH_H_
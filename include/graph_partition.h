@@ -0,0 +1,87 @@
+//
+//  graph_partition.h
+//  hash_table
+//
+//  Splitting a graph into K partitions that separate worker processes
+//  can load on their own, and running BFS and shortest path searches
+//  across them.
+//
+//  `gp_partition` cuts the vertices by recursive k-d bisection of their
+//  gps locations into K parts of near equal size. Greedy passes then
+//  move boundary vertices to the neighbouring part holding most of
+//  their edges, while sizes stay within `GP_IMBALANCE` of the mean.
+//  Vertices without a location join the part of most of their
+//  neighbours, or the smallest part if that one is full.
+//
+//  `gp_write` stores each part in its own file `<prefix>.<i>`. The file
+//  holds the part's vertices, by global id, and the edges leaving them.
+//  Each edge target is stored as its part and its index within that
+//  part, so no process needs the global graph. The vertices with edges
+//  into other parts are listed as the part's boundary.
+//
+//  A `gp_cluster` forks one worker process per part. Workers talk to
+//  the coordinator over socket pairs in supersteps. Each worker runs
+//  Dijkstra over its own edges from the vertices whose distance
+//  improved, and then reports the improvements it found for remote
+//  vertices. The coordinator routes those to their owners for the next
+//  superstep. The search ends when a superstep produces no messages.
+//
+
+#ifndef GRAPH_PARTITION_H_
+#define GRAPH_PARTITION_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+
+#include "graph_kernels.h"
+
+#define GP_IMBALANCE 0.03
+
+// One partition as loaded by a worker. Local vertex `i` is global
+// vertex `global_ids[i]`, which are sorted. Its edges run from
+// `offsets[i]` to `offsets[i + 1]`. Each edge leads to local vertex
+// `targets[e]` of part `target_parts[e]`.
+typedef struct {
+    int id;
+    int k;
+    int n_global;
+    int n;
+    int m;
+    int* global_ids;
+    int* offsets;
+    int* targets;
+    uint16_t* target_parts;
+    float* weights;
+    int num_boundary;
+    int* boundary;
+} gp_part;
+
+// Coordinator side of the worker processes. `fds[i]` is the
+// coordinator's end of a Unix socket pair with worker `i`, which works
+// as a pipe in both directions.
+typedef struct {
+    int k;
+    int n_global;
+    pid_t* pids;
+    int* fds;
+    unsigned long supersteps;
+    unsigned long messages;
+} gp_cluster;
+
+// Partitioning
+int* gp_partition(const gk_f32_dir_graph* g, const int k, const int refine_passes);
+long gp_edge_cut(const gk_csr* csr, const int* part);
+
+// Per-partition files
+int gp_write(const gk_f32_dir_graph* g, const int* part, const int k, const char* prefix);
+gp_part* gp_part_load(const char* path);
+void gp_part_free(gp_part* p);
+
+// Multi-process execution. Distances and hops are indexed by global
+// vertex id, with `INFINITY` and -1 where unreachable.
+gp_cluster* gp_cluster_start(const char* prefix, const int k);
+int gp_cluster_sssp(gp_cluster* c, const int src, float* dist);
+int gp_cluster_bfs(gp_cluster* c, const int src, int* hops);
+void gp_cluster_stop(gp_cluster* c);
+
+#endif  // GRAPH_PARTITION_H_
@@ -0,0 +1,70 @@
+//
+//  graph_rank.h
+//  hash_table
+//
+//  Vertex importance over a `gk_csr`: PageRank and sampled betweenness,
+//  both spread over a pool of threads.
+//
+//  PageRank pulls. Each thread owns a range of vertices, balanced by
+//  in-edges, and sums the contributions of their in-neighbours through
+//  the transpose. Nothing is written by more than one thread, so no
+//  atomics are needed. A round of power iteration costs one barrier.
+//  The dangling mass and the L1 change are summed from per-thread slots
+//  that every thread reads after the barrier, and so every thread
+//  decides on convergence the same way. Long rows of in-neighbours are
+//  summed with AVX2 gathers when compiled with `-mavx2`.
+//
+//  Betweenness follows Brandes: a shortest path search from each
+//  source, then a pass back in reverse settled order that spreads each
+//  vertex's dependency over its shortest path predecessors. These are
+//  found again through the transpose rather than stored. With fewer
+//  samples than vertices, sources are drawn at random and the scores
+//  are scaled up to estimate the exact ones. Each thread keeps its own
+//  sums, which are added up at the end.
+//
+
+#ifndef GRAPH_RANK_H_
+#define GRAPH_RANK_H_
+
+#include <stdint.h>
+
+#include "graph_kernels.h"
+
+#define GR_DAMPING 0.85f
+#define GR_TOLERANCE 1e-6
+
+// `in_offsets`, `in_sources` and `in_edges` are the transpose: the
+// edges into `v` come from `in_sources[j]` for `j` in `in_offsets[v]`
+// up to `in_offsets[v + 1]`, and are edge `in_edges[j]` of the CSR.
+// Thread `t` owns vertices `bounds[t]` up to `bounds[t + 1]`.
+typedef struct {
+    const gk_csr* csr;
+    const float* weights;
+    int* in_offsets;
+    int* in_sources;
+    int* in_edges;
+    float* inv_degree;
+    int num_threads;
+    int* bounds;
+
+    int iterations;
+    double delta;
+} gr_ranker;
+
+// `weights` may be NULL, for hop counts. `num_threads` counts the
+// calling thread.
+gr_ranker* gr_new(const gk_csr* csr, const float* weights, const int num_threads);
+void gr_del(gr_ranker* r);
+
+// Ranks sum to 1. Iterates until the L1 change is under `tolerance`
+// or `max_iterations` have run, and returns the number of iterations.
+int gr_pagerank(gr_ranker* r, const float damping, const double tolerance,
+                const int max_iterations, float* rank);
+
+// Shortest path betweenness from `samples` sources, or from all of
+// them if `samples` is 0 or at least the number of vertices. Either
+// score array may be NULL.
+void gr_betweenness(gr_ranker* r, const int samples, const uint64_t seed, float* vertex_scores,
+                    float* edge_scores);
+
+#endif  // GRAPH_RANK_H_
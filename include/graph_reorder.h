@@ -0,0 +1,26 @@
+//
+//  graph_reorder.h
+//  hash_table
+//
+
+#ifndef GRAPH_REORDER_H_
+#define GRAPH_REORDER_H_
+
+#include <stddef.h>
+
+#include "graph_kernels.h"
+
+// Vertex relabelling:
+// An order is a permutation `perm` with `perm[old_id] == new_id`.
+// `gk_order_hilbert` sorts vertices along a Hilbert curve over their gps
+// locations, so vertices close in space get close ids. Vertices without
+// a location go last. `gk_order_rcm` is reverse Cuthill-McKee, which
+// keeps the ends of every edge close in id, for graphs without
+// locations. `gk_permute` lays out a CSR and its parallel weight array
+// (`weight_size` bytes per edge, or NULL) in the new order.
+int* gk_order_hilbert(const gk_csr* csr);
+int* gk_order_rcm(const gk_csr* csr);
+void gk_permute(gk_csr* csr, void* weights, const size_t weight_size, const int* perm);
+double gk_bandwidth(const gk_csr* csr);
+
+#endif  // GRAPH_REORDER_H_
@@ -0,0 +1,76 @@
+//
+//  graph_server.h
+//  hash_table
+//
+//  Query server answering hash table lookups, node locations and
+//  shortest path distances over a Unix domain socket, so worker
+//  processes can share one loaded graph instead of each building
+//  their own.
+//
+//  Every request and response is a `gs_header` followed by `len` bytes
+//  of payload, in host byte order. Clients may pipeline any number of
+//  requests on a connection; responses come back in request order and
+//  carry the request's `id`.
+//
+//  Request payloads are two keys: a uint16 length, the first key and
+//  then the second key, filling the rest of the payload.
+//      GS_GET    value stored under the first key in the table
+//      GS_NODE   float lat, lon of the node with the first key
+//      GS_ROUTE  float shortest distance from the first to the second
+//  Responses set `code` to a `gs_status` and have an empty payload
+//  unless it is GS_OK.
+//
+
+#ifndef GRAPH_SERVER_H_
+#define GRAPH_SERVER_H_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "graph_kernels.h"
+#include "hash_table.h"
+
+#define GS_MAX_KEY 255
+#define GS_MAX_PAYLOAD (2 + 2 * GS_MAX_KEY)
+
+typedef struct {
+    uint32_t len;
+    uint32_t id;
+    uint8_t code;
+    uint8_t pad[3];
+} gs_header;
+
+enum gs_op { GS_GET = 1, GS_NODE = 2, GS_ROUTE = 3 };
+enum gs_status { GS_OK = 0, GS_NOT_FOUND = 1, GS_BAD_REQUEST = 2 };
+
+struct gs_conn;
+
+// The server only reads `table` and `graph`, which stay owned by the
+// caller and must outlive it. Open connections are kept on `conns` so
+// they can be closed when the server is deleted.
+typedef struct {
+    ht_hash_table* table;
+    gk_f32_dir_graph* graph;
+    int listen_fd;
+    int epoll_fd;
+    int wake_fd;
+    int num_workers;
+    pthread_t* workers;
+    char* path;
+    pthread_mutex_t conns_lock;
+    struct gs_conn* conns;
+} gs_server;
+
+// Server API
+gs_server* gs_server_new(const char* path, ht_hash_table* table, gk_f32_dir_graph* graph);
+void gs_server_start(gs_server* s, const int num_workers);
+void gs_server_stop(gs_server* s);
+void gs_server_del(gs_server* s);
+
+// Client helpers
+int gs_connect(const char* path);
+size_t gs_put_request(char* buf, const uint32_t id, const int op, const char* key,
+                      const char* other);
+
+#endif  // GRAPH_SERVER_H_
@@ -0,0 +1,83 @@
+//
+//  graph_updates.h
+//  hash_table
+//
+//  Live edge-weight updates over a `gk_f32_dir_graph`. Producers push
+//  (src, dst, weight) deltas into a lock-free queue, a single applier
+//  drains them in batches into a new version of the weights, and
+//  readers traverse whichever version was current when they started,
+//  without ever blocking. Versions share the topology and differ only
+//  in their weight arrays. A retired version is freed once every reader
+//  that could have seen it has finished (epoch-based reclamation).
+//
+
+#ifndef GRAPH_UPDATES_H_
+#define GRAPH_UPDATES_H_
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#include "graph_kernels.h"
+
+#define GU_MAX_READERS 64
+
+// A queued weight change for the edge `src` -> `dst`.
+typedef struct {
+    atomic_size_t seq;
+    int src;
+    int dst;
+    float weight;
+} gu_delta;
+
+// One published set of weights over the shared topology.
+typedef struct gu_version {
+    gk_f32_dir_graph g;
+    uint64_t retired_epoch;
+    struct gu_version* next_retired;
+} gu_version;
+
+// Reader slots are padded so readers don't share cache lines.
+typedef struct {
+    _Atomic uint64_t epoch;
+    char pad[64 - sizeof(uint64_t)];
+} gu_reader_slot;
+
+// `topology` is shared by every version and stays valid, so producers
+// may resolve vertices and edges against it at any time.
+typedef struct {
+    gk_csr topology;
+    gu_delta* queue;
+    size_t queue_mask;
+    atomic_size_t queue_tail;
+    size_t queue_head;
+
+    _Atomic(gu_version*) current;
+    _Atomic uint64_t epoch;
+    gu_version* retired;
+    gu_reader_slot readers[GU_MAX_READERS];
+    atomic_int num_readers;
+
+    pthread_t applier;
+    atomic_int running;
+    int max_batch;
+
+    unsigned long applied;
+    unsigned long dropped;
+    unsigned long versions;
+    unsigned long reclaimed;
+} gu_graph;
+
+// Live update API
+gu_graph* gu_new(gk_f32_dir_graph* base, const int queue_capacity);
+void gu_del(gu_graph* gu);
+int gu_enqueue(gu_graph* gu, const int src, const int dst, const float weight);
+int gu_enqueue_keys(gu_graph* gu, const char* src, const char* dst, const float weight);
+int gu_apply(gu_graph* gu, const int max_batch);
+void gu_start_applier(gu_graph* gu, const int max_batch);
+void gu_stop_applier(gu_graph* gu);
+int gu_register_reader(gu_graph* gu);
+const gk_f32_dir_graph* gu_read_begin(gu_graph* gu, const int reader);
+void gu_read_end(gu_graph* gu, const int reader);
+
+#endif  // GRAPH_UPDATES_H_
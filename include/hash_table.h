@@ -9,29 +9,118 @@
 #ifndef HASH_TABLE_H_
 #define HASH_TABLE_H_
 
-// Key-value pairs (items) stored in a struct.
+#include <stdint.h>
+#include <stdio.h>
+
+#include "ht_filter.h"
+
+// Keys and values shorter than `HT_INLINE_LEN` bytes are copied into
+// the item itself, so a lookup on them touches one allocation. Longer
+// strings go to the heap. Build with `-DHT_INLINE_LEN=0` to always use
+// the heap.
+#ifndef HT_INLINE_LEN
+#define HT_INLINE_LEN 16
+#endif
+
+// Lengths of 255 or more are stored as 255.
+#define HT_LEN_SATURATED 255
+
+// Key-value pairs (items) stored in a struct. `key` and `value` point
+// either at the inline buffers or at heap copies. The length bytes let
+// a search reject most non-matching keys without a `strcmp`.
 typedef struct ht_item {
     char* key;
     char* value;
+    unsigned char key_len;
+    unsigned char value_len;
+#if HT_INLINE_LEN > 0
+    char inline_key[HT_INLINE_LEN];
+    char inline_value[HT_INLINE_LEN];
+#endif
 } ht_item;
 
+#ifdef HT_STATS
+// Probe lengths of `HT_STATS_PROBE_BINS` or more buckets all land
+// in the last bin of the histograms.
+#define HT_STATS_PROBE_BINS 16
+
+// Instrumentation gathered when compiled with `-DHT_STATS`. Bin `i`
+// of a histogram counts operations which examined `i + 1` buckets.
+typedef struct {
+    unsigned long search_probes[HT_STATS_PROBE_BINS];
+    unsigned long insert_probes[HT_STATS_PROBE_BINS];
+    unsigned long resizes;
+    unsigned long resize_ns;
+    unsigned long filter_rejects;
+    unsigned long bytes;
+    unsigned long peak_bytes;
+} ht_stats;
+#endif
+
+// Cache mode bookkeeping. `meta` and `expires` run parallel to the
+// bucket array: per bucket, the CLOCK bits of its item and the
+// monotonic time in ms after which it expires (0 for never).
+// `expires` is only allocated once an entry gets a TTL. A budget of 0
+// is no limit.
+#define HT_CACHE_REF 1
+#define HT_CACHE_HOT 2
+
+typedef struct {
+    size_t max_entries;
+    size_t max_bytes;
+    size_t bytes;
+    unsigned char* meta;
+    uint64_t* expires;
+    int hand;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long expirations;
+} ht_cache;
+
 // Hash table stores an array of pointers to
 // items, and some details about its size and
-// how full it is.
+// how full it is. `deleted` counts tombstones.
+// `filter`, when enabled, holds every key in the
+// table so most searches for absent keys end
+// without probing. `cache`, when enabled, bounds
+// the table and evicts to stay within it.
 typedef struct {
     int size_index;
     int size;
     int count;
+    int deleted;
     ht_item** items;
+    ht_filter* filter;
+    ht_cache* cache;
+#ifdef HT_STATS
+    ht_stats stats;
+#endif
 } ht_hash_table;
 
 // Hash table API
 ht_hash_table* ht_new();
+ht_hash_table* ht_new_capacity(const int count);
 void ht_del_hash_table(ht_hash_table* ht);
 void ht_insert(ht_hash_table* ht, const char* key, const char* value);
 char* ht_search(ht_hash_table* ht, const char* key);
 void ht_delete(ht_hash_table* h, const char* key);
-static int ht_generic_hash(const char* s, const int a, const int m);
-static int ht_hash(const char* s, const int num_buckets, const int attempt);
+void ht_stats_dump(ht_hash_table* ht, FILE* out);
+void ht_enable_filter(ht_hash_table* ht, const int bits_per_key);
+void ht_disable_filter(ht_hash_table* ht);
+void ht_enable_cache(ht_hash_table* ht, const size_t max_entries, const size_t max_bytes);
+void ht_insert_ttl(ht_hash_table* ht, const char* key, const char* value, const uint32_t ttl_ms);
+int ht_is_deleted(const ht_item* item);
+uint64_t ht_hash64(const char* s);
+int ht_hash(const char* s, const int num_buckets, const int attempt);
+void ht_probe_start(const char* s, const int num_buckets, int* index, int* step);
+
+// Bucket after `index` along a probe sequence started by
+// `ht_probe_start`. `step` is below `num_buckets`, so one subtraction
+// wraps it.
+static inline int ht_probe_next(const int index, const int step, const int num_buckets) {
+    const int next = index + step;
+    return next >= num_buckets ? next - num_buckets : next;
+}
 
 #endif  // HASH_TABLE_H_
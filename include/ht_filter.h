@@ -0,0 +1,33 @@
+//
+//  ht_filter.h
+//  hash_table
+//
+
+#ifndef HT_FILTER_H_
+#define HT_FILTER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Split block Bloom filter over 64-bit key hashes. Each key sets one bit
+// in each of the 8 32-bit words of a single 256-bit block, so a query
+// touches one cache line and its 8 word tests are independent of each
+// other, which compilers turn into a few vector instructions. There are
+// no false negatives; keys can't be removed, only the whole filter
+// rebuilt.
+#define HT_FILTER_WORDS 8
+
+typedef struct {
+    uint32_t* words;
+    uint32_t num_blocks;
+    int bits_per_key;
+} ht_filter;
+
+// Filter API
+ht_filter* ht_filter_new(const size_t num_keys, const int bits_per_key);
+void ht_filter_del(ht_filter* f);
+void ht_filter_add(ht_filter* f, const uint64_t hash);
+int ht_filter_may_contain(const ht_filter* f, const uint64_t hash);
+size_t ht_filter_bytes(const ht_filter* f);
+
+#endif  // HT_FILTER_H_
@@ -0,0 +1,82 @@
+//
+//  ht_hamt.h
+//  hash_table
+//
+//  Persistent map: a hash array mapped trie with the operations of
+//  `ht_hash_table` and O(1) snapshots.
+//
+//  Each level of the trie consumes `HT_HAMT_BITS` bits of `ht_hash64`.
+//  A node keeps a bitmap of which of its 32 slots are used and an array
+//  of only those slots. The population count of the bitmap below a
+//  slot's bit gives its position in the array, so a sparse node costs
+//  no more than its entries. A slot holds either a leaf, the key and
+//  value in one allocation, or the node one level down. Keys whose
+//  hashes agree on all 64 bits share a collision node at the bottom,
+//  searched linearly.
+//
+//  Nodes and leaves are reference counted. A snapshot is a new handle
+//  on the same root. An insert or delete on a handle copies the path
+//  from the root to the change, shares everything else with the other
+//  versions, and drops its reference to the old path. Nodes it alone
+//  holds are changed in place, so a handle with no live snapshots pays
+//  nothing for persistence. A node goes once the last version using it
+//  is deleted.
+//
+//  A handle is used by one thread at a time. Versions sharing nodes
+//  may be read, changed and deleted from different threads, as counts
+//  are atomic and shared nodes are never written.
+//
+
+#ifndef HT_HAMT_H_
+#define HT_HAMT_H_
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define HT_HAMT_BITS 5
+#define HT_HAMT_FANOUT (1 << HT_HAMT_BITS)
+
+// Build with e.g. `-DHT_HAMT_HASH_MASK=0xfff` to throw away hash bits
+// and force keys into collision nodes.
+#ifndef HT_HAMT_HASH_MASK
+#define HT_HAMT_HASH_MASK UINT64_MAX
+#endif
+
+// `value` points into `key`'s allocation, just past its terminator.
+typedef struct {
+    atomic_int refs;
+    uint64_t hash;
+    char* value;
+    char key[];
+} ht_hamt_leaf;
+
+// Slot `i` of a node is in use if bit `i` of `bitmap` is set. Slots
+// are tagged pointers: a leaf when the low bit is set and a node
+// otherwise. A collision node has no bitmap and `count` leaves.
+typedef struct {
+    atomic_int refs;
+    uint32_t bitmap;
+    int count;
+    void* slots[];
+} ht_hamt_node;
+
+// One version of the map. `root` is NULL when it is empty.
+typedef struct {
+    ht_hamt_node* root;
+    int count;
+} ht_hamt;
+
+// Persistent map API. `ht_hamt_search` returns the stored value, valid
+// until the key is changed in this version or the version is deleted.
+// `ht_hamt_rollback` points `h` at the contents of `snapshot`.
+ht_hamt* ht_hamt_new();
+ht_hamt* ht_hamt_snapshot(const ht_hamt* h);
+void ht_hamt_del(ht_hamt* h);
+void ht_hamt_insert(ht_hamt* h, const char* key, const char* value);
+char* ht_hamt_search(const ht_hamt* h, const char* key);
+void ht_hamt_delete(ht_hamt* h, const char* key);
+void ht_hamt_rollback(ht_hamt* h, const ht_hamt* snapshot);
+void ht_hamt_foreach(const ht_hamt* h, void (*fn)(const char* key, const char* value, void* arg),
+                     void* arg);
+
+#endif  // HT_HAMT_H_
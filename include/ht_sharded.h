@@ -0,0 +1,46 @@
+//
+//  ht_sharded.h
+//  hash_table
+//
+
+#ifndef HT_SHARDED_H_
+#define HT_SHARDED_H_
+
+#include <pthread.h>
+#include <stdio.h>
+
+#include "hash_table.h"
+
+// One independent `ht_hash_table` with its own lock. Shards are padded
+// to a cache line, and the array of them starts on one, so neighbouring
+// locks don't share a line.
+typedef struct {
+    ht_hash_table* table;
+    pthread_mutex_t lock;
+    int cpu;
+    char pad[64 - (sizeof(ht_hash_table*) + sizeof(pthread_mutex_t) + sizeof(int)) % 64];
+} ht_shard;
+
+// Sharded map: the top `shard_bits` of `ht_hash64` select the shard,
+// and each shard grows and shrinks on its own, so a resize only ever
+// rehashes 1/`num_shards` of the entries.
+typedef struct {
+    int shard_bits;
+    int num_shards;
+    ht_shard* shards;
+} ht_sharded_table;
+
+// Sharded hash table API
+ht_sharded_table* ht_sharded_new(const int shard_bits);
+ht_sharded_table* ht_sharded_new_affine(const int shard_bits, const int* cpus, const int num_cpus,
+                                        const int expected);
+void ht_sharded_del(ht_sharded_table* sh);
+void ht_sharded_insert(ht_sharded_table* sh, const char* key, const char* value);
+char* ht_sharded_search(ht_sharded_table* sh, const char* key);
+void ht_sharded_delete(ht_sharded_table* sh, const char* key);
+int ht_sharded_shard_of(ht_sharded_table* sh, const char* key);
+int ht_sharded_pin(ht_sharded_table* sh, const int shard);
+int ht_sharded_count(ht_sharded_table* sh);
+void ht_sharded_stats_dump(ht_sharded_table* sh, FILE* out);
+
+#endif  // HT_SHARDED_H_
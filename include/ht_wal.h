@@ -0,0 +1,78 @@
+//
+//  ht_wal.h
+//  hash_table
+//
+//  Write-ahead log for durable hash table mutations. Every insert and
+//  delete is appended to a log file as a binary record, and it returns
+//  once the record is on disk. Concurrent callers share one write and
+//  one `fdatasync` per group commit. Records are applied to the table
+//  only after their group is on disk, in log order, so searches never
+//  see a change that a crash could lose. A change whose record fails to
+//  be written is never applied.
+//
+//  Opening a log replays `<path>.ckpt`, the last checkpoint, and then
+//  `<path>` into a table presized from the number of records. A
+//  checkpoint rewrites the whole table to `<path>.ckpt` and truncates
+//  the log. This happens when the log outgrows `max_log_bytes` or when
+//  `ht_wal_checkpoint` is called.
+//
+//  Record layout, little endian as on the host:
+//      uint8 op, uint32 key_len, uint32 value_len, key, value,
+//      uint32 checksum of everything before it
+//  A torn or corrupt record ends the replay and is cut off the log. A
+//  corrupt checkpoint fails the open instead, as the next checkpoint
+//  would make the loss of its tail permanent.
+//
+
+#ifndef HT_WAL_H_
+#define HT_WAL_H_
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash_table.h"
+
+enum ht_wal_op { HT_WAL_INSERT = 1, HT_WAL_DELETE = 2 };
+
+// `lock` serializes mutations of `table` and the pending records in
+// `buf`. The thread that flushes a group swaps `buf` for `spare` and
+// writes it without holding the lock, so others keep appending.
+// Records are numbered in append order. `durable` is the last record
+// known to be on disk.
+typedef struct {
+    ht_hash_table* table;
+    char* path;
+    int fd;
+    int sync;
+    size_t max_log_bytes;
+    size_t log_bytes;
+    pthread_mutex_t lock;
+    pthread_cond_t flushed;
+    char* buf;
+    size_t len;
+    size_t cap;
+    char* spare;
+    size_t spare_cap;
+    uint64_t appended;
+    uint64_t durable;
+    int flushing;
+    int error;
+    unsigned long commits;
+    unsigned long checkpoints;
+} ht_wal;
+
+// Write-ahead log API. With `sync` 0 records are written to the file
+// without waiting for the disk. A `max_log_bytes` of 0 never
+// checkpoints on its own. Mutations return 0 once durable and visible
+// to `ht_wal_search`, or -1, leaving the table unchanged, if the log
+// could not be written, after which the log refuses writes.
+// `ht_wal_search` returns a copy of the value for the caller to free.
+ht_wal* ht_wal_open(const char* path, const int sync, const size_t max_log_bytes);
+void ht_wal_close(ht_wal* w);
+int ht_wal_insert(ht_wal* w, const char* key, const char* value);
+int ht_wal_delete(ht_wal* w, const char* key);
+char* ht_wal_search(ht_wal* w, const char* key);
+int ht_wal_checkpoint(ht_wal* w);
+
+#endif  // HT_WAL_H_
@@ -7,4 +7,46 @@ void *xcalloc (size_t nmemb, size_t size);
 void *xrealloc (void *ptr, size_t size);
 char *xstrdup (const char *s);
 
+/* Zeroed array starting on an `alignment` boundary, a power of two
+ * multiple of sizeof (void *), released with free.  */
+void *xcalloc_aligned (size_t alignment, size_t nmemb, size_t size);
+
+/* Large arrays: `xcalloc_large` backs arrays of XL_THRESHOLD bytes or
+ * more with their own anonymous mapping, aligned to huge pages, and
+ * `xfree_large` unmaps them again. Smaller ones fall back to xcalloc
+ * and free, so both must be given the same sizes. The mapping is
+ * zeroed lazily by the kernel as pages are first touched.
+ *
+ * `xlarge_policy` picks the page size and NUMA placement of later
+ * allocations:
+ *   XL_HUGE_THP     transparent huge pages, asked for with madvise
+ *   XL_HUGE_TLB     reserved huge pages (MAP_HUGETLB), else THP
+ *   XL_HUGE_NONE    base pages only
+ *   XL_NUMA_DEFAULT the kernel's default, first touch
+ *   XL_NUMA_LOCAL   the node of the thread that touches a page first
+ *   XL_NUMA_INTERLEAVE  round-robin over every online node
+ * Requests the system cannot meet fall back silently to the next
+ * best, which `xlarge_stats` records.  */
+#define XL_THRESHOLD (2UL << 20)
+#define XL_HUGE_THP 0
+#define XL_HUGE_TLB 1
+#define XL_HUGE_NONE 2
+#define XL_NUMA_DEFAULT 0
+#define XL_NUMA_LOCAL 1
+#define XL_NUMA_INTERLEAVE 2
+
+typedef struct {
+  unsigned long mapped;
+  unsigned long hugetlb;
+  unsigned long thp;
+  unsigned long fallbacks;
+  unsigned long numa_failed;
+  unsigned long bytes;
+} xlarge_stats;
+
+void xlarge_policy (int huge, int numa);
+void *xcalloc_large (size_t nmemb, size_t size);
+void xfree_large (void *ptr, size_t nmemb, size_t size);
+void xlarge_get_stats (xlarge_stats *stats);
+
 #endif
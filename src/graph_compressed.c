@@ -0,0 +1,310 @@
+//
+//  graph_compressed.c
+//  hash_table
+//
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+#include "xmalloc.h"
+
+#include "graph_compressed.h"
+
+// Gap bytes read past the last row by a whole-block decode.
+#define GC_PADDING 16
+
+// Encoded rows must stay within reach of the `uint32_t` row offsets.
+#define GC_MAX_BYTES UINT32_MAX
+
+// For every control byte, the number of gap bytes it describes and the
+// shuffle spreading those bytes into four little endian uint32s.
+static uint8_t gc_block_len[256];
+static uint8_t gc_shuffle[256][16];
+static pthread_once_t gc_tables_once = PTHREAD_ONCE_INIT;
+
+static void gc_init_tables() {
+    for (int c = 0; c < 256; c++) {
+        int pos = 0;
+        for (int i = 0; i < 4; i++) {
+            const int len = ((c >> (2 * i)) & 3) + 1;
+            for (int b = 0; b < 4; b++) {
+                gc_shuffle[c][4 * i + b] = b < len ? pos + b : 0x80;
+            }
+            pos += len;
+        }
+        gc_block_len[c] = pos;
+    }
+}
+
+static uint32_t gc_zigzag(const int x) {
+    return ((uint32_t)x << 1) ^ (uint32_t)(x >> 31);
+}
+
+static int gc_unzigzag(const uint32_t z) {
+    return (int)(z >> 1) ^ -(int)(z & 1);
+}
+
+static int gc_code(const uint32_t x) {
+    return x < (1u << 8) ? 0 : x < (1u << 16) ? 1 : x < (1u << 24) ? 2 : 3;
+}
+
+static uint8_t* gc_put_varint(uint8_t* p, uint32_t x) {
+    while (x >= 0x80) {
+        *p++ = (uint8_t)(x | 0x80);
+        x >>= 7;
+    }
+    *p++ = (uint8_t)x;
+    return p;
+}
+
+static const uint8_t* gc_get_varint(const uint8_t* p, int* x) {
+    uint32_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        value |= (uint32_t)(*p & 0x7f) << shift;
+        if (!(*p++ & 0x80)) {
+            break;
+        }
+    }
+    *x = (int)value;
+    return p;
+}
+
+// Encoding:
+// Rows are written back to back into a buffer sized for the worst case
+// (5 degree bytes, 2 weight bytes, a quarter control byte and 4 gap
+// bytes per edge), which is trimmed at the end. Weights are scaled so
+// the heaviest edge maps to 65535 and rounded, so a decoded weight is
+// within half a `weight_scale` of the original. Returns NULL if the
+// rows outgrow `GC_MAX_BYTES`.
+gc_graph* gc_build(const gk_csr* csr, const float* weights) {
+    pthread_once(&gc_tables_once, gc_init_tables);
+    gc_graph* g = xmalloc(sizeof(gc_graph));
+    g->n = csr->n;
+    g->m = csr->m;
+    g->N = csr->N;
+    g->nodes = xmalloc((size_t)csr->n * sizeof(node*));
+    memcpy(g->nodes, csr->nodes, (size_t)csr->n * sizeof(node*));
+    g->bucket_ids = xmalloc((size_t)csr->N->size * sizeof(int));
+    memcpy(g->bucket_ids, csr->bucket_ids, (size_t)csr->N->size * sizeof(int));
+
+    g->weighted = weights != NULL;
+    float max_weight = 0;
+    for (int e = 0; g->weighted && e < csr->m; e++) {
+        max_weight = fmaxf(max_weight, weights[e]);
+    }
+    g->weight_scale = max_weight > 0 ? max_weight / 65535.0f : 1.0f;
+
+    g->row = xmalloc(((size_t)csr->n + 1) * sizeof(uint32_t));
+    uint8_t* data = xmalloc(5 * (size_t)csr->n + 7 * (size_t)csr->m + GC_PADDING);
+    uint8_t* p = data;
+    for (int v = 0; v < csr->n; v++) {
+        const int begin = csr->offsets[v];
+        const int degree = csr->offsets[v + 1] - begin;
+        g->row[v] = (uint32_t)(p - data);
+        p = gc_put_varint(p, (uint32_t)degree);
+        if (g->weighted) {
+            for (int i = 0; i < degree; i++) {
+                const float q = lrintf(fmaxf(weights[begin + i], 0) / g->weight_scale);
+                const uint16_t w = q > 65535 ? 65535 : (uint16_t)q;
+                *p++ = (uint8_t)w;
+                *p++ = (uint8_t)(w >> 8);
+            }
+        }
+        uint8_t* control = p;
+        p += (degree + 3) / 4;
+        memset(control, 0, (size_t)(p - control));
+        int prev = v;
+        for (int i = 0; i < degree; i++) {
+            const int target = csr->targets[begin + i];
+            const uint32_t gap = i == 0 ? gc_zigzag(target - prev) : (uint32_t)(target - prev);
+            const int code = gc_code(gap);
+            control[i / 4] |= code << (2 * (i % 4));
+            for (int b = 0; b <= code; b++) {
+                *p++ = (uint8_t)(gap >> (8 * b));
+            }
+            prev = target;
+        }
+        if ((size_t)(p - data) > GC_MAX_BYTES) {
+            fprintf(stderr, "gc_build: rows past %zu bytes\n", (size_t)GC_MAX_BYTES);
+            free(data);
+            g->data = NULL;
+            gc_free(g);
+            return NULL;
+        }
+    }
+    g->row[csr->n] = (uint32_t)(p - data);
+    g->data_bytes = (size_t)(p - data);
+    memset(p, 0, GC_PADDING);
+    g->data = xrealloc(data, g->data_bytes + GC_PADDING);
+    return g;
+}
+
+void gc_free(gc_graph* g) {
+    free(g->row);
+    free(g->data);
+    free(g->nodes);
+    free(g->bucket_ids);
+    free(g);
+}
+
+// Bytes holding the adjacency: row offsets and encoded rows.
+size_t gc_bytes(const gc_graph* g) {
+    return ((size_t)g->n + 1) * sizeof(uint32_t) + g->data_bytes;
+}
+
+// Vertex id of the node with `key`, or -1 if the graph has none.
+int gc_vertex(const gc_graph* g, const char* key) {
+    const int index = find_node_index(g->N, key);
+    return index < 0 ? -1 : g->bucket_ids[index];
+}
+
+int gc_degree(const gc_graph* g, const int v) {
+    int degree;
+    gc_get_varint(g->data + g->row[v], &degree);
+    return degree;
+}
+
+// Decode the next four gaps of a row into `block`. Slots past the end
+// of the row decode garbage from the following bytes, which are never
+// returned.
+static void gc_decode_block(gc_iter* it) {
+    const uint8_t c = *it->control++;
+#ifdef __SSSE3__
+    const __m128i bytes = _mm_loadu_si128((const __m128i*)it->gaps);
+    const __m128i mask = _mm_loadu_si128((const __m128i*)gc_shuffle[c]);
+    _mm_storeu_si128((__m128i*)it->block, _mm_shuffle_epi8(bytes, mask));
+#else
+    const uint8_t* p = it->gaps;
+    for (int i = 0; i < 4; i++) {
+        const int len = ((c >> (2 * i)) & 3) + 1;
+        uint32_t gap = 0;
+        for (int b = 0; b < len; b++) {
+            gap |= (uint32_t)p[b] << (8 * b);
+        }
+        it->block[i] = gap;
+        p += len;
+    }
+#endif
+    it->gaps += gc_block_len[c];
+    it->block_len = it->remaining < 4 ? it->remaining : 4;
+    it->block_pos = 0;
+}
+
+// Gaps to targets, continuing from the last target returned.
+static void gc_accumulate(gc_iter* it, int i) {
+    for (; i < it->block_len; i++) {
+        it->target += (int)it->block[i];
+        it->block[i] = (uint32_t)it->target;
+    }
+}
+
+// Position `it` before the first edge leaving `v`.
+void gc_neighbours(const gc_graph* g, const int v, gc_iter* it) {
+    const uint8_t* p = gc_get_varint(g->data + g->row[v], &it->remaining);
+    it->weight_scale = g->weight_scale;
+    it->weights = g->weighted ? p : NULL;
+    if (g->weighted) {
+        p += 2 * (size_t)it->remaining;
+    }
+    it->control = p;
+    it->gaps = p + (it->remaining + 3) / 4;
+    it->block_len = 0;
+    it->block_pos = 0;
+    if (it->remaining > 0) {
+        gc_decode_block(it);
+        it->target = v + gc_unzigzag(it->block[0]);
+        it->block[0] = (uint32_t)it->target;
+        gc_accumulate(it, 1);
+    }
+}
+
+// Step to the next edge, leaving its target and weight (1 for
+// unweighted graphs, and `weight` may be NULL) in the out parameters.
+// Returns 0 once the row is exhausted.
+int gc_next(gc_iter* it, int* target, float* weight) {
+    if (it->remaining == 0) {
+        return 0;
+    }
+    if (it->block_pos == it->block_len) {
+        gc_decode_block(it);
+        gc_accumulate(it, 0);
+    }
+    *target = (int)it->block[it->block_pos++];
+    if (weight != NULL) {
+        if (it->weights != NULL) {
+            *weight = (it->weights[0] | it->weights[1] << 8) * it->weight_scale;
+            it->weights += 2;
+        } else {
+            *weight = 1.0f;
+        }
+    }
+    it->remaining--;
+    return 1;
+}
+
+// Breadth first search from `src`, as `gk_bfs`.
+int gc_bfs(const gc_graph* g, const int src, int* hops) {
+    int* queue = xmalloc((size_t)g->n * sizeof(int));
+    for (int v = 0; v < g->n; v++) {
+        hops[v] = -1;
+    }
+    int head = 0;
+    int tail = 0;
+    hops[src] = 0;
+    queue[tail++] = src;
+    gc_iter it;
+    int v;
+    while (head < tail) {
+        const int u = queue[head++];
+        gc_neighbours(g, u, &it);
+        while (gc_next(&it, &v, NULL)) {
+            if (hops[v] < 0) {
+                hops[v] = hops[u] + 1;
+                queue[tail++] = v;
+            }
+        }
+    }
+    free(queue);
+    return tail;
+}
+
+// Dijkstra with the lazy heap of graph_kernels.h over the decoded
+// weights, as its `sssp` kernels. Returns the number of vertices
+// settled.
+int gc_sssp(const gc_graph* g, const int src, float* dist) {
+    for (int v = 0; v < g->n; v++) {
+        dist[v] = INFINITY;
+    }
+    gk_heap_f32 heap = {0};
+    int settled = 0;
+    dist[src] = 0;
+    gk_heap_f32_push(&heap, 0, src);
+    gc_iter it;
+    int v;
+    float w;
+    while (heap.len > 0) {
+        float d;
+        const int u = gk_heap_f32_pop(&heap, &d);
+        if (d > dist[u]) {
+            continue;
+        }
+        settled++;
+        gc_neighbours(g, u, &it);
+        while (gc_next(&it, &v, &w)) {
+            const float nd = d + w;
+            if (nd < dist[v]) {
+                dist[v] = nd;
+                gk_heap_f32_push(&heap, nd, v);
+            }
+        }
+    }
+    gk_heap_f32_free(&heap);
+    return settled;
+}
@@ -8,6 +8,7 @@
 
 #include <stdio.h>
 #include <math.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -17,340 +18,464 @@
 #include "hash_table.h"
 #include "prime.h"
 
-// HT_DELETED_ITEM is used to mark a bucket containing a deleted item
-static edge DELETED_EDGE = {NULL, NULL};
-static edges DELETED_EDGES = {NULL, {NULL, NULL}};
-static node DELETED_NODE = {NULL, NULL};
-
-// PRIMEs are parameters in the hashing algorithm
-static const int PRIME_1 = 151;
-static const int PRIME_2 = 163;
 static const int INITIAL_BASE_SIZE = 0;
 
-// Define initialization functions for `node`s and `edge`s.
+// Define initialization functions for `node`s and `neighbour`s.
 // This function allocates a chunk of memory the size
-// of an `edge`, and saves a copy of the `key` and
-// float `distance`for edge, and `key` and `location` for the node,
-// in the new chunk of memory. The function is marked as
-// `static` because it will only ever be called by code internal to the
-// graph.
-
-static node* new_node(const char* key, gps* location) {
-    node* n = malloc(sizeof(node));
-    n->key = strdup(key);
+// of a `neighbour`, and saves a copy of the `key` and
+// takes ownership of the `distance` for the edge, and `key` and
+// `location` for the node. Deleting them later frees the `distance`
+// and `location` as well.
+
+gps* new_gps(const float lat, const float lon) {
+    gps* location = xmalloc(sizeof(gps));
+    location->lat = xmalloc(sizeof(float));
+    location->lon = xmalloc(sizeof(float));
+    *location->lat = lat;
+    *location->lon = lon;
+    return location;
+}
+
+node* new_node(const char* key, gps* location) {
+    node* n = xmalloc(sizeof(node));
+    n->key = xstrdup(key);
     n->location = location;
     return n;
 }
 
-static edge* new_edge(const char* node, float* distance) {
-    edge* n = malloc(sizeof(edge));
-    n->node = strdup(node);
+neighbour* new_neighbour(const char* node, float* distance) {
+    neighbour* n = xmalloc(sizeof(neighbour));
+    n->node = xstrdup(node);
     n->distance = distance;
     return n;
 }
 
-// `create_nodes` and `create_edge` initializes a new hash table.
-// `size` defines how many nodes and edges we can store for each,
-// fixed at 53 for now. Initialize the array of nodes and edges
+// `create_nodes`, `create_edges` and `create_neighbours` initialize a
+// new hash table. `size` defines how many nodes and edges we can store
+// for each, starting at 53. Initialize the array of nodes and edges
 // with `calloc`, which fills the allocated memory with `NULL`
 // bytes. A `NULL` entry in the array indicates that the bucket is empty.
+// The nodes and edges tables use `xcalloc_large`, which puts arrays of
+// 2 MB or more on huge pages; a node's own neighbours stay small.
 // Support creating a hash table of a certain size. To do this,
 // `create_edges_sized` and `create_nodes_sized` are called by `create_edges`
 // and `create_nodes`, respectively.
 
-edgeList* create_edges_list(char* n) {
-	edgeList* newEdgeList;
-	newEdgeList = (edgeList *) malloc (sizeof(edgeList));
-	newEdgeList->node = (char *)malloc(strlen(n) + 1);
-    strcpy(newEdgeList->node, n);
-    newEdgeList->next = NULL;
-	return newEdgeList;
+neighbours* create_neighbours(const char* node, const int size_index) {
+    neighbours* ns = xmalloc(sizeof(neighbours));
+    ns->node = xstrdup(node);
+    ns->size_index = size_index;
+
+    const int base_size = 50 << ns->size_index;
+    ns->size = next_prime(base_size);
+
+    ns->count = 0;
+    ns->neighbours = xcalloc((size_t)ns->size, sizeof(neighbour*));
+    return ns;
 }
 
+static edges_table* create_edges_sized(const int size_index) {
+    edges_table* E = xmalloc(sizeof(edges_table));
+    E->size_index = size_index;
 
-edges* create_edges_sized(const int size_index) {
-    edges* E = xmalloc(sizeof(edges));
-    if (E != NULL) {
-        const int base_size = 50 << E->size_index;
-        E->size = next_prime(base_size);
-        
-        E->esdgesStart = NULL;
-        E->count = 0;
-        E->esdgesStart;
-        E->edges = xcalloc((size_t)E->size, sizeof(edges*));
-        if (E->edges == NULL) {
-            free(E);
-            return NULL;
-        }
-    }
+    const int base_size = 50 << E->size_index;
+    E->size = next_prime(base_size);
+
+    E->count = 0;
+    E->neighbours = xcalloc_large((size_t)E->size, sizeof(neighbours*));
     return E;
 }
 
-edges* create_edges() {
+edges_table* create_edges() {
     return create_edges_sized(INITIAL_BASE_SIZE);
 }
 
-static nodes* create_nodes_sized(const int size_index) {
-    nodes* N = xmalloc(sizeof(nodes));
+static nodes_table* create_nodes_sized(const int size_index) {
+    nodes_table* N = xmalloc(sizeof(nodes_table));
     N->size_index = size_index;
-    
+
     const int base_size = 50 << N->size_index;
     N->size = next_prime(base_size);
-    
+
     N->count = 0;
-    N->nodes = xcalloc((size_t)N->size, sizeof(node*));
+    N->nodes = xcalloc_large((size_t)N->size, sizeof(node*));
     return N;
 }
 
-nodes* create_nodes() {
+nodes_table* create_nodes() {
     return create_nodes_sized(INITIAL_BASE_SIZE);
 }
 
 // Create a graph from the nodes and edges tables.
 graph* create_graph() {
-    edges* E = create_edges_table();
-    nodes* N = create_nodes();
     graph* G = xmalloc(sizeof(graph));
-    G->N = N;
-    G->E = E;
+    G->N = create_nodes();
+    G->E = create_edges();
     return G;
 }
 
+// Deleting nodes, edges and their tables
+
+static void delete_node(node* n) {
+    gps* location = n->location;
+    if (location != NULL) {
+        free(location->lat);
+        free(location->lon);
+        free(location);
+    }
+    free(n->key);
+    free(n);
+}
+
+static void delete_neighbour(neighbour* n) {
+    free(n->node);
+    free(n->distance);
+    free(n);
+}
+
+static void delete_neighbours(neighbours* ns) {
+    for (int i = 0; i < ns->size; i++) {
+        neighbour* n = ns->neighbours[i];
+        if (n != NULL) {
+            delete_neighbour(n);
+        }
+    }
+    free(ns->neighbours);
+    free(ns->node);
+    free(ns);
+}
+
+void delete_edges(edges_table* E) {
+    for (int i = 0; i < E->size; i++) {
+        neighbours* ns = E->neighbours[i];
+        if (ns != NULL) {
+            delete_neighbours(ns);
+        }
+    }
+    xfree_large(E->neighbours, (size_t)E->size, sizeof(neighbours*));
+    free(E);
+}
+
+void delete_nodes(nodes_table* N) {
+    for (int i = 0; i < N->size; i++) {
+        node* n = N->nodes[i];
+        if (n != NULL) {
+            delete_node(n);
+        }
+    }
+    xfree_large(N->nodes, (size_t)N->size, sizeof(node*));
+    free(N);
+}
+
+void delete_graph(graph* G) {
+    delete_nodes(G->N);
+    delete_edges(G->E);
+    free(G);
+}
+
 // Resize:
-// Ensure size of edges or nodes table is not being resized below its minimum.
-// Initialize new hash table with desired size. All non-`NULL` or
-// deleted items are inserted into the new hash table. Then swap
-// attributes of the new and old hash tables before deleting the latter.
-static void resize_nodes(nodes* N, const int direction) {
+// Ensure size of edges or nodes table is not being resized below its
+// minimum. Allocate a bucket array of the desired size and move every
+// entry into it along its probe sequence. Entries are unique by key,
+// so the first empty bucket is the right one. Then free the old array.
+
+static void resize_nodes(nodes_table* N, const int direction) {
     const int new_size_index = N->size_index + direction;
     if (new_size_index < INITIAL_BASE_SIZE) {
         // Don't resize down the smallest hash table
         return;
     }
-    // Create a temporary new hash table to insert items into
-    nodes* new_N = create_nodes_sized(new_size_index);
-    // Iterate through existing hash table, add all items to new
+    const int new_size = next_prime(50 << new_size_index);
+    node** new_nodes = xcalloc_large((size_t)new_size, sizeof(node*));
     for (int i = 0; i < N->size; i++) {
-        node* node = N->nodes[i];
-        if (node != &DELETED_NODE) {
-            add_node(N, node);
+        node* n = N->nodes[i];
+        if (n != NULL) {
+            int index;
+            int step;
+            ht_probe_start(n->key, new_size, &index, &step);
+            while (new_nodes[index] != NULL) {
+                index = ht_probe_next(index, step, new_size);
+            }
+            new_nodes[index] = n;
         }
     }
-    
-    // Pass new_ht and ht's properties. Delete new_ht
-    N->size_index = new_N->size_index;
-    N->count = new_N->count;
-    
-    // To delete new_ht, we give it ht's size and items
-    const int tmp_size = N->size;
-    N->size = new_N->size;
-    new_N->size = tmp_size;
-    
-    node** tmp_nodes = N->nodes;
-    N->nodes = new_N->nodes;
-    new_N->nodes = tmp_nodes;
-    
-    delete_nodes(new_N);
+    xfree_large(N->nodes, (size_t)N->size, sizeof(node*));
+    N->nodes = new_nodes;
+    N->size = new_size;
+    N->size_index = new_size_index;
 }
 
-static void resize_edges(edges* N, const int direction) {
-    const int new_size_index = N->size_index + direction;
+static void resize_neighbours(neighbours* ns, const int direction) {
+    const int new_size_index = ns->size_index + direction;
     if (new_size_index < INITIAL_BASE_SIZE) {
         return;
     }
-    edges* new_N = create_edges(new_size_index);
-    for (int i = 0; i < N->size; i++) {
-        edge* n = N->edges[i];
-        if (n != NULL && n != &DELETED_EDGE) {
-            add_edge(N, n);
+    const int new_size = next_prime(50 << new_size_index);
+    neighbour** new_neighbours = xcalloc((size_t)new_size, sizeof(neighbour*));
+    for (int i = 0; i < ns->size; i++) {
+        neighbour* n = ns->neighbours[i];
+        if (n != NULL) {
+            int index;
+            int step;
+            ht_probe_start(n->node, new_size, &index, &step);
+            while (new_neighbours[index] != NULL) {
+                index = ht_probe_next(index, step, new_size);
+            }
+            new_neighbours[index] = n;
         }
     }
-    N->size = new_N->size;
-    N->count = new_N->count;
-    
-    const int tmp_size = N->size;
-    N->size = new_N->size;
-    new_N->size = tmp_size;
-    
-    edge** tmp_edges = N->edges;
-    N->edges = new_N->edges;
-    new_N->edges = tmp_edges;
-    
-    delete_edges(new_N);
+    free(ns->neighbours);
+    ns->neighbours = new_neighbours;
+    ns->size = new_size;
+    ns->size_index = new_size_index;
 }
 
-static void resize_edges(edges* E, const int direction) {
+static void resize_edges(edges_table* E, const int direction) {
     const int new_size_index = E->size_index + direction;
     if (new_size_index < INITIAL_BASE_SIZE) {
-        // Don't resize down the smallest hash table
         return;
     }
-    // Create a temporary new hash table to insert items into
-    edges* new_E = create_edges_sized(new_size_index);
-    // Iterate through existing hash table, add all items to new
+    const int new_size = next_prime(50 << new_size_index);
+    neighbours** new_neighbours = xcalloc_large((size_t)new_size, sizeof(neighbours*));
     for (int i = 0; i < E->size; i++) {
-        edges* n = E->edges[i];
-        if (n != NULL && n != &DELETED_EDGES) {
-            add_edges(E, n);
+        neighbours* ns = E->neighbours[i];
+        if (ns != NULL) {
+            int index;
+            int step;
+            ht_probe_start(ns->node, new_size, &index, &step);
+            while (new_neighbours[index] != NULL) {
+                index = ht_probe_next(index, step, new_size);
+            }
+            new_neighbours[index] = ns;
         }
     }
-    
-    // Pass new_ht and ht's properties. Delete new_ht
-    E->size_index = new_E->size_index;
-    E->count = new_E->count;
-    
-    // To delete new_ht, we give it ht's size and items
-    const int tmp_size = E->size;
-    E->size = new_E->size;
-    new_E->size = tmp_size;
-    
-    edges** tmp_edges = E->edges;
-    E->edges = new_E->edges;
-    new_E->edges = tmp_edges;
-    
-    delete_edges_table(new_E);
+    xfree_large(E->neighbours, (size_t)E->size, sizeof(neighbours*));
+    E->neighbours = new_neighbours;
+    E->size = new_size;
+    E->size_index = new_size_index;
 }
 
-// Deleting edge and edges table
-
-static void delete_node(node* n) {
-    gps* location = n->location;
-    free(location->lat);
-    free(location->lon);
-    free(n->location);
-    free(n->key);
-    free(n);
+// Insertion of a new node or edge:
+// Iterate through indexes until an empty bucket is
+// found, where the entry will be inserted and the hash
+// table's `count` attribute incremented to indicate
+// insertion of a new entry. If an entry with the same key is
+// found it is deleted and the new entry takes its bucket.
+// To perform resizing, check load on hash table during inserts.
+void add_node(nodes_table* N, node* n) {
+    const int load = N->count * 100 / N->size;
+    if (load > 70) {
+        resize_nodes(N, 1);
+    }
+    int index;
+    int step;
+    ht_probe_start(n->key, N->size, &index, &step);
+    node* cur_node = N->nodes[index];
+    while(cur_node != NULL) {
+        if (strcmp(cur_node->key, n->key) == 0) {
+            delete_node(cur_node);
+            N->nodes[index] = n;
+            return;
+        }
+        index = ht_probe_next(index, step, N->size);
+        cur_node = N->nodes[index];
+    }
+    N->nodes[index] = n;
+    N->count++;
 }
 
-
-void delete_edge(edges* N, edge* n) {
-    for (int i = 0; i < N->size; i++) {
-        edge* existing_n = N->edges[i];
-        if (strcmp(n->node, existing_n->node)) {
-            free(n->node);
-            free(n->distance);
-            free(n);
-            N->edges[i] = &DELETED_EDGE;
+static void add_neighbour(neighbours* ns, neighbour* n) {
+    const int load = ns->count * 100 / ns->size;
+    if (load > 70) {
+        resize_neighbours(ns, 1);
+    }
+    int index;
+    int step;
+    ht_probe_start(n->node, ns->size, &index, &step);
+    neighbour* cur = ns->neighbours[index];
+    while(cur != NULL) {
+        if (strcmp(cur->node, n->node) == 0) {
+            delete_neighbour(cur);
+            ns->neighbours[index] = n;
+            return;
         }
+        index = ht_probe_next(index, step, ns->size);
+        cur = ns->neighbours[index];
     }
+    ns->neighbours[index] = n;
+    ns->count++;
 }
 
-void delete_edges(edges* N) {
-    for (int i = 0; i < N->size; i++) {
-        edge* n = N->edges[i];
-        if (n != NULL && n != &DELETED_EDGE) {
-            delete_edge(N, n);
+// Add the edge `from` -> `n->node`. The first edge leaving `from`
+// creates its `neighbours` table, which starts at the smallest size.
+void add_edge(edges_table* E, const char* from, neighbour* n) {
+    neighbours* ns = find_neighbours(E, from);
+    if (ns != NULL) {
+        add_neighbour(ns, n);
+        return;
+    }
+    const int load = E->count * 100 / E->size;
+    if (load > 70) {
+        resize_edges(E, 1);
+    }
+    int index;
+    int step;
+    ht_probe_start(from, E->size, &index, &step);
+    while (E->neighbours[index] != NULL) {
+        index = ht_probe_next(index, step, E->size);
+    }
+    ns = create_neighbours(from, INITIAL_BASE_SIZE);
+    add_neighbour(ns, n);
+    E->neighbours[index] = ns;
+    E->count++;
+}
+
+// Searching for keys:
+// At iteration of the `while` loop check whether the entry's key matches
+// the key of interest and return it if found. If the `while` loop
+// reaches a `NULL` value then return `NULL` indicating that the entry
+// was not found.
+int find_node_index(nodes_table* N, const char* key) {
+    int index;
+    int step;
+    ht_probe_start(key, N->size, &index, &step);
+    node* n = N->nodes[index];
+    while (n != NULL) {
+        if (strcmp(n->key, key) == 0) {
+            return index;
         }
+        index = ht_probe_next(index, step, N->size);
+        n = N->nodes[index];
     }
-    free(N->edges);
-    free(N);
+    return -1;
 }
 
+node* find_node(nodes_table* N, const char* key) {
+    const int index = find_node_index(N, key);
+    return index < 0 ? NULL : N->nodes[index];
+}
 
-void delete_edges_table(edges* E) {
-    for (int i = 0; i < E->size; i++) {
-        edges* N = E->edges;
-        delete_edges(N);
+neighbours* find_neighbours(edges_table* E, const char* key) {
+    int index;
+    int step;
+    ht_probe_start(key, E->size, &index, &step);
+    neighbours* ns = E->neighbours[index];
+    while (ns != NULL) {
+        if (strcmp(ns->node, key) == 0) {
+            return ns;
+        }
+        index = ht_probe_next(index, step, E->size);
+        ns = E->neighbours[index];
     }
-    free(E->edges);
-    free(E->)
+    return NULL;
 }
 
-void delete_nodes(nodes* N) {
-    for (int i = 0; i < N->size; i++) {
-        node* n = N->nodes[i];
-        if (n != NULL && n != &DELETED_NODE) {
-            delete_node(n);
+neighbour* find_neighbour(neighbours* ns, const char* key) {
+    int index;
+    int step;
+    ht_probe_start(key, ns->size, &index, &step);
+    neighbour* n = ns->neighbours[index];
+    while (n != NULL) {
+        if (strcmp(n->node, key) == 0) {
+            return n;
         }
+        index = ht_probe_next(index, step, ns->size);
+        n = ns->neighbours[index];
     }
-    free(N->nodes);
-    free(N);
+    return NULL;
 }
 
-// Insertion of a new key-value pair:
-// Iterate through indexes until an empty bucket is
-// found, where the item will be inserted and the hash
-// table's `count` attribute incremented to indicate
-// insertion of a new item. This is useful for
-// resizing. If encountering a deleted item, the new node
-// can be inserted in its place. If two items are inserted into the
-// same key, the keys will collide and the second item will be inserted
-// into the next available bucket. When searching for the key, the
-// original key will always be found and the second item will be
-// inaccessible. To handle this, the previous item can be deleted
-// and the new item inserted in its place.
-// To perform resizing, check load on hash table during inserts and deletes.
-void add_edge(edges* E, edge* n) {
-    const int load = E->count * 100 / E->size;
-    if (load > 70) {
-        resize_edges(E, 1);
-    }
-    int index = ht_hash(n->node, E->size, 0);
-    edges* cur_edge = E->edges[index];
-    int i = 1;
-    while(cur_edge != NULL) {
-        if (cur_edge != &DELETED_EDGE) {
-            if (strcmp(cur_edge->node, n->node) == 0) {
-                delete_edge(cur_edge);
-                E->edges[index] = n;
-                return;
-            }
+// Statistics:
+// The graph tables keep no counters of their own. Instead every stored
+// key is probed for again and the number of buckets examined is
+// recorded, giving the histogram of successful search lengths at no
+// cost to the tables themselves. Byte counts are estimates of the
+// allocations made for each table.
+
+#define GRAPH_PROBE_BINS 16
+
+static int probe_length(const char* key, const int size, void** buckets, const int key_offset) {
+    int attempt = 0;
+    int index;
+    int step;
+    ht_probe_start(key, size, &index, &step);
+    while (buckets[index] != NULL) {
+        const char* cur = *(char**)((char*)buckets[index] + key_offset);
+        if (strcmp(cur, key) == 0) {
+            break;
         }
-        index = ht_hash(n->node, E->size, i);
-        cur_edge = E->edges[index];
-        i++;
+        index = ht_probe_next(index, step, size);
+        attempt++;
     }
-    E->edges[index] = n;
-    E->count++;
+    return attempt + 1;
 }
 
-void add_node(nodes* N, node* n) {
-    const int load = N->count * 100 / N->size;
-    if (load > 70) {
-        resize_nodes(N, 1);
+static void print_probes(FILE* out, const char* name, const unsigned long* hist) {
+    unsigned long ops = 0;
+    unsigned long probes = 0;
+    for (int b = 0; b < GRAPH_PROBE_BINS; b++) {
+        ops += hist[b];
+        probes += hist[b] * (b + 1);
     }
-    int index = ht_hash(n->key, N->size, 0);
-    node* cur_node = N->nodes[index];
-    int i = 1;
-    while(cur_node != NULL) {
-        if (cur_node != &DELETED_NODE) {
-            if (strcmp(cur_node->key, n->key) == 0) {
-                delete_node(cur_node);
-                N->nodes[index] = n;
-                return;
-            }
-        }
-        index = ht_hash(n->key, N->size, i);
-        cur_node = N->nodes[index];
-        i++;
+    fprintf(out, "%s probes: keys %lu mean %.2f |", name, ops,
+            ops ? (double)probes / ops : 0.0);
+    for (int b = 0; b < GRAPH_PROBE_BINS; b++) {
+        fprintf(out, " %lu", hist[b]);
     }
-    N->nodes[index] = n;
-    N->count++;
+    fprintf(out, "\n");
 }
 
-// Searching for keys:
-// At iteration of the `while` loop check whether the item's key matches
-// the key of interest and return the value if found. If the `while` loop
-// reaches a `NULL` value then return `NULL` indicating that the item
-// was not found. Ignore and jump over item marked as deleted.
-node* find_node(nodes* N, const char* key) {
-    int index = ht_hash(key, N->size, 0);
-    node* n = N->nodes[index];
-    int i = 1;
-    while (n != NULL) {
-        if (n != &DELETED_NODE) {
-            if (strcmp(n->key, key) == 0) {
-                return n;
+static void record_probe(unsigned long* hist, const int probes) {
+    hist[(probes < GRAPH_PROBE_BINS ? probes : GRAPH_PROBE_BINS) - 1]++;
+}
+
+void graph_stats_dump(graph* G, FILE* out) {
+    nodes_table* N = G->N;
+    edges_table* E = G->E;
+    unsigned long node_probes[GRAPH_PROBE_BINS] = {0};
+    unsigned long source_probes[GRAPH_PROBE_BINS] = {0};
+    unsigned long edge_probes[GRAPH_PROBE_BINS] = {0};
+    unsigned long node_bytes = sizeof(nodes_table) + N->size * sizeof(node*);
+    unsigned long edge_bytes = sizeof(edges_table) + E->size * sizeof(neighbours*);
+    long num_edges = 0;
+
+    for (int i = 0; i < N->size; i++) {
+        node* n = N->nodes[i];
+        if (n != NULL) {
+            record_probe(node_probes, probe_length(n->key, N->size,
+                         (void**)N->nodes, offsetof(node, key)));
+            node_bytes += sizeof(node) + strlen(n->key) + 1;
+            if (n->location != NULL) {
+                node_bytes += sizeof(gps) + 2 * sizeof(float);
+            }
+        }
+    }
+    for (int i = 0; i < E->size; i++) {
+        neighbours* ns = E->neighbours[i];
+        if (ns == NULL) {
+            continue;
+        }
+        record_probe(source_probes, probe_length(ns->node, E->size,
+                     (void**)E->neighbours, offsetof(neighbours, node)));
+        edge_bytes += sizeof(neighbours) + strlen(ns->node) + 1
+                      + ns->size * sizeof(neighbour*);
+        for (int j = 0; j < ns->size; j++) {
+            neighbour* n = ns->neighbours[j];
+            if (n != NULL) {
+                record_probe(edge_probes, probe_length(n->node, ns->size,
+                             (void**)ns->neighbours, offsetof(neighbour, node)));
+                edge_bytes += sizeof(neighbour) + strlen(n->node) + 1 + sizeof(float);
+                num_edges++;
             }
         }
-        index = ht_hash(key, N->size, i);
-        n = N->nodes[index];
-        i++;
     }
-    return NULL;
-}
 
-edge** find_edges(edges* E, const char* key) {
-    int index = ht_hash(key, E->size, 0);
-    edge** n = E->edges[index];
+    fprintf(out, "nodes: size %d count %d load %d%% bytes %lu\n",
+            N->size, N->count, N->count * 100 / N->size, node_bytes);
+    fprintf(out, "edges: sources %d edges %ld bytes %lu (%.1f B/edge)\n",
+            E->count, num_edges, edge_bytes,
+            num_edges ? (double)edge_bytes / num_edges : 0.0);
+    print_probes(out, "node", node_probes);
+    print_probes(out, "source", source_probes);
+    print_probes(out, "edge", edge_probes);
 }
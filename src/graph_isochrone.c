@@ -0,0 +1,348 @@
+//
+//  graph_isochrone.c
+//  hash_table
+//
+
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xmalloc.h"
+
+#include "graph_isochrone.h"
+
+#define GI_CHUNK 64
+#define GI_NO_BIN INT_MAX
+// Bucket of every distance from `GI_MAX_BINS - 1` widths on. Far
+// vertices share it and are relaxed over and over until it empties,
+// which is slower than proper buckets but keeps a small `delta` with
+// long distances from needing billions of them.
+#define GI_MAX_BINS (1 << 16)
+#define GI_INF 0x7f800000u
+
+static uint32_t gi_bits(const float f) {
+    uint32_t b;
+    memcpy(&b, &f, sizeof(b));
+    return b;
+}
+
+static float gi_float(const uint32_t b) {
+    float f;
+    memcpy(&f, &b, sizeof(f));
+    return f;
+}
+
+static void gi_push(gi_vec* v, const int id) {
+    if (v->len == v->cap) {
+        v->cap = v->cap ? v->cap * 2 : 64;
+        v->ids = xrealloc(v->ids, (size_t)v->cap * sizeof(int));
+    }
+    v->ids[v->len++] = id;
+}
+
+static gi_vec* gi_bin(gi_local* l, const int b) {
+    if (b >= l->num_bins) {
+        int num_bins = l->num_bins ? l->num_bins : 64;
+        while (num_bins <= b) {
+            num_bins *= 2;
+        }
+        l->bins = xrealloc(l->bins, (size_t)num_bins * sizeof(gi_vec));
+        memset(l->bins + l->num_bins, 0, (size_t)(num_bins - l->num_bins) * sizeof(gi_vec));
+        l->num_bins = num_bins;
+    }
+    return &l->bins[b];
+}
+
+// Relax the edges leaving `u`. Whichever thread lowers a distance files
+// the vertex under its new bucket, and the one that lowers it from
+// infinity also records it as touched. Nothing past the budget is kept.
+// Rounding may put a distance just under the bucket being relaxed, so
+// it is filed in that bucket rather than in an earlier, finished one.
+static void gi_relax(gi_searcher* s, gi_local* l, const int bin, const int u, const float du) {
+    const gk_csr* csr = &s->g->csr;
+    for (int e = csr->offsets[u]; e < csr->offsets[u + 1]; e++) {
+        const int v = csr->targets[e];
+        const float nd = du + s->g->weights[e];
+        if (!(nd <= s->budget)) {
+            continue;
+        }
+        const uint32_t bits = gi_bits(nd);
+        uint32_t old = atomic_load_explicit(&s->dist[v], memory_order_relaxed);
+        while (bits < old) {
+            if (atomic_compare_exchange_weak_explicit(&s->dist[v], &old, bits,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                if (old == GI_INF) {
+                    gi_push(&l->touched, v);
+                }
+                const float q = nd / s->delta;
+                const int b = q < GI_MAX_BINS - 1 ? (int)q : GI_MAX_BINS - 1;
+                gi_push(gi_bin(l, b > bin ? b : bin), v);
+                l->relaxed++;
+                break;
+            }
+        }
+    }
+}
+
+// One thread's share of a search. Each round has three phases separated
+// by barriers: relax the frontier, agree on the lowest non-empty bucket
+// left, and gather that bucket into the next frontier. A frontier entry
+// whose distance has since dropped below the bucket was already relaxed
+// from an earlier one and is skipped. The search ends when no thread
+// has a non-empty bucket.
+static void gi_search(gi_searcher* s, const int tid) {
+    gi_local* l = &s->locals[tid];
+    int bin = 0;
+    for (;;) {
+        const int queued = atomic_load(&s->frontier_len);
+        const int len = queued < s->frontier_cap ? queued : s->frontier_cap;
+        const float lower = bin * s->delta;
+        for (;;) {
+            const int begin = atomic_fetch_add(&s->next_index, GI_CHUNK);
+            if (begin >= len) {
+                break;
+            }
+            const int end = begin + GI_CHUNK < len ? begin + GI_CHUNK : len;
+            for (int i = begin; i < end; i++) {
+                const int u = s->frontier[i];
+                const float du = gi_float(atomic_load_explicit(&s->dist[u],
+                                                               memory_order_relaxed));
+                if (du >= lower) {
+                    gi_relax(s, l, bin, u, du);
+                }
+            }
+        }
+        pthread_barrier_wait(&s->phase);
+
+        if (tid == 0) {
+            atomic_store(&s->frontier_len, 0);
+            atomic_store(&s->next_index, 0);
+        }
+        int mine = GI_NO_BIN;
+        for (int b = bin; b < l->num_bins; b++) {
+            if (l->bins[b].len > 0) {
+                mine = b;
+                break;
+            }
+        }
+        int lowest = atomic_load(&s->next_bin);
+        while (mine < lowest && !atomic_compare_exchange_weak(&s->next_bin, &lowest, mine)) {
+        }
+        pthread_barrier_wait(&s->phase);
+
+        bin = atomic_load(&s->next_bin);
+        if (bin == GI_NO_BIN) {
+            return;
+        }
+        // Whatever does not fit stays in the bucket for the next round
+        if (bin < l->num_bins && l->bins[bin].len > 0) {
+            gi_vec* v = &l->bins[bin];
+            const int at = atomic_fetch_add(&s->frontier_len, v->len);
+            const int room = at < s->frontier_cap ? s->frontier_cap - at : 0;
+            const int moved = v->len < room ? v->len : room;
+            memcpy(s->frontier + at, v->ids, (size_t)moved * sizeof(int));
+            memmove(v->ids, v->ids + moved, (size_t)(v->len - moved) * sizeof(int));
+            v->len -= moved;
+        }
+        pthread_barrier_wait(&s->phase);
+        if (tid == 0) {
+            atomic_store(&s->next_bin, GI_NO_BIN);
+        }
+    }
+}
+
+typedef struct {
+    gi_searcher* s;
+    int tid;
+} gi_worker_args;
+
+static void* gi_worker(void* arg) {
+    gi_worker_args* a = arg;
+    gi_searcher* s = a->s;
+    const int tid = a->tid;
+    free(a);
+    pthread_mutex_lock(&s->ready);
+    pthread_mutex_unlock(&s->ready);
+    for (;;) {
+        pthread_barrier_wait(&s->start);
+        if (s->stop) {
+            return NULL;
+        }
+        gi_search(s, tid);
+    }
+}
+
+gi_searcher* gi_new(const gk_f32_dir_graph* g, const float delta, const int num_threads) {
+    gi_searcher* s = xcalloc(1, sizeof(gi_searcher));
+    const gk_csr* csr = &g->csr;
+    s->g = g;
+    s->delta = delta;
+    if (!(s->delta > 0)) {
+        double sum = 0;
+        for (int e = 0; e < csr->m; e++) {
+            sum += g->weights[e];
+        }
+        s->delta = csr->m > 0 && sum > 0 ? (float)(sum / csr->m) : 1.0f;
+    }
+    const int wanted = num_threads > 0 ? num_threads : 1;
+    s->dist = xmalloc((size_t)csr->n * sizeof(uint32_t));
+    for (int v = 0; v < csr->n; v++) {
+        atomic_init(&s->dist[v], GI_INF);
+    }
+    // Roughly one entry per edge into the bucket at most
+    s->frontier_cap = csr->m + csr->n + 1;
+    s->frontier = xmalloc((size_t)s->frontier_cap * sizeof(int));
+    atomic_init(&s->frontier_len, 0);
+    atomic_init(&s->next_index, 0);
+    atomic_init(&s->next_bin, GI_NO_BIN);
+    s->locals = xcalloc((size_t)wanted, sizeof(gi_local));
+    s->threads = xmalloc((size_t)wanted * sizeof(pthread_t));
+    // Started threads take the lowest ids. Searches hand out work in
+    // chunks, so a pool short of threads that failed to start is only
+    // slower.
+    pthread_mutex_init(&s->ready, NULL);
+    pthread_mutex_lock(&s->ready);
+    s->num_threads = 1;
+    for (int t = 1; t < wanted; t++) {
+        gi_worker_args* a = xmalloc(sizeof(gi_worker_args));
+        a->s = s;
+        a->tid = s->num_threads;
+        if (pthread_create(&s->threads[s->num_threads], NULL, gi_worker, a) == 0) {
+            s->num_threads++;
+        } else {
+            free(a);
+        }
+    }
+    pthread_barrier_init(&s->start, NULL, (unsigned)s->num_threads);
+    pthread_barrier_init(&s->phase, NULL, (unsigned)s->num_threads);
+    pthread_mutex_unlock(&s->ready);
+    return s;
+}
+
+void gi_del(gi_searcher* s) {
+    s->stop = 1;
+    pthread_barrier_wait(&s->start);
+    for (int t = 1; t < s->num_threads; t++) {
+        pthread_join(s->threads[t], NULL);
+    }
+    pthread_barrier_destroy(&s->start);
+    pthread_barrier_destroy(&s->phase);
+    pthread_mutex_destroy(&s->ready);
+    for (int t = 0; t < s->num_threads; t++) {
+        for (int b = 0; b < s->locals[t].num_bins; b++) {
+            free(s->locals[t].bins[b].ids);
+        }
+        free(s->locals[t].bins);
+        free(s->locals[t].touched.ids);
+    }
+    free(s->locals);
+    free(s->threads);
+    free(s->frontier);
+    free(s->dist);
+    free(s);
+}
+
+// Run one search from `src` on the whole pool. Afterwards the vertices
+// reached are on the threads' `touched` lists, with their distances
+// still in `dist` until `gi_reset` clears them.
+static void gi_run(gi_searcher* s, const int src, const float budget) {
+    s->src = src;
+    s->budget = budget;
+    atomic_store_explicit(&s->dist[src], 0, memory_order_relaxed);
+    gi_push(&s->locals[0].touched, src);
+    s->frontier[0] = src;
+    atomic_store(&s->frontier_len, 1);
+    atomic_store(&s->next_index, 0);
+    pthread_barrier_wait(&s->start);
+    gi_search(s, 0);
+    s->searches++;
+    for (int t = 0; t < s->num_threads; t++) {
+        s->relaxed += s->locals[t].relaxed;
+        s->locals[t].relaxed = 0;
+    }
+}
+
+static void gi_reset(gi_searcher* s) {
+    for (int t = 0; t < s->num_threads; t++) {
+        gi_vec* touched = &s->locals[t].touched;
+        for (int i = 0; i < touched->len; i++) {
+            atomic_store_explicit(&s->dist[touched->ids[i]], GI_INF, memory_order_relaxed);
+        }
+        touched->len = 0;
+    }
+}
+
+// One-to-all distances from `src` into `dist`, which holds `INFINITY`
+// for unreachable vertices. Returns the number of vertices reached.
+int gi_sssp(gi_searcher* s, const int src, float* dist) {
+    const int n = s->g->csr.n;
+    for (int v = 0; v < n; v++) {
+        dist[v] = INFINITY;
+    }
+    if (src < 0 || src >= n) {
+        return 0;
+    }
+    gi_run(s, src, INFINITY);
+    int reached = 0;
+    for (int t = 0; t < s->num_threads; t++) {
+        const gi_vec* touched = &s->locals[t].touched;
+        for (int i = 0; i < touched->len; i++) {
+            const int v = touched->ids[i];
+            dist[v] = gi_float(atomic_load_explicit(&s->dist[v], memory_order_relaxed));
+        }
+        reached += touched->len;
+    }
+    gi_reset(s);
+    return reached;
+}
+
+// Every vertex within `budget` of `src`. Returns their number, which
+// is also `iso->count`. Vertices without a location are left out of
+// the bounding box, which stays infinite if none of them has one.
+int gi_isochrone(gi_searcher* s, const int src, const float budget, gi_area* iso) {
+    memset(iso, 0, sizeof(gi_area));
+    if (src < 0 || src >= s->g->csr.n || !(budget >= 0)) {
+        return 0;
+    }
+    gi_run(s, src, budget);
+    int count = 0;
+    for (int t = 0; t < s->num_threads; t++) {
+        count += s->locals[t].touched.len;
+    }
+    iso->count = count;
+    iso->vertices = xmalloc((size_t)count * sizeof(int));
+    iso->dist = xmalloc((size_t)count * sizeof(float));
+    iso->min_lat = iso->min_lon = INFINITY;
+    iso->max_lat = iso->max_lon = -INFINITY;
+    int i = 0;
+    for (int t = 0; t < s->num_threads; t++) {
+        const gi_vec* touched = &s->locals[t].touched;
+        for (int j = 0; j < touched->len; j++, i++) {
+            const int v = touched->ids[j];
+            iso->vertices[i] = v;
+            iso->dist[i] = gi_float(atomic_load_explicit(&s->dist[v], memory_order_relaxed));
+            const gps* location = s->g->csr.nodes[v]->location;
+            if (location == NULL) {
+                continue;
+            }
+            iso->min_lat = fminf(iso->min_lat, *location->lat);
+            iso->max_lat = fmaxf(iso->max_lat, *location->lat);
+            iso->min_lon = fminf(iso->min_lon, *location->lon);
+            iso->max_lon = fmaxf(iso->max_lon, *location->lon);
+        }
+    }
+    gi_reset(s);
+    return count;
+}
+
+void gi_area_free(gi_area* iso) {
+    free(iso->vertices);
+    free(iso->dist);
+    iso->vertices = NULL;
+    iso->dist = NULL;
+    iso->count = 0;
+}
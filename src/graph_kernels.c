@@ -0,0 +1,169 @@
+//
+//  graph_kernels.c
+//  hash_table
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xmalloc.h"
+
+#include "graph_elements.h"
+#include "graph_kernels.h"
+
+typedef struct {
+    int src;
+    int dst;
+    float weight;
+} gk_edge;
+
+static int gk_edge_cmp(const void* a, const void* b) {
+    const gk_edge* x = a;
+    const gk_edge* y = b;
+    if (x->src != y->src) {
+        return x->src < y->src ? -1 : 1;
+    }
+    if (x->dst != y->dst) {
+        return x->dst < y->dst ? -1 : 1;
+    }
+    return (x->weight > y->weight) - (x->weight < y->weight);
+}
+
+// Building the CSR:
+// Number the vertices in bucket order, then collect every edge whose
+// ends are both known vertices, adding its reverse when the graph is
+// undirected. Sorting by (source, target, weight) groups each vertex's
+// edges and puts the lightest of any parallel edges first, which is the
+// one kept. Edges without a distance weigh 1. When `weights` are
+// wanted a negative or NaN distance, which Dijkstra can't settle, is
+// refused and nothing is built: returns -1, or 0 on success.
+int gk_build_csr(gk_csr* csr, graph* G, const int directed, float** weights) {
+    nodes_table* N = G->N;
+    edges_table* E = G->E;
+    csr->N = N;
+    csr->n = N->count;
+    csr->nodes = xmalloc((size_t)csr->n * sizeof(node*));
+    csr->bucket_ids = xmalloc((size_t)N->size * sizeof(int));
+    int next_id = 0;
+    for (int i = 0; i < N->size; i++) {
+        csr->bucket_ids[i] = -1;
+        if (N->nodes[i] != NULL) {
+            csr->nodes[next_id] = N->nodes[i];
+            csr->bucket_ids[i] = next_id++;
+        }
+    }
+
+    long num_edges = 0;
+    for (int i = 0; i < E->size; i++) {
+        if (E->neighbours[i] != NULL) {
+            num_edges += E->neighbours[i]->count;
+        }
+    }
+    gk_edge* edges = xmalloc((size_t)(directed ? 1 : 2) * num_edges * sizeof(gk_edge));
+    long count = 0;
+    for (int i = 0; i < E->size; i++) {
+        neighbours* ns = E->neighbours[i];
+        if (ns == NULL) {
+            continue;
+        }
+        const int src = gk_vertex(csr, ns->node);
+        if (src < 0) {
+            continue;
+        }
+        for (int j = 0; j < ns->size; j++) {
+            neighbour* n = ns->neighbours[j];
+            if (n == NULL) {
+                continue;
+            }
+            const int dst = gk_vertex(csr, n->node);
+            if (dst < 0) {
+                continue;
+            }
+            const float w = n->distance != NULL ? *n->distance : 1.0f;
+            if (weights != NULL && !(w >= 0)) {
+                fprintf(stderr, "%s -> %s: negative or NaN distance\n", ns->node, n->node);
+                free(edges);
+                free(csr->nodes);
+                free(csr->bucket_ids);
+                return -1;
+            }
+            edges[count++] = (gk_edge){src, dst, w};
+            if (!directed) {
+                edges[count++] = (gk_edge){dst, src, w};
+            }
+        }
+    }
+    qsort(edges, (size_t)count, sizeof(gk_edge), gk_edge_cmp);
+
+    csr->offsets = xcalloc((size_t)csr->n + 1, sizeof(int));
+    csr->targets = xmalloc((size_t)count * sizeof(int));
+    float* w = weights != NULL ? xmalloc((size_t)count * sizeof(float)) : NULL;
+    int m = 0;
+    for (long e = 0; e < count; e++) {
+        if (e > 0 && edges[e].src == edges[e - 1].src && edges[e].dst == edges[e - 1].dst) {
+            continue;
+        }
+        csr->offsets[edges[e].src + 1]++;
+        csr->targets[m] = edges[e].dst;
+        if (w != NULL) {
+            w[m] = edges[e].weight;
+        }
+        m++;
+    }
+    for (int v = 0; v < csr->n; v++) {
+        csr->offsets[v + 1] += csr->offsets[v];
+    }
+    csr->m = m;
+    if (weights != NULL) {
+        *weights = w;
+    }
+    free(edges);
+    return 0;
+}
+
+void gk_free_csr(gk_csr* csr) {
+    free(csr->offsets);
+    free(csr->targets);
+    free(csr->nodes);
+    free(csr->bucket_ids);
+}
+
+// Vertex id of the node with `key`, or -1 if the graph has none.
+int gk_vertex(const gk_csr* csr, const char* key) {
+    const int index = find_node_index(csr->N, key);
+    return index < 0 ? -1 : csr->bucket_ids[index];
+}
+
+// Breadth first search from `src`, leaving the number of edges on the
+// shortest path to every vertex in `hops`, or -1 where unreachable.
+// Returns the number of vertices reached.
+int gk_bfs(const gk_csr* csr, const int src, int* hops) {
+    int* queue = xmalloc((size_t)csr->n * sizeof(int));
+    for (int v = 0; v < csr->n; v++) {
+        hops[v] = -1;
+    }
+    int head = 0;
+    int tail = 0;
+    hops[src] = 0;
+    queue[tail++] = src;
+    while (head < tail) {
+        const int u = queue[head++];
+        for (int e = csr->offsets[u]; e < csr->offsets[u + 1]; e++) {
+            const int v = csr->targets[e];
+            if (hops[v] < 0) {
+                hops[v] = hops[u] + 1;
+                queue[tail++] = v;
+            }
+        }
+    }
+    free(queue);
+    return tail;
+}
+
+GK_DEFINE_UNWEIGHTED(gk_u_dir, 1)
+GK_DEFINE_UNWEIGHTED(gk_u_undir, 0)
+GK_DEFINE_WEIGHTED(gk_u32_dir, uint32_t, uint64_t, UINT64_MAX, gk_heap_u64, 1, GK_ROUND_U32)
+GK_DEFINE_WEIGHTED(gk_u32_undir, uint32_t, uint64_t, UINT64_MAX, gk_heap_u64, 0, GK_ROUND_U32)
+GK_DEFINE_WEIGHTED(gk_f32_dir, float, float, INFINITY, gk_heap_f32, 1, GK_FROM_FLOAT)
+GK_DEFINE_WEIGHTED(gk_f32_undir, float, float, INFINITY, gk_heap_f32, 0, GK_FROM_FLOAT)
@@ -0,0 +1,91 @@
+//
+//  graph_load.c
+//  hash_table
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xmalloc.h"
+
+#include "graph_elements.h"
+#include "graph_load.h"
+#include "hash_table.h"
+
+#define LOAD_MAX_LINE 4096
+#define LOAD_MAX_KEY 256
+
+static int skip_line(const char* line) {
+    line += strspn(line, " \t\r\n");
+    return *line == '\0' || *line == '#';
+}
+
+static void load_error(const char* path, const int line_no, const char* line) {
+    fprintf(stderr, "%s:%d: malformed line: %s", path, line_no, line);
+}
+
+graph* load_graph(const char* path) {
+    FILE* in = fopen(path, "r");
+    if (in == NULL) {
+        perror(path);
+        return NULL;
+    }
+    graph* G = create_graph();
+    char line[LOAD_MAX_LINE];
+    char key[LOAD_MAX_KEY];
+    char other[LOAD_MAX_KEY];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        line_no++;
+        if (skip_line(line)) {
+            continue;
+        }
+        float a;
+        float b;
+        if (sscanf(line, "node %255s %f %f", key, &a, &b) == 3) {
+            add_node(G->N, new_node(key, new_gps(a, b)));
+        } else if (sscanf(line, "edge %255s %255s %f", key, other, &a) == 3) {
+            float* distance = xmalloc(sizeof(float));
+            *distance = a;
+            add_edge(G->E, key, new_neighbour(other, distance));
+        } else {
+            load_error(path, line_no, line);
+            delete_graph(G);
+            fclose(in);
+            return NULL;
+        }
+    }
+    fclose(in);
+    return G;
+}
+
+ht_hash_table* load_table(const char* path) {
+    FILE* in = fopen(path, "r");
+    if (in == NULL) {
+        perror(path);
+        return NULL;
+    }
+    ht_hash_table* ht = ht_new();
+    char line[LOAD_MAX_LINE];
+    char key[LOAD_MAX_KEY];
+    int line_no = 0;
+    while (fgets(line, sizeof(line), in) != NULL) {
+        line_no++;
+        if (skip_line(line)) {
+            continue;
+        }
+        int value_at;
+        if (sscanf(line, "%255s %n", key, &value_at) != 1 || line[value_at] == '\0') {
+            load_error(path, line_no, line);
+            ht_del_hash_table(ht);
+            fclose(in);
+            return NULL;
+        }
+        char* value = line + value_at;
+        value[strcspn(value, "\r\n")] = '\0';
+        ht_insert(ht, key, value);
+    }
+    fclose(in);
+    return ht;
+}
@@ -0,0 +1,591 @@
+//
+//  graph_match.c
+//  hash_table
+//
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xmalloc.h"
+
+#include "graph_match.h"
+
+#define GM_METRES_PER_DEGREE 111320.0f
+
+static void gm_project(const gm_matcher* m, const float lat, const float lon, float* x, float* y) {
+    *x = (lon - m->lon0) * m->lon_scale;
+    *y = (lat - m->lat0) * GM_METRES_PER_DEGREE;
+}
+
+// Nearest point to (px, py) on the edge `e`, as the fraction `t` of the
+// way from its source, and its distance.
+static float gm_nearest(const gm_matcher* m, const int e, const float px, const float py,
+                        float* t) {
+    const int a = m->sources[e];
+    const int b = m->g->csr.targets[e];
+    const float dx = m->x[b] - m->x[a];
+    const float dy = m->y[b] - m->y[a];
+    const float len2 = dx * dx + dy * dy;
+    float u = len2 > 0 ? ((px - m->x[a]) * dx + (py - m->y[a]) * dy) / len2 : 0;
+    u = u < 0 ? 0 : (u > 1 ? 1 : u);
+    *t = u;
+    const float ex = m->x[a] + u * dx - px;
+    const float ey = m->y[a] + u * dy - py;
+    return sqrtf(ex * ex + ey * ey);
+}
+
+static int gm_cell_col(const gm_matcher* m, const float x) {
+    const int c = (int)floorf(x / m->cell);
+    return c < 0 ? 0 : (c >= m->cols ? m->cols - 1 : c);
+}
+
+static int gm_cell_row(const gm_matcher* m, const float y) {
+    const int r = (int)floorf(y / m->cell);
+    return r < 0 ? 0 : (r >= m->rows ? m->rows - 1 : r);
+}
+
+// File every edge between located vertices under the cells its
+// bounding box overlaps, counting them on the first pass and placing
+// them on the second. Cells start as
+// wide as the search radius, and are widened if that would make far
+// more cells than edges.
+static void gm_build_grid(gm_matcher* m) {
+    const gk_csr* csr = &m->g->csr;
+    float max_x = 0;
+    float max_y = 0;
+    for (int v = 0; v < csr->n; v++) {
+        max_x = fmaxf(max_x, m->x[v]);
+        max_y = fmaxf(max_y, m->y[v]);
+    }
+    m->cell = m->radius;
+    while ((double)(max_x / m->cell + 1) * (max_y / m->cell + 1) > 4.0 * (csr->m + csr->n) + 1024) {
+        m->cell *= 2;
+    }
+    m->cols = (int)(max_x / m->cell) + 1;
+    m->rows = (int)(max_y / m->cell) + 1;
+    m->cell_offsets = xcalloc((size_t)m->cols * m->rows + 1, sizeof(int));
+    for (int pass = 0; pass < 2; pass++) {
+        for (int e = 0; e < csr->m; e++) {
+            const int a = m->sources[e];
+            const int b = csr->targets[e];
+            if (isnan(m->x[a]) || isnan(m->x[b])) {
+                continue;
+            }
+            const int c0 = gm_cell_col(m, fminf(m->x[a], m->x[b]));
+            const int c1 = gm_cell_col(m, fmaxf(m->x[a], m->x[b]));
+            const int r0 = gm_cell_row(m, fminf(m->y[a], m->y[b]));
+            const int r1 = gm_cell_row(m, fmaxf(m->y[a], m->y[b]));
+            for (int r = r0; r <= r1; r++) {
+                for (int c = c0; c <= c1; c++) {
+                    if (pass == 0) {
+                        m->cell_offsets[r * m->cols + c + 1]++;
+                    } else {
+                        m->cell_edges[m->cell_offsets[r * m->cols + c]++] = e;
+                    }
+                }
+            }
+        }
+        const int cells = m->cols * m->rows;
+        if (pass == 0) {
+            for (int i = 0; i < cells; i++) {
+                m->cell_offsets[i + 1] += m->cell_offsets[i];
+            }
+            m->cell_edges = xmalloc((size_t)(m->cell_offsets[cells] + 1) * sizeof(int));
+        } else {
+            // Placing advanced each offset to the start of the next cell
+            memmove(m->cell_offsets + 1, m->cell_offsets, (size_t)cells * sizeof(int));
+            m->cell_offsets[0] = 0;
+        }
+    }
+}
+
+gm_matcher* gm_new(const gk_f32_dir_graph* g, const float radius, const float sigma,
+                   const float beta, const int num_threads) {
+    gm_matcher* m = xcalloc(1, sizeof(gm_matcher));
+    const gk_csr* csr = &g->csr;
+    m->g = g;
+    m->radius = radius > 0 ? radius : GM_RADIUS;
+    m->sigma = sigma > 0 ? sigma : GM_SIGMA;
+    m->beta = beta > 0 ? beta : GM_BETA;
+
+    float min_lat = INFINITY;
+    float max_lat = -INFINITY;
+    float min_lon = INFINITY;
+    int located = 0;
+    for (int v = 0; v < csr->n; v++) {
+        const gps* location = csr->nodes[v]->location;
+        if (location == NULL) {
+            continue;
+        }
+        min_lat = fminf(min_lat, *location->lat);
+        max_lat = fmaxf(max_lat, *location->lat);
+        min_lon = fminf(min_lon, *location->lon);
+        located++;
+    }
+    m->lat0 = located > 0 ? min_lat : 0;
+    m->lon0 = located > 0 ? min_lon : 0;
+    m->lon_scale = GM_METRES_PER_DEGREE
+                   * (located > 0 ? cosf((min_lat + max_lat) / 2 * (float)M_PI / 180) : 1);
+    // Vertices without a location are projected to NaN, and their edges
+    // are never filed in the grid
+    m->x = xmalloc(((size_t)csr->n + 1) * sizeof(float));
+    m->y = xmalloc(((size_t)csr->n + 1) * sizeof(float));
+    for (int v = 0; v < csr->n; v++) {
+        const gps* location = csr->nodes[v]->location;
+        if (location == NULL) {
+            m->x[v] = m->y[v] = NAN;
+        } else {
+            gm_project(m, *location->lat, *location->lon, &m->x[v], &m->y[v]);
+        }
+    }
+    m->sources = xmalloc(((size_t)csr->m + 1) * sizeof(int));
+    for (int v = 0; v < csr->n; v++) {
+        for (int e = csr->offsets[v]; e < csr->offsets[v + 1]; e++) {
+            m->sources[e] = v;
+        }
+    }
+    gm_build_grid(m);
+
+    m->num_threads = num_threads > 0 ? num_threads : 1;
+    m->workers = xcalloc((size_t)m->num_threads, sizeof(gm_worker));
+    for (int t = 0; t < m->num_threads; t++) {
+        gm_worker* w = &m->workers[t];
+        w->dist = xmalloc(((size_t)csr->n + 1) * sizeof(float));
+        for (int v = 0; v < csr->n; v++) {
+            w->dist[v] = INFINITY;
+        }
+        w->pred = xmalloc(((size_t)csr->n + 1) * sizeof(int));
+        w->touched = xmalloc(((size_t)csr->n + 1) * sizeof(int));
+        w->cache = xcalloc(GM_CACHE_SLOTS, sizeof(gm_cache_slot));
+    }
+    return m;
+}
+
+void gm_del(gm_matcher* m) {
+    for (int t = 0; t < m->num_threads; t++) {
+        gm_worker* w = &m->workers[t];
+        free(w->dist);
+        free(w->pred);
+        free(w->touched);
+        gk_heap_f32_free(&w->heap);
+        free(w->candidates);
+        free(w->cache);
+    }
+    free(m->workers);
+    free(m->cell_offsets);
+    free(m->cell_edges);
+    free(m->sources);
+    free(m->x);
+    free(m->y);
+    free(m);
+}
+
+// Up to `GM_MAX_CANDIDATES` edges within the radius of `p`, nearest
+// first. An edge filed under several cells is only taken once.
+int gm_candidates(gm_matcher* m, const gm_point p, gm_candidate* out) {
+    float px;
+    float py;
+    gm_project(m, p.lat, p.lon, &px, &py);
+    const float r = m->radius;
+    if (px + r < 0 || py + r < 0 || px - r > m->cols * m->cell || py - r > m->rows * m->cell) {
+        return 0;
+    }
+    int count = 0;
+    const int c0 = gm_cell_col(m, px - r);
+    const int c1 = gm_cell_col(m, px + r);
+    const int r0 = gm_cell_row(m, py - r);
+    const int r1 = gm_cell_row(m, py + r);
+    for (int row = r0; row <= r1; row++) {
+        for (int col = c0; col <= c1; col++) {
+            const int cell = row * m->cols + col;
+            for (int i = m->cell_offsets[cell]; i < m->cell_offsets[cell + 1]; i++) {
+                const int e = m->cell_edges[i];
+                float t;
+                const float d = gm_nearest(m, e, px, py, &t);
+                if (d > r || (count == GM_MAX_CANDIDATES && d >= out[count - 1].distance)) {
+                    continue;
+                }
+                int seen = 0;
+                for (int j = 0; j < count && !seen; j++) {
+                    seen = out[j].edge == e;
+                }
+                if (seen) {
+                    continue;
+                }
+                int j = count < GM_MAX_CANDIDATES ? count++ : count - 1;
+                while (j > 0 && out[j - 1].distance > d) {
+                    out[j] = out[j - 1];
+                    j--;
+                }
+                out[j].edge = e;
+                out[j].offset = t;
+                out[j].distance = d;
+                out[j].score = -INFINITY;
+                out[j].back = -1;
+            }
+        }
+    }
+    return count;
+}
+
+// Dijkstra from `src` that stops once every target is settled or the
+// next vertex is further than `limit`. `found[i]` is the distance to
+// `targets[i]`, or `INFINITY` if it is further than the limit.
+// Predecessors are kept in `pred` until the next search.
+static void gm_search(const gm_matcher* m, gm_worker* w, const int src, const float limit,
+                      const int* targets, const int num_targets, float* found) {
+    for (int i = 0; i < w->num_touched; i++) {
+        w->dist[w->touched[i]] = INFINITY;
+    }
+    w->num_touched = 0;
+    w->searches++;
+    int remaining = num_targets;
+    for (int i = 0; i < num_targets; i++) {
+        found[i] = INFINITY;
+    }
+    const gk_csr* csr = &m->g->csr;
+    w->heap.len = 0;
+    w->dist[src] = 0;
+    w->pred[src] = -1;
+    w->touched[w->num_touched++] = src;
+    gk_heap_f32_push(&w->heap, 0, src);
+    while (w->heap.len > 0 && remaining > 0) {
+        float d;
+        const int u = gk_heap_f32_pop(&w->heap, &d);
+        if (d > w->dist[u]) {
+            continue;
+        }
+        for (int i = 0; i < num_targets; i++) {
+            if (targets[i] == u && found[i] == INFINITY) {
+                found[i] = d;
+                remaining--;
+            }
+        }
+        for (int e = csr->offsets[u]; e < csr->offsets[u + 1]; e++) {
+            const int v = csr->targets[e];
+            const float nd = d + m->g->weights[e];
+            if (nd < w->dist[v] && nd <= limit) {
+                if (w->dist[v] == INFINITY) {
+                    w->touched[w->num_touched++] = v;
+                }
+                w->dist[v] = nd;
+                w->pred[v] = u;
+                gk_heap_f32_push(&w->heap, nd, v);
+            }
+        }
+    }
+}
+
+static gm_cache_slot* gm_cache_slot_of(gm_worker* w, const uint64_t key) {
+    uint64_t h = key * 0x9E3779B97F4A7C15ULL;
+    return &w->cache[(h >> 32) & (GM_CACHE_SLOTS - 1)];
+}
+
+// Shortest distances from `src` to each of `targets` within `limit`,
+// from the cache where possible. One search fills in every miss.
+static void gm_distances(const gm_matcher* m, gm_worker* w, const int src, const float limit,
+                         const int* targets, const int num_targets, float* found) {
+    unsigned missed = 0;
+    int misses = 0;
+    for (int i = 0; i < num_targets; i++) {
+        const uint64_t key = ((uint64_t)(uint32_t)src << 32 | (uint32_t)targets[i]) + 1;
+        const gm_cache_slot* slot = gm_cache_slot_of(w, key);
+        if (slot->key == key && slot->dist >= 0) {
+            found[i] = slot->dist;
+        } else if (slot->key == key && -slot->dist >= limit) {
+            found[i] = INFINITY;
+        } else {
+            missed |= 1u << i;
+            misses++;
+        }
+    }
+    w->hits += num_targets - misses;
+    w->misses += misses;
+    if (misses == 0) {
+        return;
+    }
+    float searched[GM_MAX_CANDIDATES];
+    gm_search(m, w, src, limit, targets, num_targets, searched);
+    // A target out of reach is stored as minus the limit it was out of
+    // reach of, which answers any search with a lower limit
+    for (int i = 0; i < num_targets; i++) {
+        if (missed & (1u << i)) {
+            const uint64_t key = ((uint64_t)(uint32_t)src << 32 | (uint32_t)targets[i]) + 1;
+            gm_cache_slot* slot = gm_cache_slot_of(w, key);
+            slot->key = key;
+            slot->dist = searched[i] != INFINITY ? searched[i] : -limit;
+            found[i] = searched[i];
+        }
+    }
+}
+
+static gm_candidate* gm_reserve(gm_worker* w, const int len) {
+    if (len + GM_MAX_CANDIDATES > w->candidates_cap) {
+        w->candidates_cap = (len + GM_MAX_CANDIDATES) * 2;
+        w->candidates = xrealloc(w->candidates, (size_t)w->candidates_cap * sizeof(gm_candidate));
+    }
+    return w->candidates + len;
+}
+
+// Viterbi step from the candidates `prev` of the previous ping to
+// `next` of this one, `gc` metres apart in a straight line. Returns 0
+// if no candidate of this ping can be reached from any of the last.
+static int gm_step(const gm_matcher* m, gm_worker* w, const int prev, const int num_prev,
+                   const int next, const int num_next, const float gc) {
+    const int* targets = m->g->csr.targets;
+    const float* weights = m->g->weights;
+    int tails[GM_MAX_CANDIDATES];
+    float sp[GM_MAX_CANDIDATES];
+    for (int b = 0; b < num_next; b++) {
+        tails[b] = m->sources[w->candidates[next + b].edge];
+    }
+    const float limit = 2 * gc + 2 * m->radius;
+    int reachable = 0;
+    for (int i = 0; i < num_prev; i++) {
+        const gm_candidate* a = &w->candidates[prev + i];
+        if (a->score == -INFINITY) {
+            continue;
+        }
+        gm_distances(m, w, targets[a->edge], limit, tails, num_next, sp);
+        for (int j = 0; j < num_next; j++) {
+            gm_candidate* b = &w->candidates[next + j];
+            float route;
+            if (a->edge == b->edge && b->offset >= a->offset) {
+                route = (b->offset - a->offset) * weights[a->edge];
+            } else if (sp[j] != INFINITY) {
+                route = (1 - a->offset) * weights[a->edge] + sp[j] + b->offset * weights[b->edge];
+            } else {
+                continue;
+            }
+            const float score = a->score - fabsf(route - gc) / m->beta;
+            if (score > b->score) {
+                b->score = score;
+                b->back = prev + i;
+                reachable = 1;
+            }
+        }
+    }
+    return reachable;
+}
+
+// Append the vertices from candidate `a` to candidate `b` to the route,
+// found again with their predecessors.
+static void gm_route_step(const gm_matcher* m, gm_worker* w, gm_result* r, int* cap,
+                          const gm_candidate* a, const gm_candidate* b) {
+    if (a->edge == b->edge && b->offset >= a->offset) {
+        return;
+    }
+    const int from = m->g->csr.targets[a->edge];
+    const int to = m->sources[b->edge];
+    float found;
+    gm_search(m, w, from, INFINITY, &to, 1, &found);
+    if (found == INFINITY) {
+        return;
+    }
+    int hops = 0;
+    for (int v = to; v != from; v = w->pred[v]) {
+        hops++;
+    }
+    if (r->route_len + hops + 1 > *cap) {
+        *cap = (r->route_len + hops + 1) * 2;
+        r->route = xrealloc(r->route, (size_t)*cap * sizeof(int));
+    }
+    int i = r->route_len + hops;
+    for (int v = to; v != from; v = w->pred[v]) {
+        r->route[--i] = v;
+    }
+    r->route_len += hops;
+    r->route[r->route_len++] = m->g->csr.targets[b->edge];
+}
+
+static int gm_match_on(gm_matcher* m, gm_worker* w, const gm_trace* trace, gm_result* r) {
+    const int count = trace->count;
+    memset(r, 0, sizeof(gm_result));
+    r->count = count;
+    r->edges = xmalloc(((size_t)count + 1) * sizeof(int));
+    r->offsets = xmalloc(((size_t)count + 1) * sizeof(float));
+    int* starts = xmalloc(((size_t)count + 1) * sizeof(int));
+    int* lengths = xmalloc(((size_t)count + 1) * sizeof(int));
+    int* chosen = xmalloc(((size_t)count + 1) * sizeof(int));
+
+    // Forward pass: candidates of each ping and their best scores
+    int len = 0;
+    int prev = -1;
+    float prev_x = 0;
+    float prev_y = 0;
+    for (int t = 0; t < count; t++) {
+        r->edges[t] = -1;
+        r->offsets[t] = 0;
+        starts[t] = len;
+        lengths[t] = gm_candidates(m, trace->points[t], gm_reserve(w, len));
+        if (lengths[t] == 0) {
+            continue;
+        }
+        float x;
+        float y;
+        gm_project(m, trace->points[t].lat, trace->points[t].lon, &x, &y);
+        int linked = 0;
+        if (prev >= 0) {
+            const float gc = sqrtf((x - prev_x) * (x - prev_x) + (y - prev_y) * (y - prev_y));
+            linked = gm_step(m, w, starts[prev], lengths[prev], len, lengths[t], gc);
+        }
+        for (int j = 0; j < lengths[t]; j++) {
+            gm_candidate* c = &w->candidates[len + j];
+            const float emission = -0.5f * (c->distance / m->sigma) * (c->distance / m->sigma);
+            if (!linked) {
+                c->score = emission;
+                c->back = -1;
+            } else {
+                c->score += emission;
+            }
+        }
+        r->breaks += prev >= 0 && !linked;
+        len += lengths[t];
+        prev = t;
+        prev_x = x;
+        prev_y = y;
+    }
+
+    // Back pass from the best last candidate. At a break the best
+    // candidate before it starts over.
+    int cur = -1;
+    for (int t = count - 1; t >= 0; t--) {
+        if (lengths[t] == 0) {
+            chosen[t] = -1;
+            continue;
+        }
+        if (cur < 0) {
+            cur = starts[t];
+            for (int j = 1; j < lengths[t]; j++) {
+                if (w->candidates[starts[t] + j].score > w->candidates[cur].score) {
+                    cur = starts[t] + j;
+                }
+            }
+        }
+        chosen[t] = cur;
+        r->edges[t] = w->candidates[cur].edge;
+        r->offsets[t] = w->candidates[cur].offset;
+        cur = w->candidates[cur].back;
+    }
+
+    int matched = 0;
+    int cap = 0;
+    const gm_candidate* last = NULL;
+    for (int t = 0; t < count; t++) {
+        if (chosen[t] < 0) {
+            continue;
+        }
+        matched++;
+        const gm_candidate* c = &w->candidates[chosen[t]];
+        if (last != NULL && c->back >= 0) {
+            gm_route_step(m, w, r, &cap, last, c);
+        } else {
+            if (r->route_len + 3 > cap) {
+                cap = (r->route_len + 3) * 2;
+                r->route = xrealloc(r->route, (size_t)cap * sizeof(int));
+            }
+            if (last != NULL) {
+                r->route[r->route_len++] = -1;
+            }
+            r->route[r->route_len++] = m->sources[c->edge];
+            r->route[r->route_len++] = m->g->csr.targets[c->edge];
+        }
+        last = c;
+    }
+    free(starts);
+    free(lengths);
+    free(chosen);
+    return matched;
+}
+
+static void gm_collect(gm_matcher* m, const gm_result* results, const int count) {
+    for (int i = 0; i < count; i++) {
+        m->points += results[i].count;
+        for (int t = 0; t < results[i].count; t++) {
+            m->matched += results[i].edges[t] >= 0;
+        }
+    }
+    for (int t = 0; t < m->num_threads; t++) {
+        gm_worker* w = &m->workers[t];
+        m->searches += w->searches;
+        m->cache_hits += w->hits;
+        m->cache_misses += w->misses;
+        w->searches = w->hits = w->misses = 0;
+    }
+}
+
+// Matches one trace on the calling thread. Returns the number of pings
+// matched.
+int gm_match(gm_matcher* m, const gm_trace* trace, gm_result* result) {
+    const int matched = gm_match_on(m, &m->workers[0], trace, result);
+    gm_collect(m, result, 1);
+    return matched;
+}
+
+typedef struct {
+    gm_matcher* m;
+    gm_worker* w;
+    const gm_trace* traces;
+    gm_result* results;
+    int count;
+    atomic_int* next;
+    long matched;
+} gm_batch_args;
+
+static void* gm_batch_worker(void* arg) {
+    gm_batch_args* a = arg;
+    for (;;) {
+        const int i = atomic_fetch_add(a->next, 1);
+        if (i >= a->count) {
+            return NULL;
+        }
+        a->matched += gm_match_on(a->m, a->w, &a->traces[i], &a->results[i]);
+    }
+}
+
+// Matches `count` traces into `results`, with each thread taking the
+// next trace as it finishes one. Returns the number of pings matched.
+int gm_match_batch(gm_matcher* m, const gm_trace* traces, const int count, gm_result* results) {
+    atomic_int next;
+    atomic_init(&next, 0);
+    gm_batch_args* args = xcalloc((size_t)m->num_threads, sizeof(gm_batch_args));
+    pthread_t* threads = xmalloc((size_t)m->num_threads * sizeof(pthread_t));
+    for (int t = 0; t < m->num_threads; t++) {
+        args[t].m = m;
+        args[t].w = &m->workers[t];
+        args[t].traces = traces;
+        args[t].results = results;
+        args[t].count = count;
+        args[t].next = &next;
+    }
+    // Traces are handed out one at a time, so those a thread that could
+    // not be started would have taken go to the others, the calling
+    // thread included
+    int* started = xcalloc((size_t)m->num_threads, sizeof(int));
+    for (int t = 1; t < m->num_threads; t++) {
+        started[t] = pthread_create(&threads[t], NULL, gm_batch_worker, &args[t]) == 0;
+    }
+    gm_batch_worker(&args[0]);
+    long matched = args[0].matched;
+    for (int t = 1; t < m->num_threads; t++) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+            matched += args[t].matched;
+        }
+    }
+    free(started);
+    free(args);
+    free(threads);
+    gm_collect(m, results, count);
+    return (int)matched;
+}
+
+void gm_result_free(gm_result* result) {
+    free(result->edges);
+    free(result->offsets);
+    free(result->route);
+    memset(result, 0, sizeof(gm_result));
+}
@@ -0,0 +1,767 @@
+//
+//  graph_partition.c
+//  hash_table
+//
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "xmalloc.h"
+
+#include "graph_partition.h"
+
+#define GP_MAGIC "GPART001"
+#define GP_MAGIC_LEN 8
+#define GP_MAX_PARTS 65535
+
+enum gp_cmd { GP_CMD_START = 1, GP_CMD_STEP = 2, GP_CMD_RESULT = 3, GP_CMD_QUIT = 4 };
+
+// Every command starts with a frame. START carries the source's global
+// id and whether edges count as one hop, STEP the number of messages
+// that follow it.
+typedef struct {
+    uint32_t cmd;
+    uint32_t a;
+    uint32_t b;
+} gp_frame;
+
+// Improved distance of a vertex, addressed by its part and local index.
+typedef struct {
+    int32_t part;
+    int32_t vertex;
+    float dist;
+} gp_message;
+
+typedef struct {
+    float key;
+    int id;
+} gp_keyed;
+
+static int gp_keyed_cmp(const void* a, const void* b) {
+    const float x = ((const gp_keyed*)a)->key;
+    const float y = ((const gp_keyed*)b)->key;
+    return (x > y) - (x < y);
+}
+
+// k-d bisection:
+// Sort the vertices along the wider side of their bounding box, with
+// longitude scaled by the cosine of the latitude, and give each half
+// a share of the parts proportional to its share of the vertices.
+static void gp_kd_split(const gk_csr* csr, gp_keyed* ids, const int n, const int k,
+                        const int first, int* part) {
+    if (k == 1 || n == 0) {
+        for (int i = 0; i < n; i++) {
+            part[ids[i].id] = first;
+        }
+        return;
+    }
+    float min_lat = INFINITY;
+    float max_lat = -INFINITY;
+    float min_lon = INFINITY;
+    float max_lon = -INFINITY;
+    for (int i = 0; i < n; i++) {
+        const gps* location = csr->nodes[ids[i].id]->location;
+        min_lat = fminf(min_lat, *location->lat);
+        max_lat = fmaxf(max_lat, *location->lat);
+        min_lon = fminf(min_lon, *location->lon);
+        max_lon = fmaxf(max_lon, *location->lon);
+    }
+    const float scale = cosf((min_lat + max_lat) / 2 * (float)M_PI / 180);
+    const int by_lon = (max_lon - min_lon) * scale > max_lat - min_lat;
+    for (int i = 0; i < n; i++) {
+        const gps* location = csr->nodes[ids[i].id]->location;
+        ids[i].key = by_lon ? *location->lon : *location->lat;
+    }
+    qsort(ids, (size_t)n, sizeof(gp_keyed), gp_keyed_cmp);
+    const int k_left = k / 2;
+    const int n_left = (int)((long)n * k_left / k);
+    gp_kd_split(csr, ids, n_left, k_left, first, part);
+    gp_kd_split(csr, ids + n_left, n - n_left, k - k_left, first + k_left, part);
+}
+
+// Refinement:
+// A pass visits every vertex once and moves it to the part holding
+// the most of its neighbours, counting edges in both directions, if
+// that beats its own part. The destination must have room under the
+// size limit and the source must stay above the lower one. Passes
+// stop early once nothing moves.
+static void gp_refine(const gk_csr* csr, int* part, const int k, const int passes) {
+    const int n = csr->n;
+    int* in_offsets = xcalloc((size_t)n + 1, sizeof(int));
+    int* sources = xmalloc((size_t)csr->m * sizeof(int) + 1);
+    for (int e = 0; e < csr->m; e++) {
+        in_offsets[csr->targets[e] + 1]++;
+    }
+    for (int v = 0; v < n; v++) {
+        in_offsets[v + 1] += in_offsets[v];
+    }
+    int* cursor = xmalloc((size_t)n * sizeof(int) + 1);
+    memcpy(cursor, in_offsets, (size_t)n * sizeof(int));
+    for (int u = 0; u < n; u++) {
+        for (int e = csr->offsets[u]; e < csr->offsets[u + 1]; e++) {
+            sources[cursor[csr->targets[e]]++] = u;
+        }
+    }
+    free(cursor);
+
+    int* size = xcalloc((size_t)k, sizeof(int));
+    for (int v = 0; v < n; v++) {
+        size[part[v]]++;
+    }
+    const int max_size = (int)ceil((double)n / k * (1 + GP_IMBALANCE));
+    const int min_size = (int)floor((double)n / k * (1 - GP_IMBALANCE));
+    int* count = xcalloc((size_t)k, sizeof(int));
+    int* seen = xmalloc((size_t)k * sizeof(int));
+    for (int pass = 0; pass < passes; pass++) {
+        int moved = 0;
+        for (int v = 0; v < n; v++) {
+            int num_seen = 0;
+            for (int side = 0; side < 2; side++) {
+                const int* offsets = side ? in_offsets : csr->offsets;
+                const int* adjacent = side ? sources : csr->targets;
+                for (int e = offsets[v]; e < offsets[v + 1]; e++) {
+                    const int p = part[adjacent[e]];
+                    if (count[p]++ == 0) {
+                        seen[num_seen++] = p;
+                    }
+                }
+            }
+            const int own = part[v];
+            int best = own;
+            for (int i = 0; i < num_seen; i++) {
+                const int p = seen[i];
+                if (count[p] > count[best] && size[p] < max_size) {
+                    best = p;
+                }
+            }
+            if (best != own && size[own] > min_size) {
+                part[v] = best;
+                size[own]--;
+                size[best]++;
+                moved++;
+            }
+            for (int i = 0; i < num_seen; i++) {
+                count[seen[i]] = 0;
+            }
+        }
+        if (moved == 0) {
+            break;
+        }
+    }
+    free(seen);
+    free(count);
+    free(size);
+    free(sources);
+    free(in_offsets);
+}
+
+// Part of every vertex of `g`, in 0..k-1.
+// Vertices without a location have no place in the k-d split. Each
+// goes to the part holding most of its out-neighbours placed so far,
+// if that part has room under the size limit, and otherwise to the
+// smallest part.
+static void gp_place_unlocated(const gk_csr* csr, int* part, const int k) {
+    const int max_size = (int)ceil((double)csr->n / k * (1 + GP_IMBALANCE));
+    int* size = xcalloc((size_t)k, sizeof(int));
+    int* count = xcalloc((size_t)k, sizeof(int));
+    for (int v = 0; v < csr->n; v++) {
+        if (part[v] >= 0) {
+            size[part[v]]++;
+        }
+    }
+    for (int v = 0; v < csr->n; v++) {
+        if (part[v] >= 0) {
+            continue;
+        }
+        int best = 0;
+        for (int p = 1; p < k; p++) {
+            best = size[p] < size[best] ? p : best;
+        }
+        for (int e = csr->offsets[v]; e < csr->offsets[v + 1]; e++) {
+            const int p = part[csr->targets[e]];
+            if (p >= 0 && ++count[p] > count[best] && size[p] < max_size) {
+                best = p;
+            }
+        }
+        for (int e = csr->offsets[v]; e < csr->offsets[v + 1]; e++) {
+            const int p = part[csr->targets[e]];
+            if (p >= 0) {
+                count[p] = 0;
+            }
+        }
+        part[v] = best;
+        size[best]++;
+    }
+    free(size);
+    free(count);
+}
+
+int* gp_partition(const gk_f32_dir_graph* g, const int k, const int refine_passes) {
+    const gk_csr* csr = &g->csr;
+    int* part = xmalloc((size_t)csr->n * sizeof(int) + 1);
+    gp_keyed* ids = xmalloc((size_t)csr->n * sizeof(gp_keyed) + 1);
+    int located = 0;
+    for (int v = 0; v < csr->n; v++) {
+        part[v] = -1;
+        if (csr->nodes[v]->location != NULL) {
+            ids[located++].id = v;
+        }
+    }
+    gp_kd_split(csr, ids, located, k, 0, part);
+    free(ids);
+    if (located < csr->n) {
+        gp_place_unlocated(csr, part, k);
+    }
+    if (k > 1) {
+        gp_refine(csr, part, k, refine_passes);
+    }
+    return part;
+}
+
+long gp_edge_cut(const gk_csr* csr, const int* part) {
+    long cut = 0;
+    for (int u = 0; u < csr->n; u++) {
+        for (int e = csr->offsets[u]; e < csr->offsets[u + 1]; e++) {
+            cut += part[u] != part[csr->targets[e]];
+        }
+    }
+    return cut;
+}
+
+static int gp_fwrite(FILE* f, const void* p, const size_t size, const size_t n) {
+    return n == 0 || fwrite(p, size, n, f) == n;
+}
+
+static int gp_fread(FILE* f, void* p, const size_t size, const size_t n) {
+    return n == 0 || fread(p, size, n, f) == n;
+}
+
+// Partition files:
+// A header of the magic and seven int32 fields (k, id, n_global, n, m,
+// num_boundary and a reserved 0), then the arrays of `gp_part` in
+// declaration order, all in host byte order. Local indexes follow
+// global order, so `global_ids` comes out sorted.
+int gp_write(const gk_f32_dir_graph* g, const int* part, const int k, const char* prefix) {
+    const gk_csr* csr = &g->csr;
+    if (k < 1 || k > GP_MAX_PARTS) {
+        fprintf(stderr, "%s: %d parts out of range\n", prefix, k);
+        return -1;
+    }
+    int* local = xmalloc((size_t)csr->n * sizeof(int) + 1);
+    int* sizes = xcalloc((size_t)k, sizeof(int));
+    for (int v = 0; v < csr->n; v++) {
+        local[v] = sizes[part[v]]++;
+    }
+    int rc = 0;
+    for (int p = 0; p < k && rc == 0; p++) {
+        const int n = sizes[p];
+        int m = 0;
+        for (int v = 0; v < csr->n; v++) {
+            if (part[v] == p) {
+                m += csr->offsets[v + 1] - csr->offsets[v];
+            }
+        }
+        int* global_ids = xmalloc((size_t)n * sizeof(int) + 1);
+        int* offsets = xmalloc(((size_t)n + 1) * sizeof(int));
+        int* targets = xmalloc((size_t)m * sizeof(int) + 1);
+        uint16_t* target_parts = xmalloc((size_t)m * sizeof(uint16_t) + 1);
+        float* weights = xmalloc((size_t)m * sizeof(float) + 1);
+        int* boundary = xmalloc((size_t)n * sizeof(int) + 1);
+        int num_boundary = 0;
+        int i = 0;
+        int e_out = 0;
+        offsets[0] = 0;
+        for (int v = 0; v < csr->n; v++) {
+            if (part[v] != p) {
+                continue;
+            }
+            int crosses = 0;
+            for (int e = csr->offsets[v]; e < csr->offsets[v + 1]; e++, e_out++) {
+                const int t = csr->targets[e];
+                targets[e_out] = local[t];
+                target_parts[e_out] = (uint16_t)part[t];
+                weights[e_out] = g->weights[e];
+                crosses |= part[t] != p;
+            }
+            if (crosses) {
+                boundary[num_boundary++] = i;
+            }
+            global_ids[i++] = v;
+            offsets[i] = e_out;
+        }
+
+        char path[4096];
+        snprintf(path, sizeof(path), "%s.%d", prefix, p);
+        FILE* f = fopen(path, "wb");
+        const int32_t header[7] = {k, p, csr->n, n, m, num_boundary, 0};
+        if (f == NULL
+                || !gp_fwrite(f, GP_MAGIC, 1, GP_MAGIC_LEN)
+                || !gp_fwrite(f, header, sizeof(int32_t), 7)
+                || !gp_fwrite(f, global_ids, sizeof(int), (size_t)n)
+                || !gp_fwrite(f, offsets, sizeof(int), (size_t)n + 1)
+                || !gp_fwrite(f, targets, sizeof(int), (size_t)m)
+                || !gp_fwrite(f, target_parts, sizeof(uint16_t), (size_t)m)
+                || !gp_fwrite(f, weights, sizeof(float), (size_t)m)
+                || !gp_fwrite(f, boundary, sizeof(int), (size_t)num_boundary)) {
+            perror(path);
+            rc = -1;
+        }
+        if (f != NULL && fclose(f) != 0 && rc == 0) {
+            perror(path);
+            rc = -1;
+        }
+        free(global_ids);
+        free(offsets);
+        free(targets);
+        free(target_parts);
+        free(weights);
+        free(boundary);
+    }
+    free(local);
+    free(sizes);
+    return rc;
+}
+
+void gp_part_free(gp_part* p) {
+    free(p->global_ids);
+    free(p->offsets);
+    free(p->targets);
+    free(p->target_parts);
+    free(p->weights);
+    free(p->boundary);
+    free(p);
+}
+
+gp_part* gp_part_load(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        return NULL;
+    }
+    char magic[GP_MAGIC_LEN];
+    int32_t header[7];
+    if (!gp_fread(f, magic, 1, GP_MAGIC_LEN) || memcmp(magic, GP_MAGIC, GP_MAGIC_LEN) != 0
+            || !gp_fread(f, header, sizeof(int32_t), 7)
+            || header[0] < 1 || header[0] > GP_MAX_PARTS || header[1] < 0 || header[1] >= header[0]
+            || header[2] < 0 || header[3] < 0 || header[3] > header[2] || header[4] < 0
+            || header[5] < 0 || header[5] > header[3]) {
+        fprintf(stderr, "%s: not a partition\n", path);
+        fclose(f);
+        return NULL;
+    }
+    gp_part* p = xcalloc(1, sizeof(gp_part));
+    p->k = header[0];
+    p->id = header[1];
+    p->n_global = header[2];
+    p->n = header[3];
+    p->m = header[4];
+    p->num_boundary = header[5];
+    p->global_ids = xmalloc((size_t)p->n * sizeof(int) + 1);
+    p->offsets = xmalloc(((size_t)p->n + 1) * sizeof(int));
+    p->targets = xmalloc((size_t)p->m * sizeof(int) + 1);
+    p->target_parts = xmalloc((size_t)p->m * sizeof(uint16_t) + 1);
+    p->weights = xmalloc((size_t)p->m * sizeof(float) + 1);
+    p->boundary = xmalloc((size_t)p->num_boundary * sizeof(int) + 1);
+    int ok = gp_fread(f, p->global_ids, sizeof(int), (size_t)p->n)
+             && gp_fread(f, p->offsets, sizeof(int), (size_t)p->n + 1)
+             && gp_fread(f, p->targets, sizeof(int), (size_t)p->m)
+             && gp_fread(f, p->target_parts, sizeof(uint16_t), (size_t)p->m)
+             && gp_fread(f, p->weights, sizeof(float), (size_t)p->m)
+             && gp_fread(f, p->boundary, sizeof(int), (size_t)p->num_boundary);
+    fclose(f);
+    for (int i = 0; ok && i < p->n; i++) {
+        ok = p->offsets[i] <= p->offsets[i + 1];
+    }
+    ok = ok && p->offsets[0] == 0 && p->offsets[p->n] == p->m;
+    for (int e = 0; ok && e < p->m; e++) {
+        ok = p->target_parts[e] < p->k && p->targets[e] >= 0
+             && (p->target_parts[e] != p->id || p->targets[e] < p->n);
+    }
+    if (!ok) {
+        fprintf(stderr, "%s: truncated or inconsistent partition\n", path);
+        gp_part_free(p);
+        return NULL;
+    }
+    return p;
+}
+
+static int gp_read_full(const int fd, void* buf, const size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        const ssize_t n = read(fd, (char*)buf + done, len - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+// Sends never raise SIGPIPE. A worker that went away shows up as an
+// error instead.
+static int gp_write_full(const int fd, const void* buf, const size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        const ssize_t n = send(fd, (const char*)buf + done, len - done, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+// Worker side:
+// `dist` holds the part's tentative distances. `sent[e]` is the best
+// distance already reported over the cut edge `e`, so an edge reports
+// each vertex at most once per improvement.
+typedef struct {
+    gp_part* p;
+    float* dist;
+    float* sent;
+    gk_heap_f32 heap;
+    gp_message* out;
+    int out_len;
+    int out_cap;
+} gp_worker;
+
+// Dijkstra over the part's own edges from whatever is on the heap,
+// collecting improvements for vertices of other parts in `out`.
+static void gp_worker_relax(gp_worker* w, const int unit) {
+    const gp_part* p = w->p;
+    w->out_len = 0;
+    while (w->heap.len > 0) {
+        float d;
+        const int u = gk_heap_f32_pop(&w->heap, &d);
+        if (d > w->dist[u]) {
+            continue;
+        }
+        for (int e = p->offsets[u]; e < p->offsets[u + 1]; e++) {
+            const float nd = d + (unit ? 1.0f : p->weights[e]);
+            const int v = p->targets[e];
+            if (p->target_parts[e] == p->id) {
+                if (nd < w->dist[v]) {
+                    w->dist[v] = nd;
+                    gk_heap_f32_push(&w->heap, nd, v);
+                }
+            } else if (nd < w->sent[e]) {
+                w->sent[e] = nd;
+                if (w->out_len == w->out_cap) {
+                    w->out_cap = w->out_cap ? w->out_cap * 2 : 1024;
+                    w->out = xrealloc(w->out, (size_t)w->out_cap * sizeof(gp_message));
+                }
+                w->out[w->out_len++] = (gp_message){p->target_parts[e], v, nd};
+            }
+        }
+    }
+}
+
+static int gp_worker_reply(gp_worker* w, const int fd) {
+    const uint32_t count = (uint32_t)w->out_len;
+    if (gp_write_full(fd, &count, sizeof(count)) < 0) {
+        return -1;
+    }
+    return gp_write_full(fd, w->out, (size_t)w->out_len * sizeof(gp_message));
+}
+
+static int gp_int_cmp(const void* a, const void* b) {
+    const int x = *(const int*)a;
+    const int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+// Serve commands on `fd` until told to quit or the coordinator goes
+// away. The first thing sent is the global vertex count, or nothing if
+// the part could not be loaded.
+static int gp_worker_main(const char* path, const int fd) {
+    gp_part* p = gp_part_load(path);
+    if (p == NULL) {
+        return 1;
+    }
+    gp_worker w = {0};
+    w.p = p;
+    w.dist = xmalloc((size_t)p->n * sizeof(float) + 1);
+    w.sent = xmalloc((size_t)p->m * sizeof(float) + 1);
+    const uint32_t n_global = (uint32_t)p->n_global;
+    int unit = 0;
+    int rc = gp_write_full(fd, &n_global, sizeof(n_global));
+    gp_frame frame;
+    while (rc == 0 && gp_read_full(fd, &frame, sizeof(frame)) == 0) {
+        if (frame.cmd == GP_CMD_START) {
+            unit = frame.b != 0;
+            for (int i = 0; i < p->n; i++) {
+                w.dist[i] = INFINITY;
+            }
+            for (int e = 0; e < p->m; e++) {
+                w.sent[e] = INFINITY;
+            }
+            w.heap.len = 0;
+            const int src = (int)frame.a;
+            const int* found = bsearch(&src, p->global_ids, (size_t)p->n, sizeof(int),
+                                       gp_int_cmp);
+            if (found != NULL) {
+                w.dist[found - p->global_ids] = 0;
+                gk_heap_f32_push(&w.heap, 0, (int)(found - p->global_ids));
+            }
+            gp_worker_relax(&w, unit);
+            rc = gp_worker_reply(&w, fd);
+        } else if (frame.cmd == GP_CMD_STEP) {
+            for (uint32_t i = 0; i < frame.a && rc == 0; i++) {
+                gp_message msg;
+                rc = gp_read_full(fd, &msg, sizeof(msg));
+                if (rc == 0 && msg.vertex >= 0 && msg.vertex < p->n
+                        && msg.dist < w.dist[msg.vertex]) {
+                    w.dist[msg.vertex] = msg.dist;
+                    gk_heap_f32_push(&w.heap, msg.dist, msg.vertex);
+                }
+            }
+            if (rc == 0) {
+                gp_worker_relax(&w, unit);
+                rc = gp_worker_reply(&w, fd);
+            }
+        } else if (frame.cmd == GP_CMD_RESULT) {
+            const uint32_t n = (uint32_t)p->n;
+            rc = gp_write_full(fd, &n, sizeof(n));
+            if (rc == 0) {
+                rc = gp_write_full(fd, p->global_ids, (size_t)p->n * sizeof(int));
+            }
+            if (rc == 0) {
+                rc = gp_write_full(fd, w.dist, (size_t)p->n * sizeof(float));
+            }
+        } else {
+            break;
+        }
+    }
+    free(w.dist);
+    free(w.sent);
+    gk_heap_f32_free(&w.heap);
+    free(w.out);
+    gp_part_free(p);
+    return rc == 0 ? 0 : 1;
+}
+
+// Coordinator:
+// Workers are forked from the calling process and load their part from
+// `<prefix>.<i>` themselves. Each child closes the coordinator's ends
+// of the earlier workers' sockets, so a worker only sees end of file
+// once the coordinator closes its own socket.
+gp_cluster* gp_cluster_start(const char* prefix, const int k) {
+    gp_cluster* c = xcalloc(1, sizeof(gp_cluster));
+    c->k = k;
+    c->pids = xcalloc((size_t)k, sizeof(pid_t));
+    c->fds = xmalloc((size_t)k * sizeof(int));
+    for (int i = 0; i < k; i++) {
+        c->fds[i] = -1;
+    }
+    fflush(stdout);
+    fflush(stderr);
+    int ok = 1;
+    for (int i = 0; i < k && ok; i++) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+            perror("socketpair");
+            ok = 0;
+            break;
+        }
+        const pid_t pid = fork();
+        if (pid < 0) {
+            perror("fork");
+            close(sv[0]);
+            close(sv[1]);
+            ok = 0;
+            break;
+        }
+        if (pid == 0) {
+            for (int j = 0; j < i; j++) {
+                close(c->fds[j]);
+            }
+            close(sv[0]);
+            char path[4096];
+            snprintf(path, sizeof(path), "%s.%d", prefix, i);
+            _exit(gp_worker_main(path, sv[1]));
+        }
+        close(sv[1]);
+        c->pids[i] = pid;
+        c->fds[i] = sv[0];
+    }
+    // Every worker answers with the global vertex count once loaded
+    for (int i = 0; i < k && ok; i++) {
+        uint32_t n_global;
+        if (gp_read_full(c->fds[i], &n_global, sizeof(n_global)) < 0
+                || (i > 0 && (int)n_global != c->n_global)) {
+            fprintf(stderr, "%s.%d: worker failed to start\n", prefix, i);
+            ok = 0;
+        }
+        c->n_global = (int)n_global;
+    }
+    if (!ok) {
+        gp_cluster_stop(c);
+        return NULL;
+    }
+    return c;
+}
+
+void gp_cluster_stop(gp_cluster* c) {
+    const gp_frame quit = {GP_CMD_QUIT, 0, 0};
+    for (int i = 0; i < c->k; i++) {
+        if (c->fds[i] >= 0) {
+            gp_write_full(c->fds[i], &quit, sizeof(quit));
+            close(c->fds[i]);
+        }
+    }
+    for (int i = 0; i < c->k; i++) {
+        if (c->pids[i] > 0) {
+            waitpid(c->pids[i], NULL, 0);
+        }
+    }
+    free(c->pids);
+    free(c->fds);
+    free(c);
+}
+
+// Read a reply of messages from worker `i` and file them under the
+// parts they are addressed to.
+static int gp_collect(gp_cluster* c, const int i, gp_message** inbox, int* inbox_len,
+                      int* inbox_cap) {
+    uint32_t count;
+    if (gp_read_full(c->fds[i], &count, sizeof(count)) < 0) {
+        return -1;
+    }
+    for (uint32_t j = 0; j < count; j++) {
+        gp_message msg;
+        if (gp_read_full(c->fds[i], &msg, sizeof(msg)) < 0 || msg.part < 0 || msg.part >= c->k) {
+            return -1;
+        }
+        const int p = msg.part;
+        if (inbox_len[p] == inbox_cap[p]) {
+            inbox_cap[p] = inbox_cap[p] ? inbox_cap[p] * 2 : 1024;
+            inbox[p] = xrealloc(inbox[p], (size_t)inbox_cap[p] * sizeof(gp_message));
+        }
+        inbox[p][inbox_len[p]++] = msg;
+    }
+    c->messages += count;
+    return 0;
+}
+
+// Supersteps:
+// Every worker starts, and afterwards only those with incoming messages
+// take part in a superstep. Once no messages are left, the distances
+// are gathered from every worker.
+static int gp_cluster_search(gp_cluster* c, const int src, const int unit, float* dist) {
+    for (int v = 0; v < c->n_global; v++) {
+        dist[v] = INFINITY;
+    }
+    if (src < 0 || src >= c->n_global) {
+        return 0;
+    }
+    gp_message** inbox = xcalloc((size_t)c->k, sizeof(gp_message*));
+    int* inbox_len = xcalloc((size_t)c->k, sizeof(int));
+    int* inbox_cap = xcalloc((size_t)c->k, sizeof(int));
+    int* active = xmalloc((size_t)c->k * sizeof(int));
+    int rc = 0;
+    const gp_frame start = {GP_CMD_START, (uint32_t)src, (uint32_t)unit};
+    for (int i = 0; i < c->k && rc == 0; i++) {
+        rc = gp_write_full(c->fds[i], &start, sizeof(start));
+        active[i] = 1;
+    }
+    while (rc == 0) {
+        for (int i = 0; i < c->k && rc == 0; i++) {
+            if (active[i]) {
+                rc = gp_collect(c, i, inbox, inbox_len, inbox_cap);
+            }
+        }
+        c->supersteps++;
+        int pending = 0;
+        for (int i = 0; i < c->k; i++) {
+            pending += inbox_len[i];
+        }
+        if (rc != 0 || pending == 0) {
+            break;
+        }
+        for (int i = 0; i < c->k && rc == 0; i++) {
+            active[i] = inbox_len[i] > 0;
+            if (!active[i]) {
+                continue;
+            }
+            const gp_frame step = {GP_CMD_STEP, (uint32_t)inbox_len[i], 0};
+            rc = gp_write_full(c->fds[i], &step, sizeof(step));
+            if (rc == 0) {
+                rc = gp_write_full(c->fds[i], inbox[i],
+                                   (size_t)inbox_len[i] * sizeof(gp_message));
+            }
+            inbox_len[i] = 0;
+        }
+    }
+
+    // Each worker answers with its vertex count, then their global ids
+    // and their distances
+    int reached = 0;
+    const gp_frame result = {GP_CMD_RESULT, 0, 0};
+    int* ids = NULL;
+    float* part_dist = NULL;
+    for (int i = 0; i < c->k && rc == 0; i++) {
+        uint32_t n = 0;
+        rc = gp_write_full(c->fds[i], &result, sizeof(result));
+        if (rc == 0) {
+            rc = gp_read_full(c->fds[i], &n, sizeof(n));
+        }
+        if (rc == 0 && n > (uint32_t)c->n_global) {
+            rc = -1;
+        }
+        if (rc != 0) {
+            break;
+        }
+        ids = xrealloc(ids, (size_t)n * sizeof(int) + 1);
+        part_dist = xrealloc(part_dist, (size_t)n * sizeof(float) + 1);
+        rc = gp_read_full(c->fds[i], ids, (size_t)n * sizeof(int));
+        if (rc == 0) {
+            rc = gp_read_full(c->fds[i], part_dist, (size_t)n * sizeof(float));
+        }
+        for (uint32_t j = 0; j < n && rc == 0; j++) {
+            if (ids[j] < 0 || ids[j] >= c->n_global) {
+                rc = -1;
+                break;
+            }
+            dist[ids[j]] = part_dist[j];
+            reached += !isinf(part_dist[j]);
+        }
+    }
+    free(part_dist);
+    free(ids);
+    for (int i = 0; i < c->k; i++) {
+        free(inbox[i]);
+    }
+    free(inbox);
+    free(inbox_len);
+    free(inbox_cap);
+    free(active);
+    return rc == 0 ? reached : -1;
+}
+
+// Distances from `src` to every vertex, by global id. Returns the
+// number of vertices reached, or -1 if a worker failed.
+int gp_cluster_sssp(gp_cluster* c, const int src, float* dist) {
+    return gp_cluster_search(c, src, 0, dist);
+}
+
+int gp_cluster_bfs(gp_cluster* c, const int src, int* hops) {
+    float* dist = xmalloc((size_t)c->n_global * sizeof(float) + 1);
+    const int reached = gp_cluster_search(c, src, 1, dist);
+    for (int v = 0; v < c->n_global; v++) {
+        hops[v] = isinf(dist[v]) ? -1 : (int)dist[v];
+    }
+    free(dist);
+    return reached;
+}
@@ -0,0 +1,463 @@
+//
+//  graph_rank.c
+//  hash_table
+//
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "xmalloc.h"
+
+#include "graph_rank.h"
+
+gr_ranker* gr_new(const gk_csr* csr, const float* weights, const int num_threads) {
+    gr_ranker* r = xcalloc(1, sizeof(gr_ranker));
+    r->csr = csr;
+    r->weights = weights;
+    const int n = csr->n;
+    const int m = csr->m;
+
+    // Counting sort of the edges by target. Sources come out ascending
+    // within each row, since the CSR is walked in order.
+    r->in_offsets = xcalloc((size_t)n + 1, sizeof(int));
+    r->in_sources = xmalloc(((size_t)m + 1) * sizeof(int));
+    r->in_edges = xmalloc(((size_t)m + 1) * sizeof(int));
+    for (int e = 0; e < m; e++) {
+        r->in_offsets[csr->targets[e] + 1]++;
+    }
+    for (int v = 0; v < n; v++) {
+        r->in_offsets[v + 1] += r->in_offsets[v];
+    }
+    int* next = xmalloc(((size_t)n + 1) * sizeof(int));
+    memcpy(next, r->in_offsets, (size_t)n * sizeof(int));
+    for (int u = 0; u < n; u++) {
+        for (int e = csr->offsets[u]; e < csr->offsets[u + 1]; e++) {
+            const int j = next[csr->targets[e]]++;
+            r->in_sources[j] = u;
+            r->in_edges[j] = e;
+        }
+    }
+    free(next);
+    r->inv_degree = xmalloc(((size_t)n + 1) * sizeof(float));
+    for (int u = 0; u < n; u++) {
+        const int degree = csr->offsets[u + 1] - csr->offsets[u];
+        r->inv_degree[u] = degree > 0 ? 1.0f / degree : 0;
+    }
+
+    // Split the vertices so each thread pulls over about as many edges,
+    // counting a vertex as an edge for its own update
+    r->num_threads = num_threads > 0 ? num_threads : 1;
+    r->bounds = xmalloc(((size_t)r->num_threads + 1) * sizeof(int));
+    const double total = (double)m + n;
+    int v = 0;
+    r->bounds[0] = 0;
+    for (int t = 1; t < r->num_threads; t++) {
+        while (v < n && (double)r->in_offsets[v] + v < total * t / r->num_threads) {
+            v++;
+        }
+        r->bounds[t] = v;
+    }
+    r->bounds[r->num_threads] = n;
+    return r;
+}
+
+void gr_del(gr_ranker* r) {
+    free(r->in_offsets);
+    free(r->in_sources);
+    free(r->in_edges);
+    free(r->inv_degree);
+    free(r->bounds);
+    free(r);
+}
+
+// Sum of `contrib` over `len` sources. Rows of 8 or more are gathered
+// 8 at a time with AVX2. Shorter ones, which is nearly all of them on
+// road networks, are cheaper with scalar loads into 4 sums.
+static float gr_gather(const float* contrib, const int* sources, const int len) {
+    int j = 0;
+    float sum = 0;
+#ifdef __AVX2__
+    if (len >= 8) {
+        __m256 acc = _mm256_setzero_ps();
+        for (; j + 8 <= len; j += 8) {
+            const __m256i idx = _mm256_loadu_si256((const __m256i*)(sources + j));
+            acc = _mm256_add_ps(acc, _mm256_i32gather_ps(contrib, idx, 4));
+        }
+        __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+        half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+        half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+        sum = _mm_cvtss_f32(half);
+    }
+#endif
+    float partial[4] = {0, 0, 0, 0};
+    for (; j + 4 <= len; j += 4) {
+        partial[0] += contrib[sources[j]];
+        partial[1] += contrib[sources[j + 1]];
+        partial[2] += contrib[sources[j + 2]];
+        partial[3] += contrib[sources[j + 3]];
+    }
+    sum += (partial[0] + partial[1]) + (partial[2] + partial[3]);
+    for (; j < len; j++) {
+        sum += contrib[sources[j]];
+    }
+    return sum;
+}
+
+// Per-thread sums of the last round, double buffered by the parity of
+// the round: a thread only writes a slot again two rounds later, after
+// everyone has read it.
+typedef struct {
+    double dangling[2];
+    double delta[2];
+    char pad[64];
+} gr_slot;
+
+// `start` is held until every thread that could be created is, and the
+// barrier sized to the `num_threads` of them.
+typedef struct {
+    gr_ranker* r;
+    pthread_mutex_t start;
+    int num_threads;
+    pthread_barrier_t barrier;
+    gr_slot* slots;
+    float* rank[2];
+    float* contrib[2];
+    float damping;
+    double tolerance;
+    int max_iterations;
+    double initial_dangling;
+    int iterations;
+    double delta;
+} gr_pagerank_job;
+
+typedef struct {
+    gr_pagerank_job* job;
+    int tid;
+} gr_pagerank_args;
+
+static void* gr_pagerank_worker(void* arg) {
+    const gr_pagerank_args* a = arg;
+    gr_pagerank_job* job = a->job;
+    const gr_ranker* r = job->r;
+    const int n = r->csr->n;
+    pthread_mutex_lock(&job->start);
+    pthread_mutex_unlock(&job->start);
+    const float damping = job->damping;
+    double dangling = job->initial_dangling;
+    int it = 0;
+    while (it < job->max_iterations) {
+        const int cur = it & 1;
+        const float* rank = job->rank[cur];
+        const float* contrib = job->contrib[cur];
+        float* next = job->rank[cur ^ 1];
+        float* next_contrib = job->contrib[cur ^ 1];
+        const float base = (float)((1 - damping + damping * dangling) / n);
+        double my_dangling = 0;
+        double my_delta = 0;
+        // Ranges of threads that could not be started are shared out
+        // among those that were
+        for (int part = a->tid; part < r->num_threads; part += job->num_threads) {
+            for (int v = r->bounds[part]; v < r->bounds[part + 1]; v++) {
+                const int begin = r->in_offsets[v];
+                const float sum = gr_gather(contrib, r->in_sources + begin,
+                                            r->in_offsets[v + 1] - begin);
+                const float value = base + damping * sum;
+                next[v] = value;
+                next_contrib[v] = value * r->inv_degree[v];
+                my_dangling += r->inv_degree[v] == 0 ? value : 0;
+                my_delta += fabsf(value - rank[v]);
+            }
+        }
+        job->slots[a->tid].dangling[cur] = my_dangling;
+        job->slots[a->tid].delta[cur] = my_delta;
+        pthread_barrier_wait(&job->barrier);
+
+        dangling = 0;
+        double delta = 0;
+        for (int t = 0; t < job->num_threads; t++) {
+            dangling += job->slots[t].dangling[cur];
+            delta += job->slots[t].delta[cur];
+        }
+        it++;
+        if (a->tid == 0) {
+            job->delta = delta;
+        }
+        if (delta < job->tolerance) {
+            break;
+        }
+    }
+    if (a->tid == 0) {
+        job->iterations = it;
+    }
+    return NULL;
+}
+
+int gr_pagerank(gr_ranker* r, const float damping, const double tolerance,
+                const int max_iterations, float* rank) {
+    const int n = r->csr->n;
+    if (n == 0) {
+        r->iterations = 0;
+        r->delta = 0;
+        return 0;
+    }
+    gr_pagerank_job job;
+    memset(&job, 0, sizeof(job));
+    job.r = r;
+    job.damping = damping > 0 ? damping : GR_DAMPING;
+    job.tolerance = tolerance > 0 ? tolerance : GR_TOLERANCE;
+    job.max_iterations = max_iterations;
+    job.slots = xcalloc((size_t)r->num_threads, sizeof(gr_slot));
+    job.rank[0] = rank;
+    job.rank[1] = xmalloc((size_t)n * sizeof(float));
+    job.contrib[0] = xmalloc((size_t)n * sizeof(float));
+    job.contrib[1] = xmalloc((size_t)n * sizeof(float));
+    for (int v = 0; v < n; v++) {
+        rank[v] = 1.0f / n;
+        job.contrib[0][v] = rank[v] * r->inv_degree[v];
+        job.initial_dangling += r->inv_degree[v] == 0 ? rank[v] : 0;
+    }
+    pthread_t* threads = xmalloc((size_t)r->num_threads * sizeof(pthread_t));
+    gr_pagerank_args* args = xmalloc((size_t)r->num_threads * sizeof(gr_pagerank_args));
+    for (int t = 0; t < r->num_threads; t++) {
+        args[t].job = &job;
+        args[t].tid = t;
+    }
+    // Started threads take the lowest ids, so their slots and ranges
+    // stay contiguous whichever creations fail
+    pthread_mutex_init(&job.start, NULL);
+    pthread_mutex_lock(&job.start);
+    job.num_threads = 1;
+    for (int t = 1; t < r->num_threads; t++) {
+        if (pthread_create(&threads[job.num_threads], NULL, gr_pagerank_worker,
+                           &args[job.num_threads]) == 0) {
+            job.num_threads++;
+        }
+    }
+    pthread_barrier_init(&job.barrier, NULL, (unsigned)job.num_threads);
+    pthread_mutex_unlock(&job.start);
+    gr_pagerank_worker(&args[0]);
+    for (int t = 1; t < job.num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    pthread_barrier_destroy(&job.barrier);
+    pthread_mutex_destroy(&job.start);
+    if (job.iterations & 1) {
+        memcpy(rank, job.rank[1], (size_t)n * sizeof(float));
+    }
+    r->iterations = job.iterations;
+    r->delta = job.delta;
+    free(job.rank[1]);
+    free(job.contrib[0]);
+    free(job.contrib[1]);
+    free(job.slots);
+    free(threads);
+    free(args);
+    return job.iterations;
+}
+
+// Per-thread state of the betweenness searches. `order` lists the
+// vertices in the order they were settled.
+typedef struct {
+    float* dist;
+    double* sigma;
+    double* dependency;
+    int* order;
+    gk_heap_f32 heap;
+    double* vertex_sums;
+    double* edge_sums;
+} gr_brandes;
+
+typedef struct {
+    gr_ranker* r;
+    const int* sources;
+    int num_sources;
+    atomic_int next;
+    gr_brandes* locals;
+    int with_edges;
+} gr_brandes_job;
+
+typedef struct {
+    gr_brandes_job* job;
+    int tid;
+} gr_brandes_args;
+
+static float gr_weight(const gr_ranker* r, const int e) {
+    return r->weights != NULL ? r->weights[e] : 1.0f;
+}
+
+// Dijkstra from `src` with a lazy heap, recording the settled order
+// and counting shortest paths on the way: a vertex reached at a new
+// best distance takes over the count of the vertex it was reached
+// from, and one reached again at the same distance adds it. Returns
+// the number of vertices settled.
+static int gr_settle(const gr_ranker* r, gr_brandes* b, const int src) {
+    const gk_csr* csr = r->csr;
+    int settled = 0;
+    b->dist[src] = 0;
+    b->sigma[src] = 1;
+    gk_heap_f32_push(&b->heap, 0, src);
+    while (b->heap.len > 0) {
+        float d;
+        const int u = gk_heap_f32_pop(&b->heap, &d);
+        if (d > b->dist[u]) {
+            continue;
+        }
+        b->order[settled++] = u;
+        for (int e = csr->offsets[u]; e < csr->offsets[u + 1]; e++) {
+            const int v = csr->targets[e];
+            const float nd = d + gr_weight(r, e);
+            if (nd == b->dist[v]) {
+                b->sigma[v] += b->sigma[u];
+            } else if (nd < b->dist[v]) {
+                b->dist[v] = nd;
+                b->sigma[v] = b->sigma[u];
+                gk_heap_f32_push(&b->heap, nd, v);
+            }
+        }
+    }
+    return settled;
+}
+
+// One source's contribution. Dependencies go backward in settled order
+// over the shortest path predecessors, which are the in-neighbours `v`
+// of `w` with `dist[v] + weight == dist[w]`. That sum is computed
+// exactly as it was when settling.
+static void gr_brandes_source(const gr_ranker* r, gr_brandes* b, const int src,
+                              const int with_edges) {
+    const int settled = gr_settle(r, b, src);
+    for (int i = settled - 1; i > 0; i--) {
+        const int w = b->order[i];
+        const double share = (1 + b->dependency[w]) / b->sigma[w];
+        const float dw = b->dist[w];
+        for (int j = r->in_offsets[w]; j < r->in_offsets[w + 1]; j++) {
+            const int v = r->in_sources[j];
+            if (b->dist[v] + gr_weight(r, r->in_edges[j]) == dw) {
+                const double c = b->sigma[v] * share;
+                b->dependency[v] += c;
+                if (with_edges) {
+                    b->edge_sums[r->in_edges[j]] += c;
+                }
+            }
+        }
+        b->vertex_sums[w] += b->dependency[w];
+    }
+    for (int i = 0; i < settled; i++) {
+        const int v = b->order[i];
+        b->dist[v] = INFINITY;
+        b->sigma[v] = 0;
+        b->dependency[v] = 0;
+    }
+}
+
+static void* gr_brandes_worker(void* arg) {
+    const gr_brandes_args* a = arg;
+    gr_brandes_job* job = a->job;
+    gr_brandes* b = &job->locals[a->tid];
+    for (;;) {
+        const int i = atomic_fetch_add(&job->next, 1);
+        if (i >= job->num_sources) {
+            return NULL;
+        }
+        gr_brandes_source(job->r, b, job->sources[i], job->with_edges);
+    }
+}
+
+void gr_betweenness(gr_ranker* r, const int samples, const uint64_t seed, float* vertex_scores,
+                    float* edge_scores) {
+    const int n = r->csr->n;
+    const int m = r->csr->m;
+    if (n == 0) {
+        return;
+    }
+    // The first `num_sources` of a partial Fisher-Yates shuffle
+    const int num_sources = samples > 0 && samples < n ? samples : n;
+    int* sources = xmalloc((size_t)n * sizeof(int));
+    for (int v = 0; v < n; v++) {
+        sources[v] = v;
+    }
+    uint64_t x = seed ? seed : 1;
+    for (int i = 0; i < num_sources && num_sources < n; i++) {
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        const int j = i + (int)((x * 0x2545F4914F6CDD1DULL >> 33) % (uint64_t)(n - i));
+        const int tmp = sources[i];
+        sources[i] = sources[j];
+        sources[j] = tmp;
+    }
+
+    gr_brandes_job job;
+    job.r = r;
+    job.sources = sources;
+    job.num_sources = num_sources;
+    atomic_init(&job.next, 0);
+    job.with_edges = edge_scores != NULL;
+    job.locals = xcalloc((size_t)r->num_threads, sizeof(gr_brandes));
+    for (int t = 0; t < r->num_threads; t++) {
+        gr_brandes* b = &job.locals[t];
+        b->dist = xmalloc((size_t)n * sizeof(float));
+        for (int v = 0; v < n; v++) {
+            b->dist[v] = INFINITY;
+        }
+        b->sigma = xcalloc((size_t)n, sizeof(double));
+        b->dependency = xcalloc((size_t)n, sizeof(double));
+        b->order = xmalloc((size_t)n * sizeof(int));
+        b->vertex_sums = xcalloc((size_t)n, sizeof(double));
+        b->edge_sums = job.with_edges ? xcalloc((size_t)m + 1, sizeof(double)) : NULL;
+    }
+    pthread_t* threads = xmalloc((size_t)r->num_threads * sizeof(pthread_t));
+    gr_brandes_args* args = xmalloc((size_t)r->num_threads * sizeof(gr_brandes_args));
+    for (int t = 0; t < r->num_threads; t++) {
+        args[t].job = &job;
+        args[t].tid = t;
+    }
+    // Sources are handed out one at a time, so those a thread that could
+    // not be started would have taken go to the others
+    int* started = xcalloc((size_t)r->num_threads, sizeof(int));
+    for (int t = 1; t < r->num_threads; t++) {
+        started[t] = pthread_create(&threads[t], NULL, gr_brandes_worker, &args[t]) == 0;
+    }
+    gr_brandes_worker(&args[0]);
+    for (int t = 1; t < r->num_threads; t++) {
+        if (started[t]) {
+            pthread_join(threads[t], NULL);
+        }
+    }
+    free(started);
+
+    const double scale = (double)n / num_sources;
+    for (int v = 0; v < n && vertex_scores != NULL; v++) {
+        double sum = 0;
+        for (int t = 0; t < r->num_threads; t++) {
+            sum += job.locals[t].vertex_sums[v];
+        }
+        vertex_scores[v] = (float)(sum * scale);
+    }
+    for (int e = 0; e < m && edge_scores != NULL; e++) {
+        double sum = 0;
+        for (int t = 0; t < r->num_threads; t++) {
+            sum += job.locals[t].edge_sums[e];
+        }
+        edge_scores[e] = (float)(sum * scale);
+    }
+    for (int t = 0; t < r->num_threads; t++) {
+        gr_brandes* b = &job.locals[t];
+        free(b->dist);
+        free(b->sigma);
+        free(b->dependency);
+        free(b->order);
+        gk_heap_f32_free(&b->heap);
+        free(b->vertex_sums);
+        free(b->edge_sums);
+    }
+    free(job.locals);
+    free(threads);
+    free(args);
+    free(sources);
+}
@@ -0,0 +1,246 @@
+//
+//  graph_reorder.c
+//  hash_table
+//
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xmalloc.h"
+
+#include "graph_kernels.h"
+#include "graph_reorder.h"
+
+typedef struct {
+    uint64_t key;
+    int vertex;
+} gk_rank;
+
+static int gk_rank_cmp(const void* a, const void* b) {
+    const gk_rank* x = a;
+    const gk_rank* y = b;
+    if (x->key != y->key) {
+        return x->key < y->key ? -1 : 1;
+    }
+    return x->vertex - y->vertex;
+}
+
+// Turn sorted ranks into `perm[old_id] == new_id`.
+static int* gk_ranks_to_perm(gk_rank* ranks, const int n) {
+    qsort(ranks, (size_t)n, sizeof(gk_rank), gk_rank_cmp);
+    int* perm = xmalloc((size_t)n * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        perm[ranks[i].vertex] = i;
+    }
+    return perm;
+}
+
+// Distance along the Hilbert curve filling a 2^16 x 2^16 grid.
+static uint64_t hilbert_index(uint32_t x, uint32_t y) {
+    const uint32_t side = 1u << 16;
+    uint64_t d = 0;
+    for (uint32_t s = side / 2; s > 0; s /= 2) {
+        const uint32_t rx = (x & s) > 0;
+        const uint32_t ry = (y & s) > 0;
+        d += (uint64_t)s * s * ((3 * rx) ^ ry);
+        // Rotate the quadrant so the curve stays continuous
+        if (ry == 0) {
+            if (rx == 1) {
+                x = side - 1 - x;
+                y = side - 1 - y;
+            }
+            const uint32_t t = x;
+            x = y;
+            y = t;
+        }
+    }
+    return d;
+}
+
+// Hilbert order:
+// Scale every location into the grid spanned by the bounding box of all
+// locations and sort by position along the curve.
+int* gk_order_hilbert(const gk_csr* csr) {
+    float min_lat = INFINITY;
+    float max_lat = -INFINITY;
+    float min_lon = INFINITY;
+    float max_lon = -INFINITY;
+    for (int v = 0; v < csr->n; v++) {
+        const gps* loc = csr->nodes[v]->location;
+        if (loc != NULL) {
+            min_lat = fminf(min_lat, *loc->lat);
+            max_lat = fmaxf(max_lat, *loc->lat);
+            min_lon = fminf(min_lon, *loc->lon);
+            max_lon = fmaxf(max_lon, *loc->lon);
+        }
+    }
+    const double lat_scale = max_lat > min_lat ? 65535.0 / (max_lat - min_lat) : 0;
+    const double lon_scale = max_lon > min_lon ? 65535.0 / (max_lon - min_lon) : 0;
+
+    gk_rank* ranks = xmalloc((size_t)csr->n * sizeof(gk_rank));
+    for (int v = 0; v < csr->n; v++) {
+        const gps* loc = csr->nodes[v]->location;
+        ranks[v].vertex = v;
+        if (loc == NULL) {
+            ranks[v].key = UINT64_MAX;
+            continue;
+        }
+        const uint32_t x = (uint32_t)((*loc->lon - min_lon) * lon_scale);
+        const uint32_t y = (uint32_t)((*loc->lat - min_lat) * lat_scale);
+        ranks[v].key = hilbert_index(x, y);
+    }
+    int* perm = gk_ranks_to_perm(ranks, csr->n);
+    free(ranks);
+    return perm;
+}
+
+// Vertices sort by degree, ties by id. The degree travels with the id
+// so the comparator needs no state and orderings can run concurrently.
+typedef struct {
+    int degree;
+    int id;
+} rcm_vertex;
+
+static int rcm_vertex_cmp(const void* a, const void* b) {
+    const rcm_vertex* x = a;
+    const rcm_vertex* y = b;
+    if (x->degree != y->degree) {
+        return x->degree - y->degree;
+    }
+    return x->id - y->id;
+}
+
+// Reverse Cuthill-McKee:
+// Breadth first from a vertex of least degree, visiting each vertex's
+// unvisited neighbours in increasing degree, restarting at the next
+// least-degree vertex for every component. Reversing the visit order
+// gives the labels.
+int* gk_order_rcm(const gk_csr* csr) {
+    const int n = csr->n;
+    rcm_vertex* by_degree = xmalloc((size_t)n * sizeof(rcm_vertex) + 1);
+    int max_degree = 0;
+    for (int v = 0; v < n; v++) {
+        by_degree[v].degree = csr->offsets[v + 1] - csr->offsets[v];
+        by_degree[v].id = v;
+        max_degree = by_degree[v].degree > max_degree ? by_degree[v].degree : max_degree;
+    }
+    qsort(by_degree, (size_t)n, sizeof(rcm_vertex), rcm_vertex_cmp);
+
+    char* visited = xcalloc((size_t)n, 1);
+    int* order = xmalloc((size_t)n * sizeof(int));
+    rcm_vertex* next = xmalloc((size_t)max_degree * sizeof(rcm_vertex) + 1);
+    int tail = 0;
+    for (int s = 0; s < n; s++) {
+        const int start = by_degree[s].id;
+        if (visited[start]) {
+            continue;
+        }
+        int head = tail;
+        visited[start] = 1;
+        order[tail++] = start;
+        while (head < tail) {
+            const int u = order[head++];
+            int count = 0;
+            for (int e = csr->offsets[u]; e < csr->offsets[u + 1]; e++) {
+                const int v = csr->targets[e];
+                if (!visited[v]) {
+                    visited[v] = 1;
+                    next[count++] = (rcm_vertex){csr->offsets[v + 1] - csr->offsets[v], v};
+                }
+            }
+            qsort(next, (size_t)count, sizeof(rcm_vertex), rcm_vertex_cmp);
+            for (int i = 0; i < count; i++) {
+                order[tail++] = next[i].id;
+            }
+        }
+    }
+    int* perm = xmalloc((size_t)n * sizeof(int));
+    for (int i = 0; i < n; i++) {
+        perm[order[i]] = n - 1 - i;
+    }
+    free(by_degree);
+    free(visited);
+    free(order);
+    free(next);
+    return perm;
+}
+
+typedef struct {
+    int target;
+    int edge;
+} gk_slot;
+
+static int gk_slot_cmp(const void* a, const void* b) {
+    return ((const gk_slot*)a)->target - ((const gk_slot*)b)->target;
+}
+
+// Relayout:
+// Row `perm[v]` of the new CSR holds the edges of old vertex `v` with
+// their targets relabelled and re-sorted, each weight moving with its
+// edge. Node pointers and the bucket map follow the vertices.
+void gk_permute(gk_csr* csr, void* weights, const size_t weight_size, const int* perm) {
+    const int n = csr->n;
+    int* inverse = xmalloc((size_t)n * sizeof(int));
+    for (int v = 0; v < n; v++) {
+        inverse[perm[v]] = v;
+    }
+    int* offsets = xmalloc(((size_t)n + 1) * sizeof(int));
+    int* targets = xmalloc((size_t)csr->m * sizeof(int));
+    char* new_weights = weights != NULL ? xmalloc((size_t)csr->m * weight_size) : NULL;
+    gk_slot* slots = xmalloc((size_t)csr->m * sizeof(gk_slot));
+
+    offsets[0] = 0;
+    for (int r = 0; r < n; r++) {
+        const int v = inverse[r];
+        const int begin = csr->offsets[v];
+        const int degree = csr->offsets[v + 1] - begin;
+        for (int i = 0; i < degree; i++) {
+            slots[i] = (gk_slot){perm[csr->targets[begin + i]], begin + i};
+        }
+        qsort(slots, (size_t)degree, sizeof(gk_slot), gk_slot_cmp);
+        for (int i = 0; i < degree; i++) {
+            targets[offsets[r] + i] = slots[i].target;
+            if (new_weights != NULL) {
+                memcpy(new_weights + (size_t)(offsets[r] + i) * weight_size,
+                       (char*)weights + (size_t)slots[i].edge * weight_size, weight_size);
+            }
+        }
+        offsets[r + 1] = offsets[r] + degree;
+    }
+    if (new_weights != NULL) {
+        memcpy(weights, new_weights, (size_t)csr->m * weight_size);
+    }
+
+    node** nodes = xmalloc((size_t)n * sizeof(node*));
+    for (int v = 0; v < n; v++) {
+        nodes[perm[v]] = csr->nodes[v];
+    }
+    for (int b = 0; b < csr->N->size; b++) {
+        if (csr->bucket_ids[b] >= 0) {
+            csr->bucket_ids[b] = perm[csr->bucket_ids[b]];
+        }
+    }
+    free(csr->offsets);
+    free(csr->targets);
+    free(csr->nodes);
+    csr->offsets = offsets;
+    csr->targets = targets;
+    csr->nodes = nodes;
+    free(new_weights);
+    free(slots);
+    free(inverse);
+}
+
+// Mean distance in id between the ends of an edge; lower means
+// traversals touch nearby memory.
+double gk_bandwidth(const gk_csr* csr) {
+    double total = 0;
+    for (int v = 0; v < csr->n; v++) {
+        for (int e = csr->offsets[v]; e < csr->offsets[v + 1]; e++) {
+            total += abs(csr->targets[e] - v);
+        }
+    }
+    return csr->m > 0 ? total / csr->m : 0;
+}
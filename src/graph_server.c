@@ -0,0 +1,431 @@
+//
+//  graph_server.c
+//  hash_table
+//
+
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "xmalloc.h"
+
+#include "graph_kernels.h"
+#include "graph_server.h"
+#include "hash_table.h"
+
+#define GS_READ_CHUNK 65536
+
+typedef struct gs_conn {
+    int fd;
+    char* in;
+    size_t in_len;
+    size_t in_cap;
+    char* out;
+    size_t out_len;
+    size_t out_sent;
+    size_t out_cap;
+    struct gs_conn* prev;
+    struct gs_conn* next;
+} gs_conn;
+
+// Scratch space of one worker thread for point to point searches.
+// `dist` stays INFINITY between searches except at the `touched`
+// vertices, which are reset at the start of the next one.
+typedef struct {
+    gs_server* s;
+    float* dist;
+    int* touched;
+    int num_touched;
+    gk_heap_f32 heap;
+} gs_worker;
+
+static void gs_reserve(char** buf, size_t* cap, const size_t needed) {
+    if (needed > *cap) {
+        *cap = needed > 2 * *cap ? needed : 2 * *cap;
+        *buf = xrealloc(*buf, *cap);
+    }
+}
+
+static void gs_respond(gs_conn* c, const uint32_t id, const int code, const void* payload,
+                       const uint32_t len) {
+    gs_reserve(&c->out, &c->out_cap, c->out_len + sizeof(gs_header) + len);
+    gs_header h = {len, id, (uint8_t)code, {0}};
+    memcpy(c->out + c->out_len, &h, sizeof(h));
+    if (len > 0) {
+        memcpy(c->out + c->out_len + sizeof(h), payload, len);
+    }
+    c->out_len += sizeof(h) + len;
+}
+
+// Point to point Dijkstra:
+// The lazy heap search of the `sssp` kernels, stopping as soon as `dst`
+// is settled. Only vertices actually reached are reset afterwards, so
+// short routes on a large graph stay cheap. Returns 0 if `dst` can't be
+// reached.
+static int gs_route(gs_worker* w, const int src, const int dst, float* out) {
+    const gk_f32_dir_graph* g = w->s->graph;
+    const gk_csr* csr = &g->csr;
+    for (int i = 0; i < w->num_touched; i++) {
+        w->dist[w->touched[i]] = INFINITY;
+    }
+    w->num_touched = 0;
+    w->heap.len = 0;
+    w->dist[src] = 0;
+    w->touched[w->num_touched++] = src;
+    gk_heap_f32_push(&w->heap, 0, src);
+    while (w->heap.len > 0) {
+        float d;
+        const int u = gk_heap_f32_pop(&w->heap, &d);
+        if (d > w->dist[u]) {
+            continue;
+        }
+        if (u == dst) {
+            *out = d;
+            return 1;
+        }
+        for (int e = csr->offsets[u]; e < csr->offsets[u + 1]; e++) {
+            const int v = csr->targets[e];
+            const float nd = d + g->weights[e];
+            if (nd >= w->dist[v]) {
+                continue;
+            }
+            if (isinf(w->dist[v])) {
+                w->touched[w->num_touched++] = v;
+            }
+            w->dist[v] = nd;
+            gk_heap_f32_push(&w->heap, nd, v);
+        }
+    }
+    return 0;
+}
+
+// Split a payload into its two NUL terminated keys. Returns 0 if the
+// lengths don't add up.
+static int gs_parse_keys(const char* payload, const uint32_t len, char* key, char* other) {
+    uint16_t key_len;
+    if (len < sizeof(key_len)) {
+        return 0;
+    }
+    memcpy(&key_len, payload, sizeof(key_len));
+    const uint32_t other_len = len - sizeof(key_len) - key_len;
+    if (key_len > len - sizeof(key_len) || key_len > GS_MAX_KEY || other_len > GS_MAX_KEY) {
+        return 0;
+    }
+    memcpy(key, payload + sizeof(key_len), key_len);
+    key[key_len] = '\0';
+    memcpy(other, payload + sizeof(key_len) + key_len, other_len);
+    other[other_len] = '\0';
+    return 1;
+}
+
+static void gs_handle(gs_worker* w, gs_conn* c, const gs_header* h, const char* payload) {
+    char key[GS_MAX_KEY + 1];
+    char other[GS_MAX_KEY + 1];
+    if (!gs_parse_keys(payload, h->len, key, other)) {
+        gs_respond(c, h->id, GS_BAD_REQUEST, NULL, 0);
+        return;
+    }
+    const gk_csr* csr = &w->s->graph->csr;
+    switch (h->code) {
+    case GS_GET: {
+        const char* value = ht_search(w->s->table, key);
+        if (value == NULL) {
+            gs_respond(c, h->id, GS_NOT_FOUND, NULL, 0);
+        } else {
+            gs_respond(c, h->id, GS_OK, value, (uint32_t)strlen(value));
+        }
+        break;
+    }
+    case GS_NODE: {
+        const int v = gk_vertex(csr, key);
+        const gps* location = v < 0 ? NULL : csr->nodes[v]->location;
+        if (location == NULL) {
+            gs_respond(c, h->id, GS_NOT_FOUND, NULL, 0);
+        } else {
+            const float lat_lon[2] = {*location->lat, *location->lon};
+            gs_respond(c, h->id, GS_OK, lat_lon, sizeof(lat_lon));
+        }
+        break;
+    }
+    case GS_ROUTE: {
+        const int src = gk_vertex(csr, key);
+        const int dst = gk_vertex(csr, other);
+        float distance;
+        if (src < 0 || dst < 0 || !gs_route(w, src, dst, &distance)) {
+            gs_respond(c, h->id, GS_NOT_FOUND, NULL, 0);
+        } else {
+            gs_respond(c, h->id, GS_OK, &distance, sizeof(distance));
+        }
+        break;
+    }
+    default:
+        gs_respond(c, h->id, GS_BAD_REQUEST, NULL, 0);
+    }
+}
+
+// Answer every complete request in the input buffer and keep the
+// partial one, if any, for the next read. Returns -1 on a request too
+// large to be valid, after which the stream can't be trusted.
+static int gs_process(gs_worker* w, gs_conn* c) {
+    size_t at = 0;
+    while (c->in_len - at >= sizeof(gs_header)) {
+        gs_header h;
+        memcpy(&h, c->in + at, sizeof(h));
+        if (h.len > GS_MAX_PAYLOAD) {
+            return -1;
+        }
+        if (c->in_len - at - sizeof(h) < h.len) {
+            break;
+        }
+        gs_handle(w, c, &h, c->in + at + sizeof(h));
+        at += sizeof(h) + h.len;
+    }
+    memmove(c->in, c->in + at, c->in_len - at);
+    c->in_len -= at;
+    return 0;
+}
+
+// Write out pending responses. Returns 1 if the socket is full, 0 once
+// everything is written and -1 if the connection failed.
+static int gs_flush(gs_conn* c) {
+    while (c->out_sent < c->out_len) {
+        const ssize_t n = send(c->fd, c->out + c->out_sent, c->out_len - c->out_sent,
+                               MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 1 : -1;
+        }
+        c->out_sent += (size_t)n;
+    }
+    c->out_len = 0;
+    c->out_sent = 0;
+    return 0;
+}
+
+static void gs_close(gs_server* s, gs_conn* c) {
+    pthread_mutex_lock(&s->conns_lock);
+    if (c->prev != NULL) {
+        c->prev->next = c->next;
+    } else {
+        s->conns = c->next;
+    }
+    if (c->next != NULL) {
+        c->next->prev = c->prev;
+    }
+    pthread_mutex_unlock(&s->conns_lock);
+    epoll_ctl(s->epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    free(c->in);
+    free(c->out);
+    free(c);
+}
+
+static void gs_accept(gs_server* s) {
+    for (;;) {
+        const int fd = accept4(s->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        gs_conn* c = xcalloc(1, sizeof(gs_conn));
+        c->fd = fd;
+        pthread_mutex_lock(&s->conns_lock);
+        c->next = s->conns;
+        if (s->conns != NULL) {
+            s->conns->prev = c;
+        }
+        s->conns = c;
+        pthread_mutex_unlock(&s->conns_lock);
+        struct epoll_event ev = {.events = EPOLLIN | EPOLLONESHOT, .data.ptr = c};
+        epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+// Serving a connection:
+// Connections are registered one-shot, so exactly one worker owns a
+// connection between a readiness event and re-arming it. The worker
+// drains the socket, answers every pipelined request it read, in order,
+// and writes all the responses at once. While responses are left over
+// from a full socket it waits for the socket to drain before reading
+// more requests.
+static void gs_serve(gs_worker* w, gs_conn* c) {
+    gs_server* s = w->s;
+    int status = gs_flush(c);
+    int closed = 0;
+    while (status == 0 && !closed) {
+        gs_reserve(&c->in, &c->in_cap, c->in_len + GS_READ_CHUNK);
+        const ssize_t n = read(c->fd, c->in + c->in_len, c->in_cap - c->in_len);
+        if (n > 0) {
+            c->in_len += (size_t)n;
+            closed = gs_process(w, c) < 0;
+            status = gs_flush(c);
+        } else if (n == 0 || (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK)) {
+            closed = 1;
+        } else if (errno != EINTR) {
+            break;
+        }
+    }
+    if (closed || status < 0) {
+        gs_close(s, c);
+        return;
+    }
+    struct epoll_event ev = {.events = (status == 1 ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT,
+                             .data.ptr = c};
+    epoll_ctl(s->epoll_fd, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+static void* gs_worker_main(void* arg) {
+    gs_worker* w = arg;
+    gs_server* s = w->s;
+    struct epoll_event ev;
+    for (;;) {
+        // One event at a time, so ready connections spread over workers
+        const int n = epoll_wait(s->epoll_fd, &ev, 1, -1);
+        if (n <= 0) {
+            continue;
+        }
+        if (ev.data.ptr == &s->wake_fd) {
+            break;
+        }
+        if (ev.data.ptr == &s->listen_fd) {
+            gs_accept(s);
+        } else {
+            gs_serve(w, ev.data.ptr);
+        }
+    }
+    free(w->dist);
+    free(w->touched);
+    gk_heap_f32_free(&w->heap);
+    free(w);
+    return NULL;
+}
+
+// Bind a listening socket at `path`, replacing a stale socket file.
+// Returns NULL if the socket can't be created.
+gs_server* gs_server_new(const char* path, ht_hash_table* table, gk_f32_dir_graph* graph) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "%s: socket path too long\n", path);
+        return NULL;
+    }
+    strcpy(addr.sun_path, path);
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    unlink(path);
+    if (fd < 0 || bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0
+        || listen(fd, SOMAXCONN) < 0) {
+        perror(path);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    gs_server* s = xcalloc(1, sizeof(gs_server));
+    s->table = table;
+    s->graph = graph;
+    s->path = xstrdup(path);
+    s->listen_fd = fd;
+    s->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    s->wake_fd = eventfd(0, EFD_CLOEXEC);
+    pthread_mutex_init(&s->conns_lock, NULL);
+    struct epoll_event ev = {.events = EPOLLIN, .data.ptr = &s->listen_fd};
+    epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, s->listen_fd, &ev);
+    ev.data.ptr = &s->wake_fd;
+    epoll_ctl(s->epoll_fd, EPOLL_CTL_ADD, s->wake_fd, &ev);
+    return s;
+}
+
+void gs_server_start(gs_server* s, const int num_workers) {
+    s->num_workers = num_workers;
+    s->workers = xmalloc((size_t)num_workers * sizeof(pthread_t));
+    const int n = s->graph->csr.n;
+    for (int i = 0; i < num_workers; i++) {
+        gs_worker* w = xcalloc(1, sizeof(gs_worker));
+        w->s = s;
+        w->dist = xmalloc((size_t)(n > 0 ? n : 1) * sizeof(float));
+        for (int v = 0; v < n; v++) {
+            w->dist[v] = INFINITY;
+        }
+        w->touched = xmalloc((size_t)(n > 0 ? n : 1) * sizeof(int));
+        pthread_create(&s->workers[i], NULL, gs_worker_main, w);
+    }
+}
+
+// Wake every worker through the event fd, which is never read so it
+// stays ready, and wait for them to finish the connection in hand.
+void gs_server_stop(gs_server* s) {
+    if (s->workers == NULL) {
+        return;
+    }
+    const uint64_t one = 1;
+    if (write(s->wake_fd, &one, sizeof(one)) != sizeof(one)) {
+        perror("gs_server_stop");
+    }
+    for (int i = 0; i < s->num_workers; i++) {
+        pthread_join(s->workers[i], NULL);
+    }
+    free(s->workers);
+    s->workers = NULL;
+}
+
+void gs_server_del(gs_server* s) {
+    gs_server_stop(s);
+    while (s->conns != NULL) {
+        gs_close(s, s->conns);
+    }
+    close(s->listen_fd);
+    close(s->epoll_fd);
+    close(s->wake_fd);
+    unlink(s->path);
+    pthread_mutex_destroy(&s->conns_lock);
+    free(s->path);
+    free(s);
+}
+
+// Blocking client connection to the server at `path`, or -1.
+int gs_connect(const char* path) {
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0 && connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Encode a request into `buf`, which must have room for a header and
+// `GS_MAX_PAYLOAD` bytes. `other` may be NULL for single key requests.
+// Returns the number of bytes written, or 0 without writing anything
+// if either key is longer than `GS_MAX_KEY`, which the server would
+// refuse.
+size_t gs_put_request(char* buf, const uint32_t id, const int op, const char* key,
+                      const char* other) {
+    const size_t len = strlen(key);
+    const size_t other_len = other != NULL ? strlen(other) : 0;
+    if (len > GS_MAX_KEY || other_len > GS_MAX_KEY) {
+        return 0;
+    }
+    const uint16_t key_len = (uint16_t)len;
+    gs_header h = {(uint32_t)(sizeof(key_len) + key_len + other_len), id, (uint8_t)op, {0}};
+    memcpy(buf, &h, sizeof(h));
+    memcpy(buf + sizeof(h), &key_len, sizeof(key_len));
+    memcpy(buf + sizeof(h) + sizeof(key_len), key, key_len);
+    if (other_len > 0) {
+        memcpy(buf + sizeof(h) + sizeof(key_len) + key_len, other, other_len);
+    }
+    return sizeof(h) + h.len;
+}
@@ -0,0 +1,259 @@
+//
+//  graph_updates.c
+//  hash_table
+//
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "xmalloc.h"
+
+#include "graph_kernels.h"
+#include "graph_updates.h"
+
+// `gu_new` takes over `base`: its topology is shared by every version
+// and its weights become the first version. The queue holds
+// `queue_capacity` deltas, rounded up to a power of two.
+gu_graph* gu_new(gk_f32_dir_graph* base, const int queue_capacity) {
+    gu_graph* gu = xcalloc(1, sizeof(gu_graph));
+    size_t capacity = 2;
+    while (capacity < (size_t)queue_capacity) {
+        capacity <<= 1;
+    }
+    gu->queue = xmalloc(capacity * sizeof(gu_delta));
+    gu->queue_mask = capacity - 1;
+    for (size_t i = 0; i < capacity; i++) {
+        atomic_init(&gu->queue[i].seq, i);
+    }
+    atomic_init(&gu->queue_tail, 0);
+    gu->queue_head = 0;
+
+    gu->topology = base->csr;
+    gu_version* v = xcalloc(1, sizeof(gu_version));
+    v->g = *base;
+    free(base);
+    atomic_init(&gu->current, v);
+    atomic_init(&gu->epoch, 1);
+    for (int i = 0; i < GU_MAX_READERS; i++) {
+        atomic_init(&gu->readers[i].epoch, 0);
+    }
+    atomic_init(&gu->num_readers, 0);
+    atomic_init(&gu->running, 0);
+    gu->versions = 1;
+    return gu;
+}
+
+void gu_del(gu_graph* gu) {
+    gu_stop_applier(gu);
+    gu_version* v = atomic_load(&gu->current);
+    gk_free_csr(&gu->topology);
+    free(v->g.weights);
+    free(v);
+    while (gu->retired != NULL) {
+        gu_version* next = gu->retired->next_retired;
+        free(gu->retired->g.weights);
+        free(gu->retired);
+        gu->retired = next;
+    }
+    free(gu->queue);
+    free(gu);
+}
+
+// Enqueue:
+// A bounded multi-producer queue where every cell carries a sequence
+// number. A producer claims the cell at `queue_tail` once its sequence
+// shows the consumer has emptied it, then publishes the delta by
+// advancing the sequence. Returns 0, or -1 when the queue is full or
+// the weight is negative or NaN, which the searches can't handle.
+int gu_enqueue(gu_graph* gu, const int src, const int dst, const float weight) {
+    if (!(weight >= 0)) {
+        return -1;
+    }
+    size_t pos = atomic_load_explicit(&gu->queue_tail, memory_order_relaxed);
+    gu_delta* cell;
+    for (;;) {
+        cell = &gu->queue[pos & gu->queue_mask];
+        const size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        const intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&gu->queue_tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            return -1;
+        } else {
+            pos = atomic_load_explicit(&gu->queue_tail, memory_order_relaxed);
+        }
+    }
+    cell->src = src;
+    cell->dst = dst;
+    cell->weight = weight;
+    atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+    return 0;
+}
+
+// Resolve the keys once against the shared topology. Returns -1 if
+// either node is unknown or `gu_enqueue` refuses the delta.
+int gu_enqueue_keys(gu_graph* gu, const char* src, const char* dst, const float weight) {
+    const int u = gk_vertex(&gu->topology, src);
+    const int v = gk_vertex(&gu->topology, dst);
+    if (u < 0 || v < 0) {
+        return -1;
+    }
+    return gu_enqueue(gu, u, v, weight);
+}
+
+// Index of edge `src` -> `dst` by binary search of the sorted row.
+static int gu_find_edge(const gk_csr* csr, const int src, const int dst) {
+    if (src < 0 || src >= csr->n) {
+        return -1;
+    }
+    int lo = csr->offsets[src];
+    int hi = csr->offsets[src + 1] - 1;
+    while (lo <= hi) {
+        const int mid = lo + (hi - lo) / 2;
+        if (csr->targets[mid] == dst) {
+            return mid;
+        }
+        if (csr->targets[mid] < dst) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    return -1;
+}
+
+// Reclamation:
+// A retired version can still be in use by any reader that announced
+// an epoch older than the one it was retired at. Free those retired
+// before the oldest epoch still announced.
+static void gu_reclaim(gu_graph* gu) {
+    uint64_t oldest = atomic_load(&gu->epoch);
+    const int readers = atomic_load(&gu->num_readers);
+    for (int i = 0; i < readers; i++) {
+        const uint64_t e = atomic_load(&gu->readers[i].epoch);
+        if (e != 0 && e < oldest) {
+            oldest = e;
+        }
+    }
+    gu_version** link = &gu->retired;
+    while (*link != NULL) {
+        gu_version* v = *link;
+        if (v->retired_epoch <= oldest) {
+            *link = v->next_retired;
+            free(v->g.weights);
+            free(v);
+            gu->reclaimed++;
+        } else {
+            link = &v->next_retired;
+        }
+    }
+}
+
+// Apply:
+// Drain up to `max_batch` deltas into a copy of the current weights
+// and publish it as the new version. The old version is retired at the
+// epoch following the swap. Deltas for edges missing from the topology
+// are dropped. Only one thread may apply at a time. Returns the number
+// of deltas drained.
+int gu_apply(gu_graph* gu, const int max_batch) {
+    gu_version* old = atomic_load(&gu->current);
+    gu_version* v = NULL;
+    int drained = 0;
+    while (drained < max_batch) {
+        gu_delta* cell = &gu->queue[gu->queue_head & gu->queue_mask];
+        const size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        if (seq != gu->queue_head + 1) {
+            break;
+        }
+        const int src = cell->src;
+        const int dst = cell->dst;
+        const float weight = cell->weight;
+        atomic_store_explicit(&cell->seq, gu->queue_head + gu->queue_mask + 1,
+                              memory_order_release);
+        gu->queue_head++;
+        drained++;
+
+        const int e = gu_find_edge(&gu->topology, src, dst);
+        if (e < 0) {
+            gu->dropped++;
+            continue;
+        }
+        if (v == NULL) {
+            v = xcalloc(1, sizeof(gu_version));
+            v->g.csr = gu->topology;
+            v->g.weights = xmalloc((size_t)old->g.csr.m * sizeof(float));
+            memcpy(v->g.weights, old->g.weights, (size_t)old->g.csr.m * sizeof(float));
+        }
+        v->g.weights[e] = weight;
+        gu->applied++;
+    }
+    if (v != NULL) {
+        atomic_store(&gu->current, v);
+        old->retired_epoch = atomic_fetch_add(&gu->epoch, 1) + 1;
+        old->next_retired = gu->retired;
+        gu->retired = old;
+        gu->versions++;
+    }
+    gu_reclaim(gu);
+    return drained;
+}
+
+static void* gu_applier_loop(void* arg) {
+    gu_graph* gu = arg;
+    const struct timespec idle = {0, 100000};
+    while (atomic_load(&gu->running)) {
+        if (gu_apply(gu, gu->max_batch) == 0) {
+            nanosleep(&idle, NULL);
+        }
+    }
+    while (gu_apply(gu, gu->max_batch) > 0) {
+        // Drain what was queued before the stop
+    }
+    return NULL;
+}
+
+// Run `gu_apply` on a background thread until `gu_stop_applier`,
+// sleeping 0.1 ms whenever the queue is empty.
+void gu_start_applier(gu_graph* gu, const int max_batch) {
+    gu->max_batch = max_batch;
+    atomic_store(&gu->running, 1);
+    pthread_create(&gu->applier, NULL, gu_applier_loop, gu);
+}
+
+void gu_stop_applier(gu_graph* gu) {
+    if (atomic_exchange(&gu->running, 0)) {
+        pthread_join(gu->applier, NULL);
+    }
+}
+
+// Readers:
+// Each reading thread registers once for a slot. `gu_read_begin`
+// announces the current epoch before loading the version, so the
+// applier can't free it, and returns a graph which the existing
+// `gk_f32_dir_*` kernels run on unchanged until `gu_read_end`. Once
+// all `GU_MAX_READERS` slots are taken registering fails with -1, and
+// `num_readers` stays at the number of slots.
+int gu_register_reader(gu_graph* gu) {
+    int reader = atomic_load(&gu->num_readers);
+    while (reader < GU_MAX_READERS
+           && !atomic_compare_exchange_weak(&gu->num_readers, &reader, reader + 1)) {
+    }
+    return reader < GU_MAX_READERS ? reader : -1;
+}
+
+const gk_f32_dir_graph* gu_read_begin(gu_graph* gu, const int reader) {
+    atomic_store(&gu->readers[reader].epoch, atomic_load(&gu->epoch));
+    return &atomic_load(&gu->current)->g;
+}
+
+void gu_read_end(gu_graph* gu, const int reader) {
+    atomic_store_explicit(&gu->readers[reader].epoch, 0, memory_order_release);
+}
@@ -0,0 +1,80 @@
+//
+//  graphd.c
+//  hash_table
+//
+//  Query daemon: loads a graph and a table once and serves them over a
+//  Unix domain socket until interrupted.
+//
+//  usage: graphd -g graph.txt [-t table.txt] [-s socket] [-w workers]
+//
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "graph_elements.h"
+#include "graph_kernels.h"
+#include "graph_load.h"
+#include "graph_server.h"
+#include "hash_table.h"
+
+static void usage() {
+    fprintf(stderr, "usage: graphd -g graph.txt [-t table.txt] [-s socket] [-w workers]\n");
+    exit(2);
+}
+
+int main(int argc, char** argv) {
+    const char* graph_path = NULL;
+    const char* table_path = NULL;
+    const char* socket_path = "/tmp/graphd.sock";
+    int workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while ((opt = getopt(argc, argv, "g:t:s:w:")) != -1) {
+        switch (opt) {
+        case 'g': graph_path = optarg; break;
+        case 't': table_path = optarg; break;
+        case 's': socket_path = optarg; break;
+        case 'w': workers = atoi(optarg); break;
+        default: usage();
+        }
+    }
+    if (graph_path == NULL || workers < 1) {
+        usage();
+    }
+
+    graph* G = load_graph(graph_path);
+    ht_hash_table* table = table_path != NULL ? load_table(table_path) : ht_new();
+    if (G == NULL || table == NULL) {
+        return 1;
+    }
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    if (g == NULL) {
+        return 1;
+    }
+
+    // Block the stop signals in every thread and wait for them here
+    sigset_t stop;
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop, NULL);
+
+    gs_server* s = gs_server_new(socket_path, table, g);
+    if (s == NULL) {
+        return 1;
+    }
+    gs_server_start(s, workers);
+    printf("graphd: %d nodes, %d edges, %d keys on %s with %d workers\n", g->csr.n, g->csr.m,
+           table->count, socket_path, workers);
+    fflush(stdout);
+    int sig;
+    sigwait(&stop, &sig);
+
+    gs_server_del(s);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    ht_del_hash_table(table);
+    return 0;
+}
@@ -10,6 +10,7 @@
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #include "xmalloc.h"
 
@@ -17,24 +18,106 @@
 #include "prime.h"
 
 // HT_DELETED_ITEM is used to mark a bucket containing a deleted item
-static ht_item HT_DELETED_ITEM = {NULL, NULL};
+static ht_item HT_DELETED_ITEM = {.key = NULL, .value = NULL};
+
+// Whether a non-NULL bucket holds the deleted marker, for code walking
+// `items` from outside.
+int ht_is_deleted(const ht_item* item) {
+    return item == &HT_DELETED_ITEM;
+}
 
 // HT_PRIMEs are parameters in the hashing algorithm
 static const int HT_PRIME_1 = 151;
 static const int HT_PRIME_2 = 163;
 static const int HT_INITIAL_BASE_SIZE = 0;
 
+// Short string storage. `HT_COPY` stores `s` inline when it fits and
+// `HT_ON_HEAP` tells whether an item's string needs a separate `free`.
+#if HT_INLINE_LEN > 0
+static char* ht_copy_string(char* inline_buf, const char* s, const size_t len) {
+    if (len < HT_INLINE_LEN) {
+        memcpy(inline_buf, s, len + 1);
+        return inline_buf;
+    }
+    return xstrdup(s);
+}
+#define HT_COPY(item, field, s, len) ht_copy_string((item)->inline_##field, s, len)
+#define HT_ON_HEAP(item, field) ((item)->field != (item)->inline_##field)
+#else
+#define HT_COPY(item, field, s, len) xstrdup(s)
+#define HT_ON_HEAP(item, field) 1
+#endif
+
+static unsigned char ht_len_byte(const size_t len) {
+    return len < HT_LEN_SATURATED ? (unsigned char)len : HT_LEN_SATURATED;
+}
+
+// Compare a stored key against `key` of length `len`, rejecting on
+// the length byte before touching the string.
+static int ht_key_equals(const ht_item* item, const char* key, const size_t len) {
+    return item->key_len == ht_len_byte(len) && strcmp(item->key, key) == 0;
+}
+
+// Bytes allocated for an item and its strings.
+static long ht_item_bytes(const ht_item* i) {
+    long bytes = sizeof(ht_item);
+    if (HT_ON_HEAP(i, key)) {
+        bytes += strlen(i->key) + 1;
+    }
+    if (HT_ON_HEAP(i, value)) {
+        bytes += strlen(i->value) + 1;
+    }
+    return bytes;
+}
+
+static uint64_t ht_now_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+// Instrumentation hooks. With `HT_STATS` undefined they expand to
+// nothing, so the default build carries no bookkeeping at all.
+#ifdef HT_STATS
+#define HT_STAT(stmt) do { stmt; } while (0)
+
+static void ht_stats_alloc(ht_hash_table* ht, const long bytes) {
+    ht->stats.bytes += bytes;
+    if (ht->stats.bytes > ht->stats.peak_bytes) {
+        ht->stats.peak_bytes = ht->stats.bytes;
+    }
+}
+
+static void ht_stats_probe(unsigned long* hist, const int probes) {
+    const int bin = probes < HT_STATS_PROBE_BINS ? probes : HT_STATS_PROBE_BINS;
+    hist[bin - 1]++;
+}
+
+static unsigned long ht_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+#else
+#define HT_STAT(stmt) do { } while (0)
+#endif
+
 // Define initialization functions for `ht_item`s.
 // This function allocates a chunk of memory the size
 // of an `ht_item`, and saves a copy of the strings
-// `k` and `v` in the new chunk of memory. The
+// `k` and `v` in the new chunk of memory, inline when
+// they are short and on the heap otherwise. The
 // function is marked as `static` because it will
 // only ever be called by code internal to the
 // hash table.
 static ht_item* ht_new_item(const char* k, const char* v) {
-    ht_item* i = malloc(sizeof(ht_item));
-    i->key = strdup(k);
-    i->value = strdup(v);
+    ht_item* i = xmalloc(sizeof(ht_item));
+    const size_t key_len = strlen(k);
+    const size_t value_len = strlen(v);
+    i->key_len = ht_len_byte(key_len);
+    i->value_len = ht_len_byte(value_len);
+    i->key = HT_COPY(i, key, k, key_len);
+    i->value = HT_COPY(i, value, v, value_len);
     return i;
 }
 
@@ -45,6 +128,9 @@ static ht_item* ht_new_item(const char* k, const char* v) {
 // of items with `calloc`, which fills the allocated
 // memory with `NULL` bytes. A `NULL` entry in the
 // array indicates that the bucket is empty.
+// Arrays of 2 MB or more come from `xcalloc_large`
+// instead, as their own mapping on huge pages,
+// zeroed by the kernel as they are first touched.
 // Support creating a hash table of a certain size. To do this,
 // `ht_new_sized` is called by `ht_new`.
 static ht_hash_table* ht_new_sized(const int size_index) {
@@ -55,7 +141,12 @@ static ht_hash_table* ht_new_sized(const int size_index) {
     ht->size = next_prime(base_size);
     
     ht->count = 0;
-    ht->items = xcalloc((size_t)ht->size, sizeof(ht_item*));
+    ht->deleted = 0;
+    ht->items = xcalloc_large((size_t)ht->size, sizeof(ht_item*));
+    ht->filter = NULL;
+    ht->cache = NULL;
+    HT_STAT(memset(&ht->stats, 0, sizeof(ht_stats)));
+    HT_STAT(ht_stats_alloc(ht, sizeof(ht_hash_table) + ht->size * sizeof(ht_item*)));
     return ht;
 }
 
@@ -63,30 +154,93 @@ ht_hash_table* ht_new() {
     return ht_new_sized(HT_INITIAL_BASE_SIZE);
 }
 
+// A table presized to hold `count` items without resizing up, for
+// callers that know how much they are about to insert.
+ht_hash_table* ht_new_capacity(const int count) {
+    int size_index = HT_INITIAL_BASE_SIZE;
+    while ((long)count * 100 > (long)next_prime(50 << size_index) * 70) {
+        size_index++;
+    }
+    return ht_new_sized(size_index);
+}
+
+// Place an item whose key is known not to be in the table yet into
+// the first empty bucket along its probe sequence, returning the
+// bucket.
+static int ht_place_item(ht_hash_table* ht, ht_item* item) {
+    int index;
+    int step;
+    ht_probe_start(item->key, ht->size, &index, &step);
+    while (ht->items[index] != NULL) {
+        index = ht_probe_next(index, step, ht->size);
+    }
+    ht->items[index] = item;
+    ht->count++;
+    return index;
+}
+
+#ifdef HT_STATS
+// Bytes of cache metadata per bucket.
+static size_t ht_cache_slot_bytes(const ht_cache* c) {
+    return sizeof(unsigned char) + (c->expires != NULL ? sizeof(uint64_t) : 0);
+}
+#endif
+
 // Resize:
 // Ensure size of hash table is not being resized below its minimum.
 // Initialize new hash table with desired size. All non-`NULL` or
-// deleted items are inserted into the new hash table. Then swap
-// attributes of the new and old hash tables before deleting the latter.
+// deleted items are moved into the new hash table, without copying
+// their strings. Then swap attributes of the new and old hash tables
+// before freeing the latter's bucket array. Cache metadata moves with
+// each item. A `direction` of 0 rehashes at the same size, which only
+// clears out tombstones.
 static void ht_resize(ht_hash_table* ht, const int direction) {
     const int new_size_index = ht->size_index + direction;
     if (new_size_index < HT_INITIAL_BASE_SIZE) {
         // Don't resize down the smallest hash table
         return;
     }
+#ifdef HT_STATS
+    const unsigned long start_ns = ht_now_ns();
+#endif
     // Create a temporary new hash table to insert items into
     ht_hash_table* new_ht = ht_new_sized(new_size_index);
+    ht_cache* cache = ht->cache;
+    unsigned char* meta = NULL;
+    uint64_t* expires = NULL;
+    if (cache != NULL) {
+        meta = xcalloc((size_t)new_ht->size, sizeof(unsigned char));
+        if (cache->expires != NULL) {
+            expires = xcalloc((size_t)new_ht->size, sizeof(uint64_t));
+        }
+    }
     // Iterate through existing hash table, add all items to new
     for (int i = 0; i < ht->size; i++) {
         ht_item* item = ht->items[i];
         if (item != NULL && item != &HT_DELETED_ITEM) {
-            ht_insert(new_ht, item->key, item->value);
+            const int index = ht_place_item(new_ht, item);
+            if (meta != NULL) {
+                meta[index] = cache->meta[i];
+            }
+            if (expires != NULL) {
+                expires[index] = cache->expires[i];
+            }
         }
     }
-    
+    if (cache != NULL) {
+        HT_STAT(ht_stats_alloc(ht, new_ht->size * ht_cache_slot_bytes(cache)));
+        HT_STAT(ht->stats.bytes -= ht->size * ht_cache_slot_bytes(cache));
+        free(cache->meta);
+        free(cache->expires);
+        cache->meta = meta;
+        cache->expires = expires;
+        cache->hand = 0;
+    }
+
     // Pass new_ht and ht's properties. Delete new_ht
     ht->size_index = new_ht->size_index;
     ht->count = new_ht->count;
+    ht->deleted = 0;
     
     // To delete new_ht, we give it ht's size and items
     const int tmp_size = ht->size;
@@ -96,8 +250,22 @@ static void ht_resize(ht_hash_table* ht, const int direction) {
     ht_item** tmp_items = ht->items;
     ht->items = new_ht->items;
     new_ht->items = tmp_items;
-    
-    ht_del_hash_table(new_ht);
+
+    // Items moved over, so only the bucket arrays differ. Both are
+    // live until the old one is freed, which is the peak.
+    HT_STAT(ht_stats_alloc(ht, ht->size * sizeof(ht_item*)));
+    HT_STAT(ht->stats.bytes -= new_ht->size * sizeof(ht_item*));
+    HT_STAT(ht->stats.resizes++; ht->stats.resize_ns += ht_now_ns() - start_ns);
+
+    // The items now belong to `ht`, so free only the old buckets
+    xfree_large(new_ht->items, (size_t)new_ht->size, sizeof(ht_item*));
+    free(new_ht);
+
+    // Deleted keys are dropped from the filter as it is rebuilt for
+    // the new size
+    if (ht->filter != NULL) {
+        ht_enable_filter(ht, ht->filter->bits_per_key);
+    }
 }
 
 // Resizing up and down
@@ -112,11 +280,29 @@ static void ht_resize_down(ht_hash_table* ht) {
 // which `free` the memory allocated, preventing
 // memory leaks.
 static void ht_del_item(ht_item* i) {
-    free(i->key);
-    free(i->value);
+    if (HT_ON_HEAP(i, key)) {
+        free(i->key);
+    }
+    if (HT_ON_HEAP(i, value)) {
+        free(i->value);
+    }
     free(i);
 }
 
+// Replace the item in bucket `index` by a tombstone.
+static void ht_remove_at(ht_hash_table* ht, const int index) {
+    ht_item* item = ht->items[index];
+    HT_STAT(ht->stats.bytes -= ht_item_bytes(item));
+    if (ht->cache != NULL) {
+        ht->cache->bytes -= ht_item_bytes(item);
+        ht->cache->meta[index] = 0;
+    }
+    ht_del_item(item);
+    ht->items[index] = &HT_DELETED_ITEM;
+    ht->count--;
+    ht->deleted++;
+}
+
 void ht_del_hash_table(ht_hash_table* ht) {
     for (int i = 0; i < ht->size; i++) {
         ht_item* item = ht->items[i];
@@ -124,10 +310,45 @@ void ht_del_hash_table(ht_hash_table* ht) {
             ht_del_item(item);
         }
     }
-    free(ht->items);
+    if (ht->filter != NULL) {
+        ht_filter_del(ht->filter);
+    }
+    if (ht->cache != NULL) {
+        free(ht->cache->meta);
+        free(ht->cache->expires);
+        free(ht->cache);
+    }
+    xfree_large(ht->items, (size_t)ht->size, sizeof(ht_item*));
     free(ht);
 }
 
+// Membership filter:
+// Sized for the most keys the table holds before its next resize, at
+// `bits_per_key` bits each, and filled with every key present. Inserts
+// add to it and resizes rebuild it. Deletes leave their keys in it, so
+// they only cost false positives until the next resize. Enabling an
+// enabled filter rebuilds it.
+void ht_enable_filter(ht_hash_table* ht, const int bits_per_key) {
+    ht_disable_filter(ht);
+    const int capacity = ht->size * 7 / 10 + 1;
+    ht->filter = ht_filter_new(ht->count > capacity ? ht->count : capacity, bits_per_key);
+    HT_STAT(ht_stats_alloc(ht, ht_filter_bytes(ht->filter)));
+    for (int i = 0; i < ht->size; i++) {
+        ht_item* item = ht->items[i];
+        if (item != NULL && item != &HT_DELETED_ITEM) {
+            ht_filter_add(ht->filter, ht_hash64(item->key));
+        }
+    }
+}
+
+void ht_disable_filter(ht_hash_table* ht) {
+    if (ht->filter != NULL) {
+        HT_STAT(ht->stats.bytes -= ht_filter_bytes(ht->filter));
+        ht_filter_del(ht->filter);
+        ht->filter = NULL;
+    }
+}
+
 // Implementation of a hash function.
 // Takes a string as input and returns a number between
 // `0` and `m`, the desired bucket array length.
@@ -137,15 +358,19 @@ void ht_del_hash_table(ht_hash_table* ht) {
 // buckets than others which leads to a higher rate of
 // collisions, thereby reducing the efficiency of the
 // hash table.
-static int ht_generic_hash(const char* s, const int a, const int m) {
-    long hash = 0;
-    const int len_s = strlen(s);
-    for (int i = 0; i < len_s; i++) {
-        /* Map char to a large integer */
-        hash += (long)pow(a, len_s - (i+1)) * s[i];
-        hash = hash % m;
+// Both hashes of the double hashing scheme below are computed in
+// the same pass over the string.
+static void ht_generic_hash(const char* s, const int m, long* hash_a, long* hash_b) {
+    long a = 0;
+    long b = 0;
+    for (; *s; s++) {
+        /* Horner's rule keeps every step below `HT_PRIME * m`, where
+         * `pow(a, len_s - (i+1))` overflowed for keys of 10+ chars */
+        a = (a * HT_PRIME_1 + (unsigned char)*s) % m;
+        b = (b * HT_PRIME_2 + (unsigned char)*s) % m;
     }
-    return (int)hash;
+    *hash_a = a;
+    *hash_b = b;
 }
 
 // Handling collisions.
@@ -156,10 +381,112 @@ static int ht_generic_hash(const char* s, const int a, const int m) {
 // Here, open addressing with double hashing makes
 // use of two hash functions to calculate the index an
 // item should be stored at after `i` collisions.
-static int ht_hash(const char* s, const int num_buckets, const int attempt) {
-    const int hash_a = ht_generic_hash(s, HT_PRIME_1, num_buckets);
-    const int hash_b = ht_generic_hash(s, HT_PRIME_2, num_buckets);
-    return (hash_a + (attempt * (hash_b + 1))) % num_buckets;
+// The graph tables probe with the same sequence. Callers hash a key
+// once with `ht_probe_start` and then step along with `ht_probe_next`.
+// The step must never be a multiple of `num_buckets`, or the probe
+// sequence would revisit the same bucket forever.
+void ht_probe_start(const char* s, const int num_buckets, int* index, int* step) {
+    long hash_a;
+    long hash_b;
+    ht_generic_hash(s, num_buckets, &hash_a, &hash_b);
+    *index = (int)hash_a;
+    *step = (int)(hash_b % (num_buckets - 1) + 1);
+}
+
+// Bucket index after `attempt` collisions, for callers that probe one
+// attempt at a time.
+int ht_hash(const char* s, const int num_buckets, const int attempt) {
+    int index;
+    int step;
+    ht_probe_start(s, num_buckets, &index, &step);
+    return (int)((index + (long)attempt * step) % num_buckets);
+}
+
+// Full-width hash:
+// `ht_hash` only yields bucket indexes for one table size. Layers built
+// on top of the table (sharding, filters) need bits that don't depend on
+// it, so this is 64-bit FNV-1a followed by a finalizer that spreads the
+// entropy of the low bits into the top ones.
+uint64_t ht_hash64(const char* s) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (; *s; s++) {
+        hash ^= (unsigned char)*s;
+        hash *= 1099511628211ULL;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Cache mode:
+// Every bucket gets a metadata byte with two bits of CLOCK state, and
+// optionally an expiry time. A hit sets `HT_CACHE_REF`. The hand sweeps
+// the bucket array as a clock: a referenced item is promoted to hot
+// with its reference cleared, a hot item that has not been referenced
+// since is demoted, and an item that is neither is evicted. A new item
+// therefore starts cold and is evicted on the hand's next pass unless
+// it is hit again, while items with repeated hits need two quiet passes
+// to go. One sequential scan of new keys cannot flush the hot set.
+// Each eviction leaves a tombstone, which inserts reuse or compact away.
+void ht_enable_cache(ht_hash_table* ht, const size_t max_entries, const size_t max_bytes) {
+    if (ht->cache == NULL) {
+        ht_cache* c = xcalloc(1, sizeof(ht_cache));
+        c->meta = xcalloc((size_t)ht->size, sizeof(unsigned char));
+        for (int i = 0; i < ht->size; i++) {
+            ht_item* item = ht->items[i];
+            if (item != NULL && item != &HT_DELETED_ITEM) {
+                c->bytes += ht_item_bytes(item);
+            }
+        }
+        HT_STAT(ht_stats_alloc(ht, ht->size * ht_cache_slot_bytes(c)));
+        ht->cache = c;
+    }
+    ht->cache->max_entries = max_entries;
+    ht->cache->max_bytes = max_bytes;
+}
+
+static int ht_cache_expired(const ht_cache* c, const int index) {
+    return c->expires != NULL && c->expires[index] != 0 && c->expires[index] <= ht_now_ms();
+}
+
+static int ht_cache_over_budget(const ht_hash_table* ht) {
+    const ht_cache* c = ht->cache;
+    return (c->max_entries > 0 && (size_t)ht->count > c->max_entries)
+           || (c->max_bytes > 0 && c->bytes > c->max_bytes);
+}
+
+// Advance the hand until one item other than the one in bucket `keep`
+// has been removed. Every item is passed at most three times: referenced,
+// hot, then cold.
+static void ht_cache_evict(ht_hash_table* ht, const int keep) {
+    ht_cache* c = ht->cache;
+    if (ht->count <= 1) {
+        return;
+    }
+    for (;;) {
+        const int index = c->hand;
+        c->hand = c->hand + 1 < ht->size ? c->hand + 1 : 0;
+        ht_item* item = ht->items[index];
+        if (item == NULL || item == &HT_DELETED_ITEM || index == keep) {
+            continue;
+        }
+        if (ht_cache_expired(c, index)) {
+            ht_remove_at(ht, index);
+            c->expirations++;
+            return;
+        }
+        unsigned char* m = &c->meta[index];
+        if (*m & HT_CACHE_REF) {
+            *m = HT_CACHE_HOT;
+        } else if (*m & HT_CACHE_HOT) {
+            *m = 0;
+        } else {
+            ht_remove_at(ht, index);
+            c->evictions++;
+            return;
+        }
+    }
 }
 
 // Insertion of a new key-value pair:
@@ -175,29 +502,95 @@ static int ht_hash(const char* s, const int num_buckets, const int attempt) {
 // inaccessible. To handle this, the previous item can be deleted
 // and the new item inserted in its place.
 // To perform resizing, check load on hash table during inserts and deletes.
-void ht_insert(ht_hash_table* ht, const char* key, const char* value) {
+// Tombstones count towards the load too: once live items and tombstones
+// fill 70% of the buckets the table is rehashed, so that insert/delete
+// churn cannot leave probes without an empty bucket to stop at. It is
+// rehashed at its current size only when tombstones are at least a
+// quarter of the buckets. Otherwise live items alone are close to the
+// threshold, and a same-size rehash would leave so little room that
+// the next few tombstones, such as a full cache's evictions, trigger
+// another one. The table grows instead, so every rehash is paid for by
+// at least a quarter of the buckets' worth of inserts.
+static void ht_insert_item(ht_hash_table* ht, const char* key, const char* value,
+                           const uint32_t ttl_ms) {
     const int load = ht->count * 100 / ht->size;
-    if (load > 70) {
+    const int used = (ht->count + ht->deleted) * 100 / ht->size;
+    if (load > 70 || (used > 70 && load > 45)) {
         ht_resize_up(ht);
+    } else if (used > 70) {
+        ht_resize(ht, 0);
     }
     ht_item* item = ht_new_item(key, value);
-    int index = ht_hash(item->key, ht->size, 0);
+    HT_STAT(ht_stats_alloc(ht, ht_item_bytes(item)));
+    const size_t key_len = strlen(key);
+    int index;
+    int step;
+    ht_probe_start(item->key, ht->size, &index, &step);
     ht_item* cur_item = ht->items[index];
+    int free_index = -1;
     int i = 1;
+    long replaced_bytes = -1;
     while(cur_item != NULL) {
-        if (cur_item != &HT_DELETED_ITEM) {
-            if (strcmp(cur_item->key, key) == 0) {
-                ht_del_item(cur_item);
-                ht->items[index] = item;
-                return;
+        if (cur_item == &HT_DELETED_ITEM) {
+            if (free_index < 0) {
+                free_index = index;
             }
+        } else if (ht_key_equals(cur_item, key, key_len)) {
+            replaced_bytes = ht_item_bytes(cur_item);
+            HT_STAT(ht->stats.bytes -= replaced_bytes);
+            ht_del_item(cur_item);
+            break;
         }
-        index = ht_hash(item->key, ht->size, i);
+        index = ht_probe_next(index, step, ht->size);
         cur_item = ht->items[index];
         i++;
     }
+    HT_STAT(ht_stats_probe(ht->stats.insert_probes, i));
+    if (replaced_bytes < 0) {
+        if (free_index >= 0) {
+            index = free_index;
+            ht->deleted--;
+        }
+        ht->count++;
+        if (ht->filter != NULL) {
+            ht_filter_add(ht->filter, ht_hash64(key));
+        }
+    }
     ht->items[index] = item;
-    ht->count++;
+
+    ht_cache* c = ht->cache;
+    if (c == NULL) {
+        return;
+    }
+    c->bytes += ht_item_bytes(item);
+    if (replaced_bytes < 0) {
+        c->meta[index] = 0;
+    } else {
+        c->bytes -= replaced_bytes;
+        c->meta[index] |= HT_CACHE_REF;
+    }
+    if (ttl_ms > 0 && c->expires == NULL) {
+        HT_STAT(ht_stats_alloc(ht, ht->size * sizeof(uint64_t)));
+        c->expires = xcalloc((size_t)ht->size, sizeof(uint64_t));
+    }
+    if (c->expires != NULL) {
+        c->expires[index] = ttl_ms > 0 ? ht_now_ms() + ttl_ms : 0;
+    }
+    while (ht_cache_over_budget(ht) && ht->count > 1) {
+        ht_cache_evict(ht, index);
+    }
+}
+
+void ht_insert(ht_hash_table* ht, const char* key, const char* value) {
+    ht_insert_item(ht, key, value, 0);
+}
+
+// Insert an item that expires `ttl_ms` milliseconds from now. Expired
+// items are dropped when searched for or passed by the eviction hand.
+// Without cache mode the TTL is ignored.
+void ht_insert_ttl(ht_hash_table* ht, const char* key, const char* value,
+                   const uint32_t ttl_ms) {
+    ht_insert_item(ht, key, value, ht->cache != NULL ? ttl_ms : 0);
 }
 
 // Searching for keys:
@@ -205,20 +598,51 @@ void ht_insert(ht_hash_table* ht, const char* key, const char* value) {
 // the key of interest and return the value if found. If the `while` loop
 // reaches a `NULL` value then return `NULL` indicating that the item
 // was not found. Ignore and jump over item marked as deleted.
+// A key the filter has never seen is known to be absent without
+// probing at all.
+// In cache mode a search updates the item's CLOCK state and the hit
+// counters, so it is no longer a read-only operation.
 char* ht_search(ht_hash_table* ht, const char* key) {
-    int index = ht_hash(key, ht->size, 0);
+    ht_cache* c = ht->cache;
+    if (ht->filter != NULL && !ht_filter_may_contain(ht->filter, ht_hash64(key))) {
+        HT_STAT(ht->stats.filter_rejects++);
+        if (c != NULL) {
+            c->misses++;
+        }
+        return NULL;
+    }
+    const size_t key_len = strlen(key);
+    int index;
+    int step;
+    ht_probe_start(key, ht->size, &index, &step);
     ht_item* item = ht->items[index];
     int i = 1;
     while (item != NULL) {
         if (item != &HT_DELETED_ITEM) {
-            if (strcmp(item->key, key) == 0) {
+            if (ht_key_equals(item, key, key_len)) {
+                HT_STAT(ht_stats_probe(ht->stats.search_probes, i));
+                if (c == NULL) {
+                    return item->value;
+                }
+                if (ht_cache_expired(c, index)) {
+                    ht_remove_at(ht, index);
+                    c->expirations++;
+                    c->misses++;
+                    return NULL;
+                }
+                c->meta[index] |= HT_CACHE_REF;
+                c->hits++;
                 return item->value;
             }
         }
-        index = ht_hash(key, ht->size, i);
+        index = ht_probe_next(index, step, ht->size);
         item = ht->items[index];
         i++;
     }
+    HT_STAT(ht_stats_probe(ht->stats.search_probes, i));
+    if (c != NULL) {
+        c->misses++;
+    }
     return NULL;
 }
 
@@ -228,24 +652,69 @@ char* ht_search(ht_hash_table* ht, const char* key) {
 // Instead of deleting, the item is marekd as deleted by replacing it with
 // a pointer to a global sentinel item which represents that a bucket
 // contains a deleted item. After deleting, the hash table `count` value
-// is decremented.
+// is decremented. Deleted buckets are jumped over rather than ending
+// the search, as the key may sit further along the chain.
 // To perform resizing, check load on hash table during inserts and deletes.
 void ht_delete(ht_hash_table* ht, const char* key) {
     const int load = ht->count * 100 / ht->size;
     if (load < 10) {
         ht_resize_down(ht);
     }
-    int index = ht_hash(key, ht->size, 0);
+    if (ht->filter != NULL && !ht_filter_may_contain(ht->filter, ht_hash64(key))) {
+        return;
+    }
+    const size_t key_len = strlen(key);
+    int index;
+    int step;
+    ht_probe_start(key, ht->size, &index, &step);
     ht_item* item = ht->items[index];
-    int i = 1;
-    while (item != NULL && item != &HT_DELETED_ITEM) {
-        if (strcmp(item->key, key) == 0) {
-            ht_del_item(item);
-            ht->items[index] = &HT_DELETED_ITEM;
+    while (item != NULL) {
+        if (item != &HT_DELETED_ITEM) {
+            if (ht_key_equals(item, key, key_len)) {
+                ht_remove_at(ht, index);
+                return;
+            }
         }
-        index = ht_hash(key, ht->size, i);
+        index = ht_probe_next(index, step, ht->size);
         item = ht->items[index];
-        i++;
     }
-    ht->count--;
+}
+
+// Statistics:
+// Emit the table's shape and, when compiled with `HT_STATS`, the probe
+// histograms, resize counters and memory accounting.
+void ht_stats_dump(ht_hash_table* ht, FILE* out) {
+    fprintf(out, "size %d count %d tombstones %d load %d%%\n",
+            ht->size, ht->count, ht->deleted, ht->count * 100 / ht->size);
+    if (ht->filter != NULL) {
+        fprintf(out, "filter %zu bytes, %d bits/key\n", ht_filter_bytes(ht->filter),
+                ht->filter->bits_per_key);
+    }
+    const ht_cache* c = ht->cache;
+    if (c != NULL) {
+        fprintf(out, "cache %zu bytes, hits %lu misses %lu evictions %lu expirations %lu\n",
+                c->bytes, c->hits, c->misses, c->evictions, c->expirations);
+    }
+#ifdef HT_STATS
+    const ht_stats* st = &ht->stats;
+    fprintf(out, "bytes %lu peak %lu\n", st->bytes, st->peak_bytes);
+    fprintf(out, "resizes %lu total %.3f ms\n", st->resizes, st->resize_ns / 1e6);
+    fprintf(out, "filter rejects %lu\n", st->filter_rejects);
+    const char* names[] = {"search", "insert"};
+    const unsigned long* hists[] = {st->search_probes, st->insert_probes};
+    for (int h = 0; h < 2; h++) {
+        unsigned long ops = 0;
+        unsigned long probes = 0;
+        for (int b = 0; b < HT_STATS_PROBE_BINS; b++) {
+            ops += hists[h][b];
+            probes += hists[h][b] * (b + 1);
+        }
+        fprintf(out, "%s probes: ops %lu mean %.2f |", names[h], ops,
+                ops ? (double)probes / ops : 0.0);
+        for (int b = 0; b < HT_STATS_PROBE_BINS; b++) {
+            fprintf(out, " %lu", hists[h][b]);
+        }
+        fprintf(out, "\n");
+    }
+#endif
 }
@@ -0,0 +1,66 @@
+//
+//  ht_filter.c
+//  hash_table
+//
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "xmalloc.h"
+
+#include "ht_filter.h"
+
+// Odd multipliers, one per word, that spread the low half of the hash
+// into 8 independent bit positions.
+static const uint32_t HT_FILTER_SALT[HT_FILTER_WORDS] = {
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U};
+
+// `bits_per_key` bits for every one of `num_keys` keys, rounded up to
+// whole blocks.
+ht_filter* ht_filter_new(const size_t num_keys, const int bits_per_key) {
+    ht_filter* f = xmalloc(sizeof(ht_filter));
+    const size_t bits = num_keys * (size_t)bits_per_key;
+    const size_t block_bits = 32 * HT_FILTER_WORDS;
+    f->num_blocks = (uint32_t)((bits + block_bits - 1) / block_bits);
+    if (f->num_blocks == 0) {
+        f->num_blocks = 1;
+    }
+    f->bits_per_key = bits_per_key;
+    f->words = xcalloc((size_t)f->num_blocks * HT_FILTER_WORDS, sizeof(uint32_t));
+    return f;
+}
+
+void ht_filter_del(ht_filter* f) {
+    free(f->words);
+    free(f);
+}
+
+// The high half of the hash picks the block, by multiply and shift
+// rather than modulo, and the low half the bits within it.
+static uint32_t* ht_filter_block(const ht_filter* f, const uint64_t hash) {
+    const uint32_t block = (uint32_t)(((hash >> 32) * f->num_blocks) >> 32);
+    return f->words + (size_t)block * HT_FILTER_WORDS;
+}
+
+void ht_filter_add(ht_filter* f, const uint64_t hash) {
+    uint32_t* block = ht_filter_block(f, hash);
+    const uint32_t key = (uint32_t)hash;
+    for (int i = 0; i < HT_FILTER_WORDS; i++) {
+        block[i] |= 1U << ((key * HT_FILTER_SALT[i]) >> 27);
+    }
+}
+
+int ht_filter_may_contain(const ht_filter* f, const uint64_t hash) {
+    const uint32_t* block = ht_filter_block(f, hash);
+    const uint32_t key = (uint32_t)hash;
+    uint32_t missing = 0;
+    for (int i = 0; i < HT_FILTER_WORDS; i++) {
+        missing |= ~block[i] & (1U << ((key * HT_FILTER_SALT[i]) >> 27));
+    }
+    return missing == 0;
+}
+
+size_t ht_filter_bytes(const ht_filter* f) {
+    return (size_t)f->num_blocks * HT_FILTER_WORDS * sizeof(uint32_t);
+}
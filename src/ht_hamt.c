@@ -0,0 +1,374 @@
+//
+//  ht_hamt.c
+//  hash_table
+//
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xmalloc.h"
+
+#include "hash_table.h"
+#include "ht_hamt.h"
+
+#define HT_HAMT_MASK (HT_HAMT_FANOUT - 1)
+#define HT_HAMT_HASH_BITS 64
+
+// Slot tagging. Allocations are at least 8-byte aligned, which leaves
+// the low bit of a pointer free to mark leaves.
+#define HT_HAMT_IS_LEAF(slot) (((uintptr_t)(slot)) & 1)
+#define HT_HAMT_LEAF(slot) ((ht_hamt_leaf*)((uintptr_t)(slot) & ~(uintptr_t)1))
+#define HT_HAMT_TAG(leaf) ((void*)((uintptr_t)(leaf) | 1))
+
+static uint64_t ht_hamt_hash(const char* key) {
+    return ht_hash64(key) & HT_HAMT_HASH_MASK;
+}
+
+// Position of the slot for `bit` in the packed array of a node. Built
+// with `-mpopcnt` this is one instruction. Otherwise gcc calls out to
+// libgcc for `__builtin_popcount`, so the bits are summed in place.
+static int ht_hamt_pos(const uint32_t bitmap, const uint32_t bit) {
+#ifdef __POPCNT__
+    return __builtin_popcount(bitmap & (bit - 1));
+#else
+    uint32_t x = bitmap & (bit - 1);
+    x = x - ((x >> 1) & 0x55555555u);
+    x = (x & 0x33333333u) + ((x >> 2) & 0x33333333u);
+    x = (x + (x >> 4)) & 0x0f0f0f0fu;
+    return (int)((x * 0x01010101u) >> 24);
+#endif
+}
+
+static ht_hamt_leaf* ht_hamt_new_leaf(const char* key, const char* value, const uint64_t hash) {
+    const size_t key_len = strlen(key);
+    const size_t value_len = strlen(value);
+    ht_hamt_leaf* leaf = xmalloc(sizeof(ht_hamt_leaf) + key_len + value_len + 2);
+    atomic_init(&leaf->refs, 1);
+    leaf->hash = hash;
+    memcpy(leaf->key, key, key_len + 1);
+    leaf->value = leaf->key + key_len + 1;
+    memcpy(leaf->value, value, value_len + 1);
+    return leaf;
+}
+
+static ht_hamt_node* ht_hamt_new_node(const int count) {
+    ht_hamt_node* node = xmalloc(sizeof(ht_hamt_node) + count * sizeof(void*));
+    atomic_init(&node->refs, 1);
+    node->bitmap = 0;
+    node->count = count;
+    return node;
+}
+
+static void ht_hamt_retain(void* slot) {
+    atomic_int* refs = HT_HAMT_IS_LEAF(slot) ? &HT_HAMT_LEAF(slot)->refs
+                                             : &((ht_hamt_node*)slot)->refs;
+    atomic_fetch_add_explicit(refs, 1, memory_order_relaxed);
+}
+
+// Drop a reference to a slot, freeing it and whatever only it held
+// once the last one is gone.
+static void ht_hamt_release(void* slot) {
+    if (HT_HAMT_IS_LEAF(slot)) {
+        ht_hamt_leaf* leaf = HT_HAMT_LEAF(slot);
+        if (atomic_fetch_sub_explicit(&leaf->refs, 1, memory_order_acq_rel) == 1) {
+            free(leaf);
+        }
+        return;
+    }
+    ht_hamt_node* node = slot;
+    if (atomic_fetch_sub_explicit(&node->refs, 1, memory_order_acq_rel) == 1) {
+        for (int i = 0; i < node->count; i++) {
+            ht_hamt_release(node->slots[i]);
+        }
+        free(node);
+    }
+}
+
+// Path copying:
+// The functions below take over the caller's reference to `node` and
+// return a node holding one reference in its place. When no other
+// version holds `node` it is changed in place, or moved into the new
+// allocation when its size changes. Otherwise the result is a fresh
+// node holding new references to the slots it shares with `node`.
+static int ht_hamt_unique(ht_hamt_node* node) {
+    return atomic_load_explicit(&node->refs, memory_order_acquire) == 1;
+}
+
+static ht_hamt_node* ht_hamt_edit(ht_hamt_node* node) {
+    if (ht_hamt_unique(node)) {
+        return node;
+    }
+    ht_hamt_node* copy = ht_hamt_new_node(node->count);
+    copy->bitmap = node->bitmap;
+    memcpy(copy->slots, node->slots, node->count * sizeof(void*));
+    for (int i = 0; i < node->count; i++) {
+        ht_hamt_retain(copy->slots[i]);
+    }
+    ht_hamt_release(node);
+    return copy;
+}
+
+// `node` with `slot` added at `pos`. The caller sets its bit.
+static ht_hamt_node* ht_hamt_with_slot(ht_hamt_node* node, const int pos, void* slot) {
+    ht_hamt_node* grown = ht_hamt_new_node(node->count + 1);
+    grown->bitmap = node->bitmap;
+    memcpy(grown->slots, node->slots, pos * sizeof(void*));
+    grown->slots[pos] = slot;
+    memcpy(grown->slots + pos + 1, node->slots + pos, (node->count - pos) * sizeof(void*));
+    if (ht_hamt_unique(node)) {
+        free(node);
+        return grown;
+    }
+    for (int i = 0; i < node->count; i++) {
+        ht_hamt_retain(node->slots[i]);
+    }
+    ht_hamt_release(node);
+    return grown;
+}
+
+// `node` without the slot at `pos`. The caller clears its bit.
+static ht_hamt_node* ht_hamt_without_slot(ht_hamt_node* node, const int pos) {
+    ht_hamt_node* shrunk = ht_hamt_new_node(node->count - 1);
+    shrunk->bitmap = node->bitmap;
+    memcpy(shrunk->slots, node->slots, pos * sizeof(void*));
+    memcpy(shrunk->slots + pos, node->slots + pos + 1, (node->count - pos - 1) * sizeof(void*));
+    if (ht_hamt_unique(node)) {
+        ht_hamt_release(node->slots[pos]);
+        free(node);
+        return shrunk;
+    }
+    for (int i = 0; i < shrunk->count; i++) {
+        ht_hamt_retain(shrunk->slots[i]);
+    }
+    ht_hamt_release(node);
+    return shrunk;
+}
+
+// The slot at `keep` of a node that is going away, to be pulled up
+// into its parent.
+static void* ht_hamt_lift(ht_hamt_node* node, const int keep) {
+    void* slot = node->slots[keep];
+    ht_hamt_retain(slot);
+    ht_hamt_release(node);
+    return slot;
+}
+
+// A subtree holding the leaves `a` and `b`, whose hashes agree on the
+// bits above `shift`. Takes over a reference to each.
+static ht_hamt_node* ht_hamt_pair(ht_hamt_leaf* a, ht_hamt_leaf* b, const int shift) {
+    if (shift >= HT_HAMT_HASH_BITS) {
+        ht_hamt_node* node = ht_hamt_new_node(2);
+        node->slots[0] = HT_HAMT_TAG(a);
+        node->slots[1] = HT_HAMT_TAG(b);
+        return node;
+    }
+    const int index_a = (a->hash >> shift) & HT_HAMT_MASK;
+    const int index_b = (b->hash >> shift) & HT_HAMT_MASK;
+    if (index_a == index_b) {
+        ht_hamt_node* node = ht_hamt_new_node(1);
+        node->bitmap = 1u << index_a;
+        node->slots[0] = ht_hamt_pair(a, b, shift + HT_HAMT_BITS);
+        return node;
+    }
+    ht_hamt_node* node = ht_hamt_new_node(2);
+    node->bitmap = (1u << index_a) | (1u << index_b);
+    node->slots[index_a > index_b] = HT_HAMT_TAG(a);
+    node->slots[index_b > index_a] = HT_HAMT_TAG(b);
+    return node;
+}
+
+static ht_hamt_node* ht_hamt_insert_at(ht_hamt_node* node, const int shift, ht_hamt_leaf* leaf,
+                                       int* added) {
+    if (shift >= HT_HAMT_HASH_BITS) {
+        for (int i = 0; i < node->count; i++) {
+            if (strcmp(HT_HAMT_LEAF(node->slots[i])->key, leaf->key) == 0) {
+                node = ht_hamt_edit(node);
+                ht_hamt_release(node->slots[i]);
+                node->slots[i] = HT_HAMT_TAG(leaf);
+                return node;
+            }
+        }
+        *added = 1;
+        return ht_hamt_with_slot(node, node->count, HT_HAMT_TAG(leaf));
+    }
+    const uint32_t bit = 1u << ((leaf->hash >> shift) & HT_HAMT_MASK);
+    const int pos = ht_hamt_pos(node->bitmap, bit);
+    if (!(node->bitmap & bit)) {
+        *added = 1;
+        node = ht_hamt_with_slot(node, pos, HT_HAMT_TAG(leaf));
+        node->bitmap |= bit;
+        return node;
+    }
+    node = ht_hamt_edit(node);
+    void* slot = node->slots[pos];
+    if (!HT_HAMT_IS_LEAF(slot)) {
+        node->slots[pos] = ht_hamt_insert_at(slot, shift + HT_HAMT_BITS, leaf, added);
+        return node;
+    }
+    ht_hamt_leaf* old = HT_HAMT_LEAF(slot);
+    if (old->hash == leaf->hash && strcmp(old->key, leaf->key) == 0) {
+        ht_hamt_release(slot);
+        node->slots[pos] = HT_HAMT_TAG(leaf);
+        return node;
+    }
+    // The node's reference to `old` moves into the new subtree
+    *added = 1;
+    node->slots[pos] = ht_hamt_pair(old, leaf, shift + HT_HAMT_BITS);
+    return node;
+}
+
+// Removes `key`, which must be present below `node`, and returns what
+// takes the place of `node`: NULL if nothing is left, a lone leaf to be
+// pulled up into the parent, or a node. Pulling lone leaves up keeps
+// every node below the root holding two slots or a subtree, so the
+// trie is as shallow as the hashes allow.
+static void* ht_hamt_remove_at(ht_hamt_node* node, const int shift, const char* key,
+                               const uint64_t hash) {
+    if (shift >= HT_HAMT_HASH_BITS) {
+        int pos = 0;
+        while (strcmp(HT_HAMT_LEAF(node->slots[pos])->key, key) != 0) {
+            pos++;
+        }
+        if (node->count == 2) {
+            return ht_hamt_lift(node, 1 - pos);
+        }
+        return ht_hamt_without_slot(node, pos);
+    }
+    const uint32_t bit = 1u << ((hash >> shift) & HT_HAMT_MASK);
+    const int pos = ht_hamt_pos(node->bitmap, bit);
+    void* slot = node->slots[pos];
+    if (HT_HAMT_IS_LEAF(slot)) {
+        if (node->count == 1) {
+            ht_hamt_release(node);
+            return NULL;
+        }
+        if (node->count == 2 && shift > 0 && HT_HAMT_IS_LEAF(node->slots[1 - pos])) {
+            return ht_hamt_lift(node, 1 - pos);
+        }
+        node = ht_hamt_without_slot(node, pos);
+        node->bitmap &= ~bit;
+        return node;
+    }
+    node = ht_hamt_edit(node);
+    void* child = ht_hamt_remove_at(slot, shift + HT_HAMT_BITS, key, hash);
+    if (HT_HAMT_IS_LEAF(child) && node->count == 1 && shift > 0) {
+        free(node);
+        return child;
+    }
+    node->slots[pos] = child;
+    return node;
+}
+
+ht_hamt* ht_hamt_new() {
+    ht_hamt* h = xmalloc(sizeof(ht_hamt));
+    h->root = NULL;
+    h->count = 0;
+    return h;
+}
+
+// A snapshot only takes a reference to the root. The first change to
+// either version afterwards copies its path, a node per level.
+ht_hamt* ht_hamt_snapshot(const ht_hamt* h) {
+    ht_hamt* snapshot = xmalloc(sizeof(ht_hamt));
+    snapshot->root = h->root;
+    snapshot->count = h->count;
+    if (h->root) {
+        ht_hamt_retain(h->root);
+    }
+    return snapshot;
+}
+
+void ht_hamt_del(ht_hamt* h) {
+    if (h->root) {
+        ht_hamt_release(h->root);
+    }
+    free(h);
+}
+
+void ht_hamt_rollback(ht_hamt* h, const ht_hamt* snapshot) {
+    if (snapshot->root) {
+        ht_hamt_retain(snapshot->root);
+    }
+    if (h->root) {
+        ht_hamt_release(h->root);
+    }
+    h->root = snapshot->root;
+    h->count = snapshot->count;
+}
+
+void ht_hamt_insert(ht_hamt* h, const char* key, const char* value) {
+    const uint64_t hash = ht_hamt_hash(key);
+    ht_hamt_leaf* leaf = ht_hamt_new_leaf(key, value, hash);
+    if (h->root == NULL) {
+        h->root = ht_hamt_new_node(1);
+        h->root->bitmap = 1u << (hash & HT_HAMT_MASK);
+        h->root->slots[0] = HT_HAMT_TAG(leaf);
+        h->count = 1;
+        return;
+    }
+    int added = 0;
+    h->root = ht_hamt_insert_at(h->root, 0, leaf, &added);
+    h->count += added;
+}
+
+// A search reads a node per `HT_HAMT_BITS` bits of hash it needs to
+// tell the key apart from its neighbours, and compares one key.
+char* ht_hamt_search(const ht_hamt* h, const char* key) {
+    const uint64_t hash = ht_hamt_hash(key);
+    const ht_hamt_node* node = h->root;
+    for (int shift = 0; node; shift += HT_HAMT_BITS) {
+        if (shift >= HT_HAMT_HASH_BITS) {
+            for (int i = 0; i < node->count; i++) {
+                ht_hamt_leaf* leaf = HT_HAMT_LEAF(node->slots[i]);
+                if (strcmp(leaf->key, key) == 0) {
+                    return leaf->value;
+                }
+            }
+            return NULL;
+        }
+        const uint32_t bit = 1u << ((hash >> shift) & HT_HAMT_MASK);
+        if (!(node->bitmap & bit)) {
+            return NULL;
+        }
+        void* slot = node->slots[ht_hamt_pos(node->bitmap, bit)];
+        if (HT_HAMT_IS_LEAF(slot)) {
+            ht_hamt_leaf* leaf = HT_HAMT_LEAF(slot);
+            return leaf->hash == hash && strcmp(leaf->key, key) == 0 ? leaf->value : NULL;
+        }
+        node = slot;
+    }
+    return NULL;
+}
+
+// Deleting an absent key leaves every version untouched, rather than
+// copying a path to change nothing.
+void ht_hamt_delete(ht_hamt* h, const char* key) {
+    if (ht_hamt_search(h, key) == NULL) {
+        return;
+    }
+    h->root = ht_hamt_remove_at(h->root, 0, key, ht_hamt_hash(key));
+    h->count--;
+}
+
+static void ht_hamt_visit(const ht_hamt_node* node,
+                          void (*fn)(const char* key, const char* value, void* arg), void* arg) {
+    for (int i = 0; i < node->count; i++) {
+        if (HT_HAMT_IS_LEAF(node->slots[i])) {
+            const ht_hamt_leaf* leaf = HT_HAMT_LEAF(node->slots[i]);
+            fn(leaf->key, leaf->value, arg);
+        } else {
+            ht_hamt_visit(node->slots[i], fn, arg);
+        }
+    }
+}
+
+// Calls `fn` on every entry, in no particular order. Run on a snapshot, this is
+// a consistent export while other versions keep changing.
+void ht_hamt_foreach(const ht_hamt* h, void (*fn)(const char* key, const char* value, void* arg),
+                     void* arg) {
+    if (h->root) {
+        ht_hamt_visit(h->root, fn, arg);
+    }
+}
@@ -0,0 +1,172 @@
+//
+//  ht_sharded.c
+//  hash_table
+//
+
+#define _GNU_SOURCE
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "xmalloc.h"
+
+#include "ht_sharded.h"
+
+// Shard selection:
+// The top bits of the 64-bit hash pick the shard. The table inside the
+// shard hashes the key with its own `ht_hash`, so keys sharing a shard
+// are still spread over all of its buckets.
+static int ht_shard_index(ht_sharded_table* sh, const char* key) {
+    if (sh->shard_bits == 0) {
+        return 0;
+    }
+    return (int)(ht_hash64(key) >> (64 - sh->shard_bits));
+}
+
+int ht_sharded_shard_of(ht_sharded_table* sh, const char* key) {
+    return ht_shard_index(sh, key);
+}
+
+static ht_sharded_table* ht_sharded_alloc(const int shard_bits) {
+    ht_sharded_table* sh = xmalloc(sizeof(ht_sharded_table));
+    sh->shard_bits = shard_bits;
+    sh->num_shards = 1 << shard_bits;
+    sh->shards = xcalloc_aligned(64, (size_t)sh->num_shards, sizeof(ht_shard));
+    for (int i = 0; i < sh->num_shards; i++) {
+        pthread_mutex_init(&sh->shards[i].lock, NULL);
+        sh->shards[i].cpu = -1;
+    }
+    return sh;
+}
+
+// `ht_sharded_new` creates `2^shard_bits` empty shards.
+ht_sharded_table* ht_sharded_new(const int shard_bits) {
+    ht_sharded_table* sh = ht_sharded_alloc(shard_bits);
+    for (int i = 0; i < sh->num_shards; i++) {
+        sh->shards[i].table = ht_new();
+    }
+    return sh;
+}
+
+// Pin the calling thread to `cpu`. Returns 0 on success.
+static int ht_pin_to_cpu(const int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set);
+}
+
+typedef struct {
+    ht_shard* shard;
+    int capacity;
+} ht_shard_touch_args;
+
+// Presize the table and write every bucket, which faults the pages in
+// while pinned. Bucket arrays are mapped lazily, so merely allocating
+// them would leave the placement to whichever thread inserts first.
+static void* ht_shard_first_touch(void* arg) {
+    ht_shard_touch_args* a = arg;
+    ht_pin_to_cpu(a->shard->cpu);
+    ht_hash_table* table = ht_new_capacity(a->capacity);
+    memset(table->items, 0, (size_t)table->size * sizeof(ht_item*));
+    a->shard->table = table;
+    return NULL;
+}
+
+// Thread affinity:
+// Shard `i` is owned by `cpus[i % num_cpus]`. Its table is sized for
+// its share of `expected` items and its buckets first touched by a
+// thread pinned to that CPU, so under Linux's first-touch policy they
+// land on the CPU's NUMA node. Growing past `expected` allocates in
+// whichever thread inserts, so callers that want the placement to last
+// either size `expected` generously or route each shard's writes
+// through a thread that called `ht_sharded_pin`. If a thread can't be
+// started the table is created by the caller.
+ht_sharded_table* ht_sharded_new_affine(const int shard_bits, const int* cpus, const int num_cpus,
+                                        const int expected) {
+    ht_sharded_table* sh = ht_sharded_alloc(shard_bits);
+    for (int i = 0; i < sh->num_shards; i++) {
+        ht_shard* shard = &sh->shards[i];
+        shard->cpu = cpus[i % num_cpus];
+        ht_shard_touch_args args = {shard, expected / sh->num_shards};
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, ht_shard_first_touch, &args) == 0) {
+            pthread_join(thread, NULL);
+        } else {
+            shard->table = ht_new_capacity(args.capacity);
+        }
+    }
+    return sh;
+}
+
+// Pin the calling thread to the CPU owning `shard`. Returns 0 on
+// success and -1 if the shard has no owner or pinning failed.
+int ht_sharded_pin(ht_sharded_table* sh, const int shard) {
+    const int cpu = sh->shards[shard].cpu;
+    if (cpu < 0 || ht_pin_to_cpu(cpu) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+void ht_sharded_del(ht_sharded_table* sh) {
+    for (int i = 0; i < sh->num_shards; i++) {
+        ht_del_hash_table(sh->shards[i].table);
+        pthread_mutex_destroy(&sh->shards[i].lock);
+    }
+    free(sh->shards);
+    free(sh);
+}
+
+// Operations lock only the shard owning the key. Resizes triggered by
+// `ht_insert` and `ht_delete` run under that lock and stall nobody
+// working on the other shards.
+void ht_sharded_insert(ht_sharded_table* sh, const char* key, const char* value) {
+    ht_shard* shard = &sh->shards[ht_shard_index(sh, key)];
+    pthread_mutex_lock(&shard->lock);
+    ht_insert(shard->table, key, value);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+// Unlike `ht_search`, the value is returned as a copy which the caller
+// must `free`, since another thread may replace or delete the stored
+// one as soon as the shard is unlocked.
+char* ht_sharded_search(ht_sharded_table* sh, const char* key) {
+    ht_shard* shard = &sh->shards[ht_shard_index(sh, key)];
+    pthread_mutex_lock(&shard->lock);
+    char* value = ht_search(shard->table, key);
+    if (value != NULL) {
+        value = xstrdup(value);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return value;
+}
+
+void ht_sharded_delete(ht_sharded_table* sh, const char* key) {
+    ht_shard* shard = &sh->shards[ht_shard_index(sh, key)];
+    pthread_mutex_lock(&shard->lock);
+    ht_delete(shard->table, key);
+    pthread_mutex_unlock(&shard->lock);
+}
+
+int ht_sharded_count(ht_sharded_table* sh) {
+    int count = 0;
+    for (int i = 0; i < sh->num_shards; i++) {
+        pthread_mutex_lock(&sh->shards[i].lock);
+        count += sh->shards[i].table->count;
+        pthread_mutex_unlock(&sh->shards[i].lock);
+    }
+    return count;
+}
+
+void ht_sharded_stats_dump(ht_sharded_table* sh, FILE* out) {
+    for (int i = 0; i < sh->num_shards; i++) {
+        pthread_mutex_lock(&sh->shards[i].lock);
+        fprintf(out, "shard %d cpu %d: ", i, sh->shards[i].cpu);
+        ht_stats_dump(sh->shards[i].table, out);
+        pthread_mutex_unlock(&sh->shards[i].lock);
+    }
+}
@@ -0,0 +1,464 @@
+//
+//  ht_wal.c
+//  hash_table
+//
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "xmalloc.h"
+
+#include "ht_wal.h"
+
+#define HT_WAL_MAGIC "HTWAL001"
+#define HT_WAL_CKPT_MAGIC "HTCKP001"
+#define HT_WAL_MAGIC_LEN 8
+#define HT_WAL_CKPT_HEADER (HT_WAL_MAGIC_LEN + sizeof(uint64_t))
+#define HT_WAL_RECORD_HEADER (1 + 2 * sizeof(uint32_t))
+
+// 32-bit FNV-1a. Only meant to catch torn and garbled records.
+static uint32_t ht_wal_checksum(const char* data, const size_t len) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        hash ^= (unsigned char)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+static int ht_wal_write_all(const int fd, const char* buf, size_t len) {
+    while (len > 0) {
+        const ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return -1;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Read all of `path`. A missing file reads as empty.
+static char* ht_wal_read_file(const char* path, size_t* len) {
+    *len = 0;
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT ? xmalloc(1) : NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+    char* data = xmalloc((size_t)st.st_size + 1);
+    while (*len < (size_t)st.st_size) {
+        const ssize_t n = read(fd, data + *len, (size_t)st.st_size - *len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        *len += (size_t)n;
+    }
+    close(fd);
+    return data;
+}
+
+// Append one record to `buf`, growing it as needed.
+static void ht_wal_put_record(char** buf, size_t* len, size_t* cap, const int op,
+                              const char* key, const char* value) {
+    const uint32_t key_len = (uint32_t)strlen(key);
+    const uint32_t value_len = (uint32_t)strlen(value);
+    const size_t size = HT_WAL_RECORD_HEADER + key_len + value_len + sizeof(uint32_t);
+    if (*len + size > *cap) {
+        *cap = (*len + size) * 2;
+        *buf = xrealloc(*buf, *cap);
+    }
+    char* r = *buf + *len;
+    r[0] = (char)op;
+    memcpy(r + 1, &key_len, sizeof(uint32_t));
+    memcpy(r + 1 + sizeof(uint32_t), &value_len, sizeof(uint32_t));
+    memcpy(r + HT_WAL_RECORD_HEADER, key, key_len);
+    memcpy(r + HT_WAL_RECORD_HEADER + key_len, value, value_len);
+    const uint32_t sum = ht_wal_checksum(r, size - sizeof(uint32_t));
+    memcpy(r + size - sizeof(uint32_t), &sum, sizeof(uint32_t));
+    *len += size;
+}
+
+// Replay:
+// Walk the records of `data` from `at`, applying them to `ht` unless it
+// is NULL, and counting inserts. Returns the offset just past the last
+// intact record. Keys and values are copied out to NUL terminate them.
+static size_t ht_wal_scan(const char* data, size_t at, const size_t len, ht_hash_table* ht,
+                          long* inserts) {
+    char* key = NULL;
+    char* value = NULL;
+    size_t key_cap = 0;
+    size_t value_cap = 0;
+    while (len - at >= HT_WAL_RECORD_HEADER + sizeof(uint32_t)) {
+        const char* r = data + at;
+        uint32_t key_len;
+        uint32_t value_len;
+        memcpy(&key_len, r + 1, sizeof(uint32_t));
+        memcpy(&value_len, r + 1 + sizeof(uint32_t), sizeof(uint32_t));
+        const size_t body = HT_WAL_RECORD_HEADER + (size_t)key_len + value_len;
+        if (len - at - sizeof(uint32_t) < body) {
+            break;
+        }
+        uint32_t sum;
+        memcpy(&sum, r + body, sizeof(uint32_t));
+        const int op = r[0];
+        if (sum != ht_wal_checksum(r, body) || (op != HT_WAL_INSERT && op != HT_WAL_DELETE)) {
+            break;
+        }
+        at += body + sizeof(uint32_t);
+        *inserts += op == HT_WAL_INSERT;
+        if (ht == NULL) {
+            continue;
+        }
+        if (key_len + 1 > key_cap) {
+            key_cap = (key_len + 1) * 2;
+            key = xrealloc(key, key_cap);
+        }
+        memcpy(key, r + HT_WAL_RECORD_HEADER, key_len);
+        key[key_len] = '\0';
+        if (op == HT_WAL_DELETE) {
+            ht_delete(ht, key);
+            continue;
+        }
+        if (value_len + 1 > value_cap) {
+            value_cap = (value_len + 1) * 2;
+            value = xrealloc(value, value_cap);
+        }
+        memcpy(value, r + HT_WAL_RECORD_HEADER + key_len, value_len);
+        value[value_len] = '\0';
+        ht_insert(ht, key, value);
+    }
+    free(key);
+    free(value);
+    return at;
+}
+
+static char* ht_wal_ckpt_path(const char* path, const char* suffix) {
+    const size_t len = strlen(path) + strlen(suffix) + 1;
+    char* p = xmalloc(len);
+    snprintf(p, len, "%s%s", path, suffix);
+    return p;
+}
+
+// A rename is only durable once the directory holding it is synced.
+static void ht_wal_sync_dir(const char* path) {
+    char* dir = xstrdup(path);
+    char* slash = strrchr(dir, '/');
+    if (slash == NULL) {
+        strcpy(dir, ".");
+    } else if (slash == dir) {
+        slash[1] = '\0';
+    } else {
+        *slash = '\0';
+    }
+    const int fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+    free(dir);
+}
+
+// Opening:
+// The checkpoint header gives its item count and a first pass over the
+// log counts its inserts, so the table is created at its final size
+// and never resizes during the replay. Replaying the log over a
+// checkpoint that already includes some of its records is harmless,
+// as every record sets or removes a key outright.
+ht_wal* ht_wal_open(const char* path, const int sync, const size_t max_log_bytes) {
+    char* ckpt_path = ht_wal_ckpt_path(path, ".ckpt");
+    size_t ckpt_len;
+    char* ckpt = ht_wal_read_file(ckpt_path, &ckpt_len);
+    free(ckpt_path);
+    if (ckpt == NULL) {
+        perror(path);
+        return NULL;
+    }
+    uint64_t ckpt_count = 0;
+    if (ckpt_len > 0) {
+        if (ckpt_len < HT_WAL_CKPT_HEADER
+                || memcmp(ckpt, HT_WAL_CKPT_MAGIC, HT_WAL_MAGIC_LEN) != 0) {
+            fprintf(stderr, "%s.ckpt: not a checkpoint\n", path);
+            free(ckpt);
+            return NULL;
+        }
+        memcpy(&ckpt_count, ckpt + HT_WAL_MAGIC_LEN, sizeof(uint64_t));
+    }
+
+    const int fd = open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    size_t log_len;
+    char* log = fd < 0 ? NULL : ht_wal_read_file(path, &log_len);
+    if (log == NULL) {
+        perror(path);
+        free(ckpt);
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    if (log_len >= HT_WAL_MAGIC_LEN && memcmp(log, HT_WAL_MAGIC, HT_WAL_MAGIC_LEN) != 0) {
+        fprintf(stderr, "%s: not a log\n", path);
+        free(ckpt);
+        free(log);
+        close(fd);
+        return NULL;
+    }
+
+    long inserts = (long)ckpt_count;
+    size_t log_end = HT_WAL_MAGIC_LEN;
+    if (log_len >= HT_WAL_MAGIC_LEN) {
+        log_end = ht_wal_scan(log, HT_WAL_MAGIC_LEN, log_len, NULL, &inserts);
+    }
+    ht_hash_table* ht = ht_new_capacity(inserts < 1 << 30 ? (int)inserts : 1 << 30);
+    if (ckpt_len > 0) {
+        long ignored = 0;
+        const size_t end = ht_wal_scan(ckpt, HT_WAL_CKPT_HEADER, ckpt_len, ht, &ignored);
+        if (end != ckpt_len) {
+            // Opening with part of the checkpoint would lose the rest
+            // for good at the next checkpoint
+            fprintf(stderr, "%s.ckpt: corrupt at byte %zu\n", path, end);
+            ht_del_hash_table(ht);
+            free(ckpt);
+            free(log);
+            close(fd);
+            return NULL;
+        }
+    }
+    if (log_len >= HT_WAL_MAGIC_LEN) {
+        long ignored = 0;
+        ht_wal_scan(log, HT_WAL_MAGIC_LEN, log_end, ht, &ignored);
+    }
+    free(ckpt);
+    free(log);
+
+    // Start a new log, or cut off a torn tail so appends follow the
+    // last intact record
+    int rc = 0;
+    if (log_len < HT_WAL_MAGIC_LEN) {
+        rc = ftruncate(fd, 0) || ht_wal_write_all(fd, HT_WAL_MAGIC, HT_WAL_MAGIC_LEN);
+    } else if (log_end < log_len) {
+        fprintf(stderr, "%s: dropping %zu bytes after the last intact record\n", path,
+                log_len - log_end);
+        rc = ftruncate(fd, (off_t)log_end);
+    }
+    if (rc != 0 || (sync && fdatasync(fd) != 0)) {
+        perror(path);
+        ht_del_hash_table(ht);
+        close(fd);
+        return NULL;
+    }
+
+    ht_wal* w = xcalloc(1, sizeof(ht_wal));
+    w->table = ht;
+    w->path = xstrdup(path);
+    w->fd = fd;
+    w->sync = sync;
+    w->max_log_bytes = max_log_bytes;
+    w->log_bytes = log_len < HT_WAL_MAGIC_LEN ? HT_WAL_MAGIC_LEN : log_end;
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->flushed, NULL);
+    return w;
+}
+
+// Group commit:
+// Called with the lock held and no flush in progress. Takes every
+// record appended so far, writes and syncs them with the lock released,
+// and wakes the threads waiting on any of them. Records appended in the
+// meantime go into the other buffer and make up the next group. Only
+// once a group is on disk are its records applied to the table, in log
+// order, so the table never shows a change a crash could lose. A group
+// that fails to write is never applied.
+static void ht_wal_flush_group(ht_wal* w) {
+    char* buf = w->buf;
+    const size_t len = w->len;
+    const size_t cap = w->cap;
+    const uint64_t target = w->appended;
+    w->buf = w->spare;
+    w->cap = w->spare_cap;
+    w->len = 0;
+    w->spare = buf;
+    w->spare_cap = cap;
+    w->flushing = 1;
+    pthread_mutex_unlock(&w->lock);
+    int rc = ht_wal_write_all(w->fd, buf, len);
+    if (rc == 0 && w->sync) {
+        rc = fdatasync(w->fd);
+    }
+    pthread_mutex_lock(&w->lock);
+    w->flushing = 0;
+    if (rc != 0) {
+        perror(w->path);
+        w->error = 1;
+    } else {
+        long ignored = 0;
+        ht_wal_scan(buf, 0, len, w->table, &ignored);
+        w->durable = target;
+        w->log_bytes += len;
+        w->commits++;
+    }
+    pthread_cond_broadcast(&w->flushed);
+}
+
+// Wait for the log to catch up with every appended record.
+static void ht_wal_drain(ht_wal* w) {
+    while ((w->flushing || w->len > 0) && !w->error) {
+        if (w->flushing) {
+            pthread_cond_wait(&w->flushed, &w->lock);
+        } else {
+            ht_wal_flush_group(w);
+        }
+    }
+}
+
+// Checkpoint:
+// With the lock held and the log drained the table matches the log
+// exactly. Its items are written to a temporary file that replaces the
+// checkpoint once synced, and only then is the log truncated back to
+// its magic. Mutations wait for the whole checkpoint.
+static int ht_wal_checkpoint_locked(ht_wal* w) {
+    ht_wal_drain(w);
+    if (w->error) {
+        return -1;
+    }
+    char* tmp_path = ht_wal_ckpt_path(w->path, ".ckpt.tmp");
+    char* ckpt_path = ht_wal_ckpt_path(w->path, ".ckpt");
+    int rc = -1;
+    const int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd >= 0) {
+        size_t cap = 1 << 20;
+        char* buf = xmalloc(cap);
+        size_t len = HT_WAL_CKPT_HEADER;
+        const uint64_t count = (uint64_t)w->table->count;
+        memcpy(buf, HT_WAL_CKPT_MAGIC, HT_WAL_MAGIC_LEN);
+        memcpy(buf + HT_WAL_MAGIC_LEN, &count, sizeof(uint64_t));
+        rc = 0;
+        for (int i = 0; i < w->table->size && rc == 0; i++) {
+            ht_item* item = w->table->items[i];
+            if (item == NULL || ht_is_deleted(item)) {
+                continue;
+            }
+            ht_wal_put_record(&buf, &len, &cap, HT_WAL_INSERT, item->key, item->value);
+            if (len >= 1 << 20) {
+                rc = ht_wal_write_all(fd, buf, len);
+                len = 0;
+            }
+        }
+        if (rc == 0) {
+            rc = ht_wal_write_all(fd, buf, len);
+        }
+        if (rc == 0 && w->sync) {
+            rc = fdatasync(fd);
+        }
+        free(buf);
+        rc = close(fd) || rc;
+    }
+    if (rc == 0) {
+        rc = rename(tmp_path, ckpt_path);
+    }
+    if (rc == 0 && w->sync) {
+        ht_wal_sync_dir(ckpt_path);
+    }
+    if (rc == 0) {
+        rc = ftruncate(w->fd, HT_WAL_MAGIC_LEN);
+        if (rc == 0 && w->sync) {
+            rc = fdatasync(w->fd);
+        }
+        if (rc == 0) {
+            w->log_bytes = HT_WAL_MAGIC_LEN;
+            w->checkpoints++;
+        }
+    }
+    if (rc != 0) {
+        perror(tmp_path);
+        unlink(tmp_path);
+    }
+    free(tmp_path);
+    free(ckpt_path);
+    return rc ? -1 : 0;
+}
+
+int ht_wal_checkpoint(ht_wal* w) {
+    pthread_mutex_lock(&w->lock);
+    const int rc = ht_wal_checkpoint_locked(w);
+    pthread_mutex_unlock(&w->lock);
+    return rc;
+}
+
+// Called with the lock held after appending record `seq`. The first
+// waiter to find no flush in progress flushes the group, which carries
+// its own record and those of everyone who appended since the last one.
+// A checkpoint that fails leaves the log intact, so the mutation still
+// succeeds.
+static int ht_wal_commit(ht_wal* w, const uint64_t seq) {
+    while (w->durable < seq && !w->error) {
+        if (w->flushing) {
+            pthread_cond_wait(&w->flushed, &w->lock);
+        } else {
+            ht_wal_flush_group(w);
+        }
+    }
+    if (!w->error && w->max_log_bytes > 0 && w->log_bytes > w->max_log_bytes) {
+        ht_wal_checkpoint_locked(w);
+    }
+    return w->error ? -1 : 0;
+}
+
+static int ht_wal_mutate(ht_wal* w, const int op, const char* key, const char* value) {
+    pthread_mutex_lock(&w->lock);
+    if (w->error) {
+        pthread_mutex_unlock(&w->lock);
+        return -1;
+    }
+    ht_wal_put_record(&w->buf, &w->len, &w->cap, op, key, value);
+    const int rc = ht_wal_commit(w, ++w->appended);
+    pthread_mutex_unlock(&w->lock);
+    return rc;
+}
+
+int ht_wal_insert(ht_wal* w, const char* key, const char* value) {
+    return ht_wal_mutate(w, HT_WAL_INSERT, key, value);
+}
+
+int ht_wal_delete(ht_wal* w, const char* key) {
+    return ht_wal_mutate(w, HT_WAL_DELETE, key, "");
+}
+
+char* ht_wal_search(ht_wal* w, const char* key) {
+    pthread_mutex_lock(&w->lock);
+    const char* value = ht_search(w->table, key);
+    char* copy = value != NULL ? xstrdup(value) : NULL;
+    pthread_mutex_unlock(&w->lock);
+    return copy;
+}
+
+// Closing flushes whatever is still pending, then frees the table
+// along with the log.
+void ht_wal_close(ht_wal* w) {
+    pthread_mutex_lock(&w->lock);
+    ht_wal_drain(w);
+    pthread_mutex_unlock(&w->lock);
+    close(w->fd);
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->flushed);
+    ht_del_hash_table(w->table);
+    free(w->buf);
+    free(w->spare);
+    free(w->path);
+    free(w);
+}
@@ -26,6 +26,15 @@
 #include <sys/types.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "xmalloc.h"
 
 static void *xmalloc_fatal(size_t size) {
     if (size==0) return NULL;
@@ -51,10 +60,151 @@ void *xrealloc (void *ptr, size_t size) {
     return p;
 }
 
+void *xcalloc_aligned (size_t alignment, size_t nmemb, size_t size) {
+    void *ptr;
+    if (posix_memalign (&ptr, alignment, nmemb*size) != 0) return xmalloc_fatal(nmemb*size);
+    memset (ptr, 0, nmemb*size);
+    return ptr;
+}
+
 char *xstrdup (const char *s) {
     void *ptr = xmalloc(strlen(s)+1);
     strcpy (ptr, s);
     return (char*) ptr;
 }
 
+static atomic_int xl_huge = XL_HUGE_THP;
+static atomic_int xl_numa = XL_NUMA_DEFAULT;
+static atomic_ulong xl_mapped, xl_hugetlb, xl_thp, xl_fallbacks, xl_numa_failed, xl_bytes;
+
+void xlarge_policy (int huge, int numa) {
+  atomic_store (&xl_huge, huge);
+  atomic_store (&xl_numa, numa);
+}
+
+void xlarge_get_stats (xlarge_stats *stats) {
+  stats->mapped = atomic_load (&xl_mapped);
+  stats->hugetlb = atomic_load (&xl_hugetlb);
+  stats->thp = atomic_load (&xl_thp);
+  stats->fallbacks = atomic_load (&xl_fallbacks);
+  stats->numa_failed = atomic_load (&xl_numa_failed);
+  stats->bytes = atomic_load (&xl_bytes);
+}
+
+/* Mapping length: whole huge pages, or 0 if the array is small or its
+ * size overflows.  */
+static size_t xl_length (size_t nmemb, size_t size) {
+  if (size != 0 && nmemb > SIZE_MAX / size) return 0;
+  const size_t bytes = nmemb * size;
+  if (bytes < XL_THRESHOLD) return 0;
+  return (bytes + XL_THRESHOLD - 1) & ~(XL_THRESHOLD - 1);
+}
+
+/* Bind the range to the policy's nodes through the raw system call, so
+ * there is no dependency on libnuma. Single node systems and kernels
+ * without NUMA refuse or ignore it, which is harmless.  */
+static void xl_bind (void *ptr, size_t len, int numa) {
+#if defined(__linux__) && defined(SYS_mbind)
+  enum { MPOL_PREFERRED_ = 1, MPOL_INTERLEAVE_ = 3, MPOL_LOCAL_ = 4 };
+  unsigned long mask[16];
+  unsigned long maxnode = 0;
+  long rc;
+  memset (mask, 0, sizeof (mask));
+  if (numa == XL_NUMA_INTERLEAVE) {
+    /* "0-3,6" and the like */
+    FILE *f = fopen ("/sys/devices/system/node/online", "r");
+    int lo, hi;
+    char sep = ',';
+    while (f != NULL && sep == ',' && fscanf (f, "%d", &lo) == 1) {
+      hi = lo;
+      if (fscanf (f, "%c", &sep) == 1 && sep == '-') {
+        if (fscanf (f, "%d%c", &hi, &sep) < 1) break;
+      }
+      for (int n = lo; n <= hi && n < 16 * 64; n++) {
+        mask[n / 64] |= 1UL << (n % 64);
+        if ((unsigned long)n + 1 > maxnode) maxnode = n + 1;
+      }
+    }
+    if (f != NULL) fclose (f);
+    if (maxnode == 0) {
+      mask[0] = 1;
+      maxnode = 1;
+    }
+    rc = syscall (SYS_mbind, ptr, len, MPOL_INTERLEAVE_, mask, maxnode + 1, 0);
+  } else {
+    rc = syscall (SYS_mbind, ptr, len, MPOL_LOCAL_, NULL, 0, 0);
+    if (rc != 0) {
+      /* Kernels before 3.8: preferred with no nodes means local */
+      rc = syscall (SYS_mbind, ptr, len, MPOL_PREFERRED_, NULL, 0, 0);
+    }
+  }
+  if (rc != 0) atomic_fetch_add (&xl_numa_failed, 1);
+#else
+  (void)ptr;
+  (void)len;
+  (void)numa;
+  atomic_fetch_add (&xl_numa_failed, 1);
+#endif
+}
+
+/* Map `len` bytes starting on a huge page boundary, so that THP can
+ * back all of it: over-allocate by one huge page and trim both ends.  */
+static void *xl_map_aligned (size_t len) {
+  const size_t span = len + XL_THRESHOLD;
+  char *raw = mmap (NULL, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED) return NULL;
+  char *ptr = (char *)(((uintptr_t)raw + XL_THRESHOLD - 1) & ~(uintptr_t)(XL_THRESHOLD - 1));
+  if (ptr > raw) munmap (raw, (size_t)(ptr - raw));
+  if (raw + span > ptr + len) munmap (ptr + len, (size_t)(raw + span - (ptr + len)));
+  return ptr;
+}
+
+void *xcalloc_large (size_t nmemb, size_t size) {
+  const size_t len = xl_length (nmemb, size);
+  if (len == 0) return xcalloc (nmemb, size);
+  const int huge = atomic_load (&xl_huge);
+  const int numa = atomic_load (&xl_numa);
+  void *ptr = NULL;
+#ifdef MAP_HUGETLB
+  if (huge == XL_HUGE_TLB) {
+    ptr = mmap (NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (ptr == MAP_FAILED) {
+      /* No huge pages reserved: carry on with THP */
+      ptr = NULL;
+      atomic_fetch_add (&xl_fallbacks, 1);
+    } else {
+      atomic_fetch_add (&xl_hugetlb, 1);
+    }
+  }
+#endif
+  if (ptr == NULL) {
+    ptr = xl_map_aligned (len);
+    if (ptr == NULL) return xmalloc_fatal (len);
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+    if (huge == XL_HUGE_NONE) {
+      madvise (ptr, len, MADV_NOHUGEPAGE);
+    } else if (madvise (ptr, len, MADV_HUGEPAGE) == 0) {
+      atomic_fetch_add (&xl_thp, 1);
+    } else {
+      atomic_fetch_add (&xl_fallbacks, 1);
+    }
+#endif
+  }
+  if (numa != XL_NUMA_DEFAULT) xl_bind (ptr, len, numa);
+  atomic_fetch_add (&xl_mapped, 1);
+  atomic_fetch_add (&xl_bytes, len);
+  return ptr;
+}
+
+void xfree_large (void *ptr, size_t nmemb, size_t size) {
+  const size_t len = xl_length (nmemb, size);
+  if (ptr == NULL) return;
+  if (len == 0) {
+    free (ptr);
+    return;
+  }
+  munmap (ptr, len);
+  atomic_fetch_sub (&xl_bytes, len);
+}
+
 // vi: sts=2 sw=2 ts=2
@@ -0,0 +1,285 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/graph_elements.h"
+#include "../include/graph_kernels.h"
+#include "../include/graph_match.h"
+
+// MinUnit testing framework. http://www.jera.com/techinfo/jtns/jtn002.html
+#define mu_assert(message, test) do { if (!(test)) return message; } while (0)
+#define mu_run_test(test) do { char *message = test(); tests_run++; \
+                            if (message) return message; } while (0)
+
+
+int tests_run = 0;
+
+static const int side = 20;
+static graph* G;
+static gk_f32_dir_graph* g;
+
+static const float lat_step = 0.0009f;
+static const float lon_step = 0.0012f;
+
+
+static float* distance(const float d) {
+    float* p = malloc(sizeof(float));
+    *p = d;
+    return p;
+}
+
+// `side` x `side` grid of two-way streets about 100m apart, with their
+// lengths in metres.
+static graph* grid_graph() {
+    graph* G = create_graph();
+    char key[16];
+    char other[16];
+    for (int i = 0; i < side * side; i++) {
+        snprintf(key, 16, "g%d", i);
+        add_node(G->N, new_node(key, new_gps(42.0f + (i / side) * lat_step,
+                                             -83.0f + (i % side) * lon_step)));
+    }
+    const float lon_metres = lon_step * 111320.0f * cosf(42.0f * (float)M_PI / 180);
+    for (int i = 0; i < side * side; i++) {
+        const int next[2] = {i % side + 1 < side ? i + 1 : -1, i + side < side * side ? i + side : -1};
+        const float length[2] = {lon_metres, lat_step * 111320.0f};
+        for (int k = 0; k < 2; k++) {
+            if (next[k] < 0) {
+                continue;
+            }
+            snprintf(key, 16, "g%d", i);
+            snprintf(other, 16, "g%d", next[k]);
+            add_edge(G->E, key, new_neighbour(other, distance(length[k])));
+            add_edge(G->E, other, new_neighbour(key, distance(length[k])));
+        }
+    }
+    return G;
+}
+
+static int vertex(const int row, const int col) {
+    char key[16];
+    snprintf(key, 16, "g%d", row * side + col);
+    return gk_vertex(&g->csr, key);
+}
+
+static int edge(const int u, const int v) {
+    for (int e = g->csr.offsets[u]; e < g->csr.offsets[u + 1]; e++) {
+        if (g->csr.targets[e] == v) {
+            return e;
+        }
+    }
+    return -1;
+}
+
+// Pings every `spacing` of a block along the grid path through `cells`
+// (row, col pairs), each shifted by up to `noise` of a block. `truth`
+// gets the edge driven at each ping.
+static int drive(const int* cells, const int num_cells, const float spacing, const float noise,
+                 uint64_t seed, gm_point* points, int* truth) {
+    int count = 0;
+    for (int i = 0; i + 1 < num_cells; i++) {
+        const int r0 = cells[2 * i];
+        const int c0 = cells[2 * i + 1];
+        const int r1 = cells[2 * i + 2];
+        const int c1 = cells[2 * i + 3];
+        const int steps = abs(r1 - r0) + abs(c1 - c0);
+        const int dr = (r1 > r0) - (r1 < r0);
+        const int dc = (c1 > c0) - (c1 < c0);
+        for (int s = 0; s < steps; s++) {
+            const int r = r0 + s * dr;
+            const int c = c0 + s * dc;
+            for (float f = spacing / 2; f < 1; f += spacing) {
+                seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+                const float jx = ((int)((seed >> 33) % 2001) - 1000) / 1000.0f * noise;
+                const float jy = ((int)((seed >> 13) % 2001) - 1000) / 1000.0f * noise;
+                points[count].lat = 42.0f + (r + f * dr + jy) * lat_step;
+                points[count].lon = -83.0f + (c + f * dc + jx) * lon_step;
+                truth[count++] = edge(vertex(r, c), vertex(r + dr, c + dc));
+            }
+        }
+    }
+    return count;
+}
+
+
+static char* test_candidates() {
+    printf("*** test_candidates\n");
+    // Narrow enough to leave out the cross streets 50m away
+    gm_matcher* m = gm_new(g, 30, 0, 0, 1);
+    gm_candidate out[GM_MAX_CANDIDATES];
+    // 10m north of the middle of the block from (4, 4) to (4, 5)
+    const gm_point p = {42.0f + 4 * lat_step + lat_step / 10, -83.0f + 4.5f * lon_step};
+    const int count = gm_candidates(m, p, out);
+    mu_assert("error, expecting both directions of the street", count == 2);
+    const int forward = edge(vertex(4, 4), vertex(4, 5));
+    const int backward = edge(vertex(4, 5), vertex(4, 4));
+    mu_assert("error, wrong candidates", (out[0].edge == forward && out[1].edge == backward)
+                                         || (out[0].edge == backward && out[1].edge == forward));
+    for (int i = 0; i < count; i++) {
+        mu_assert("error, wrong distance", fabsf(out[i].distance - 10) < 0.5f);
+        mu_assert("error, wrong offset", fabsf(out[i].offset - 0.5f) < 0.01f);
+    }
+
+    // Near an intersection, nearest first and capped
+    const gm_point corner = {42.0f + 6 * lat_step + 0.00005f, -83.0f + 6 * lon_step};
+    mu_assert("error, expecting a full list", gm_candidates(m, corner, out) == GM_MAX_CANDIDATES);
+    for (int i = 1; i < GM_MAX_CANDIDATES; i++) {
+        mu_assert("error, candidates not sorted", out[i - 1].distance <= out[i].distance);
+    }
+    const gm_point far = {50, 10};
+    mu_assert("error, candidates far away", gm_candidates(m, far, out) == 0);
+    gm_del(m);
+    return 0;
+}
+
+
+static char* test_match_straight() {
+    printf("*** test_match_straight\n");
+    gm_matcher* m = gm_new(g, 0, 0, 0, 1);
+    const int cells[] = {5, 2, 5, 15};
+    gm_point points[64];
+    int truth[64];
+    const gm_trace trace = {drive(cells, 2, 0.25f, 0, 1, points, truth), points};
+    gm_result r;
+    mu_assert("error, pings not matched", gm_match(m, &trace, &r) == trace.count);
+    for (int t = 0; t < trace.count; t++) {
+        mu_assert("error, wrong edge", r.edges[t] == truth[t]);
+    }
+    mu_assert("error, expecting no breaks", r.breaks == 0);
+    mu_assert("error, wrong route length", r.route_len == 14);
+    for (int i = 0; i < r.route_len; i++) {
+        mu_assert("error, wrong route", r.route[i] == vertex(5, 2 + i));
+    }
+    gm_result_free(&r);
+    gm_del(m);
+    return 0;
+}
+
+
+static char* test_match_noisy() {
+    printf("*** test_match_noisy\n");
+    gm_matcher* m = gm_new(g, 0, 0, 0, 1);
+    const int cells[] = {3, 2, 3, 12, 12, 12, 12, 9};
+    gm_point points[256];
+    int truth[256];
+    // Up to 12m off in each direction, a ping every 20m
+    const gm_trace trace = {drive(cells, 4, 0.2f, 0.12f, 7, points, truth), points};
+    // And one far off the map
+    points[10].lat = 45;
+    gm_result r;
+    mu_assert("error, pings not matched", gm_match(m, &trace, &r) == trace.count - 1);
+    mu_assert("error, stray ping matched", r.edges[10] == -1);
+    int right = 0;
+    for (int t = 0; t < trace.count; t++) {
+        right += r.edges[t] == truth[t];
+    }
+    mu_assert("error, too many wrong edges", right >= 0.9 * (trace.count - 1));
+    mu_assert("error, expecting no breaks", r.breaks == 0);
+    int turned = 0;
+    for (int i = 0; i + 1 < r.route_len; i++) {
+        mu_assert("error, route is not connected",
+                  r.route[i] >= 0 && edge(r.route[i], r.route[i + 1]) >= 0);
+        turned |= r.route[i] == vertex(3, 12);
+    }
+    mu_assert("error, route misses the turn", turned);
+    gm_result_free(&r);
+    gm_del(m);
+    return 0;
+}
+
+
+static char* test_match_batch() {
+    printf("*** test_match_batch\n");
+    gm_matcher* serial = gm_new(g, 0, 0, 0, 1);
+    gm_matcher* m = gm_new(g, 0, 0, 0, 3);
+    enum { num_traces = 12 };
+    gm_point points[num_traces][128];
+    int truth[128];
+    gm_trace traces[num_traces];
+    gm_result results[num_traces];
+    for (int i = 0; i < num_traces; i++) {
+        const int cells[] = {i, 0, i, 10, i + 6, 10};
+        traces[i].count = drive(cells, 3, 0.2f, 0.1f, i, points[i], truth);
+        traces[i].points = points[i];
+    }
+    gm_match_batch(m, traces, num_traces, results);
+    for (int i = 0; i < num_traces; i++) {
+        gm_result r;
+        gm_match(serial, &traces[i], &r);
+        mu_assert("error, batch differs", r.count == results[i].count
+                  && memcmp(r.edges, results[i].edges, sizeof(int) * r.count) == 0
+                  && r.route_len == results[i].route_len);
+        gm_result_free(&r);
+        gm_result_free(&results[i]);
+    }
+    mu_assert("error, wrong counts", m->points == serial->points && m->matched == m->points);
+
+    mu_assert("error, expecting cache hits", m->cache_hits > 0);
+
+    // Steps a thread has seen before mostly come from its cache, short of
+    // those pushed out by others sharing their slot
+    const unsigned long misses = serial->cache_misses;
+    for (int i = 0; i < num_traces; i++) {
+        gm_result r;
+        gm_match(serial, &traces[i], &r);
+        gm_result_free(&r);
+    }
+    mu_assert("error, expecting few new misses", serial->cache_misses - misses < misses / 4);
+    gm_del(serial);
+    gm_del(m);
+    return 0;
+}
+
+
+static char* test_unlocated() {
+    printf("*** test_unlocated\n");
+    // A node without a location, linked to the corner of the grid
+    graph* H = grid_graph();
+    add_node(H->N, new_node("nowhere", NULL));
+    add_edge(H->E, "g0", new_neighbour("nowhere", distance(10)));
+    add_edge(H->E, "nowhere", new_neighbour("g0", distance(10)));
+    gk_f32_dir_graph* h = gk_f32_dir_build(H);
+    gm_matcher* m = gm_new(h, 0, 0, 0, 1);
+    const int nowhere = gk_vertex(&h->csr, "nowhere");
+    gm_candidate out[GM_MAX_CANDIDATES];
+    const gm_point corner = {42.0f, -83.0f};
+    const int count = gm_candidates(m, corner, out);
+    mu_assert("error, expecting candidates", count > 0);
+    for (int i = 0; i < count; i++) {
+        mu_assert("error, edge of a location-less node matched",
+                  m->sources[out[i].edge] != nowhere && h->csr.targets[out[i].edge] != nowhere);
+    }
+    gm_del(m);
+    gk_f32_dir_free(h);
+    delete_graph(H);
+    return 0;
+}
+
+
+static char* all_tests() {
+    printf("*** Runnng all tests...\n");
+    mu_run_test(test_candidates);
+    mu_run_test(test_match_straight);
+    mu_run_test(test_match_noisy);
+    mu_run_test(test_match_batch);
+    mu_run_test(test_unlocated);
+    return 0;
+}
+
+
+int main() {
+    printf("*** Graph Map Matching Unit tests\n");
+    G = grid_graph();
+    g = gk_f32_dir_build(G);
+    char* result = all_tests();
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf("all tests passed\n");
+    }
+    printf("%d tests run\n", tests_run);
+    return result != 0;
+}
@@ -0,0 +1,249 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/graph_elements.h"
+#include "../include/graph_kernels.h"
+#include "../include/graph_partition.h"
+
+// MinUnit testing framework. http://www.jera.com/techinfo/jtns/jtn002.html
+#define mu_assert(message, test) do { if (!(test)) return message; } while (0)
+#define mu_run_test(test) do { char *message = test(); tests_run++; \
+                            if (message) return message; } while (0)
+
+
+int tests_run = 0;
+
+static char dir[] = "/tmp/graph_partition_test.XXXXXX";
+static char prefix[64];
+static const int side = 40;
+
+
+static float* distance(const float d) {
+    float* p = malloc(sizeof(float));
+    *p = d;
+    return p;
+}
+
+// `side` x `side` grid of two-way streets about 100m apart, with
+// lengths 1 to 3.
+static graph* grid_graph() {
+    graph* G = create_graph();
+    char key[16];
+    char other[16];
+    for (int i = 0; i < side * side; i++) {
+        snprintf(key, 16, "g%d", i);
+        add_node(G->N, new_node(key, new_gps(42.0f + (i / side) * 0.0009f,
+                                             -83.0f + (i % side) * 0.0012f)));
+    }
+    for (int i = 0; i < side * side; i++) {
+        const int next[2] = {i % side + 1 < side ? i + 1 : -1, i + side < side * side ? i + side : -1};
+        for (int k = 0; k < 2; k++) {
+            if (next[k] < 0) {
+                continue;
+            }
+            snprintf(key, 16, "g%d", i);
+            snprintf(other, 16, "g%d", next[k]);
+            add_edge(G->E, key, new_neighbour(other, distance(1.0f + (i + k) % 3)));
+            add_edge(G->E, other, new_neighbour(key, distance(1.0f + (i + k) % 3)));
+        }
+    }
+    return G;
+}
+
+static void remove_parts(const int k) {
+    char path[96];
+    for (int i = 0; i < k; i++) {
+        snprintf(path, sizeof(path), "%s.%d", prefix, i);
+        unlink(path);
+    }
+}
+
+
+static char* test_partition() {
+    printf("*** test_partition\n");
+    graph* G = grid_graph();
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    const int ks[] = {2, 4, 5};
+    char* message = 0;
+    for (int i = 0; i < 3 && !message; i++) {
+        const int k = ks[i];
+        int* kd = gp_partition(g, k, 0);
+        int* refined = gp_partition(g, k, 8);
+        int sizes[5] = {0};
+        for (int v = 0; v < g->csr.n; v++) {
+            sizes[refined[v]]++;
+        }
+        for (int p = 0; p < k && !message; p++) {
+            if (sizes[p] > ceil((double)g->csr.n / k * (1 + GP_IMBALANCE))
+                    || sizes[p] < floor((double)g->csr.n / k * (1 - GP_IMBALANCE))) {
+                message = "error, unbalanced partition";
+            }
+        }
+        // Straight cuts across a grid: one or two lines of 40 two-way streets
+        const long cut = gp_edge_cut(&g->csr, refined);
+        if (!message && (cut > gp_edge_cut(&g->csr, kd) || cut > 4 * 2 * side)) {
+            message = "error, expecting a small edge cut";
+        }
+        free(kd);
+        free(refined);
+    }
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    return message;
+}
+
+
+static char* test_partition_unlocated() {
+    printf("*** test_partition_unlocated\n");
+    graph* G = grid_graph();
+    // A node hanging off the corner, and two linked only to each other
+    add_node(G->N, new_node("corner", NULL));
+    add_edge(G->E, "corner", new_neighbour("g0", distance(1)));
+    add_edge(G->E, "g0", new_neighbour("corner", distance(1)));
+    add_node(G->N, new_node("x", NULL));
+    add_node(G->N, new_node("y", NULL));
+    add_edge(G->E, "x", new_neighbour("y", distance(1)));
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    int* part = gp_partition(g, 4, 2);
+    for (int v = 0; v < g->csr.n; v++) {
+        mu_assert("error, vertex without a part", part[v] >= 0 && part[v] < 4);
+    }
+    mu_assert("error, expecting the corner's part",
+              part[gk_vertex(&g->csr, "corner")] == part[gk_vertex(&g->csr, "g0")]);
+    free(part);
+    // One part takes them all
+    part = gp_partition(g, 1, 0);
+    mu_assert("error, expecting one part", part[gk_vertex(&g->csr, "x")] == 0);
+    free(part);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    return 0;
+}
+
+
+static char* test_part_files() {
+    printf("*** test_part_files\n");
+    graph* G = grid_graph();
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    int* part = gp_partition(g, 3, 4);
+    mu_assert("error, write failed", gp_write(g, part, 3, prefix) == 0);
+    int n = 0;
+    int m = 0;
+    char path[96];
+    for (int i = 0; i < 3; i++) {
+        snprintf(path, sizeof(path), "%s.%d", prefix, i);
+        gp_part* p = gp_part_load(path);
+        mu_assert("error, part not loaded", p != NULL && p->id == i && p->k == 3);
+        mu_assert("error, expecting boundary nodes", p->num_boundary > 0);
+        for (int j = 0; j < p->n; j++) {
+            mu_assert("error, vertex in the wrong part", part[p->global_ids[j]] == i);
+            mu_assert("error, ids not sorted", j == 0 || p->global_ids[j - 1] < p->global_ids[j]);
+        }
+        for (int b = 0; b < p->num_boundary; b++) {
+            const int v = p->boundary[b];
+            int crosses = 0;
+            for (int e = p->offsets[v]; e < p->offsets[v + 1]; e++) {
+                crosses |= p->target_parts[e] != i;
+            }
+            mu_assert("error, boundary node without a cut edge", crosses);
+        }
+        n += p->n;
+        m += p->m;
+        gp_part_free(p);
+    }
+    mu_assert("error, vertices lost", n == g->csr.n && m == g->csr.m);
+
+    // A truncated file is refused
+    snprintf(path, sizeof(path), "%s.1", prefix);
+    mu_assert("error, truncate failed", truncate(path, 40) == 0);
+    printf("(expecting a truncated partition)\n");
+    mu_assert("error, truncated part loaded", gp_part_load(path) == NULL);
+    remove_parts(3);
+    free(part);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    return 0;
+}
+
+
+static char* test_cluster() {
+    printf("*** test_cluster\n");
+    graph* G = grid_graph();
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    float* expected = malloc(sizeof(float) * g->csr.n);
+    float* actual = malloc(sizeof(float) * g->csr.n);
+    int* expected_hops = malloc(sizeof(int) * g->csr.n);
+    int* hops = malloc(sizeof(int) * g->csr.n);
+    const int ks[] = {1, 4};
+    char* message = 0;
+    for (int i = 0; i < 2 && !message; i++) {
+        int* part = gp_partition(g, ks[i], 4);
+        gp_write(g, part, ks[i], prefix);
+        free(part);
+        gp_cluster* c = gp_cluster_start(prefix, ks[i]);
+        if (c == NULL) {
+            message = "error, cluster not started";
+            break;
+        }
+        for (int src = 0; src < g->csr.n && !message; src += 401) {
+            const int settled = gk_f32_dir_sssp(g, src, expected);
+            gk_bfs(&g->csr, src, expected_hops);
+            if (gp_cluster_sssp(c, src, actual) != settled
+                    || gp_cluster_bfs(c, src, hops) != settled) {
+                message = "error, reached count differs";
+            }
+            for (int v = 0; v < g->csr.n && !message; v++) {
+                if (actual[v] != expected[v] || hops[v] != expected_hops[v]) {
+                    message = "error, result differs from a single process";
+                }
+            }
+        }
+        if (ks[i] > 1 && c->supersteps <= 5) {
+            message = "error, expecting messages between parts";
+        }
+        gp_cluster_stop(c);
+        remove_parts(ks[i]);
+    }
+    printf("(expecting a missing partition)\n");
+    if (!message && gp_cluster_start(prefix, 2) != NULL) {
+        message = "error, cluster started without parts";
+    }
+    free(expected);
+    free(actual);
+    free(expected_hops);
+    free(hops);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    return message;
+}
+
+
+static char* all_tests() {
+    printf("*** Runnng all tests...\n");
+    mu_run_test(test_partition);
+    mu_run_test(test_partition_unlocated);
+    mu_run_test(test_part_files);
+    mu_run_test(test_cluster);
+    return 0;
+}
+
+
+int main() {
+    printf("*** Graph Partition Unit tests\n");
+    if (mkdtemp(dir) == NULL) {
+        return 1;
+    }
+    snprintf(prefix, sizeof(prefix), "%s/part", dir);
+    char* result = all_tests();
+    rmdir(dir);
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf("all tests passed\n");
+    }
+    printf("%d tests run\n", tests_run);
+    return result != 0;
+}
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../include/graph_elements.h"
+#include "../include/graph_kernels.h"
+#include "../include/graph_load.h"
+#include "../include/graph_server.h"
+#include "../include/hash_table.h"
+
+// MinUnit testing framework. http://www.jera.com/techinfo/jtns/jtn002.html
+#define mu_assert(message, test) do { if (!(test)) return message; } while (0)
+#define mu_run_test(test) do { char *message = test(); tests_run++; \
+                            if (message) return message; } while (0)
+#define strings_equal(a, b) strcmp(a, b) == 0
+
+
+int tests_run = 0;
+
+static char graph_path[] = "/tmp/graph_server_test_graph.XXXXXX";
+static char table_path[] = "/tmp/graph_server_test_table.XXXXXX";
+static char socket_path[64];
+
+
+static void write_file(char* path, const char* contents) {
+    const int fd = mkstemp(path);
+    FILE* out = fdopen(fd, "w");
+    fputs(contents, out);
+    fclose(out);
+}
+
+static int read_full(const int fd, void* buf, const size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        const ssize_t n = read(fd, (char*)buf + done, len - done);
+        if (n <= 0) {
+            return -1;
+        }
+        done += (size_t)n;
+    }
+    return 0;
+}
+
+// Read one response, leaving its payload NUL terminated in `payload`.
+static int read_response(const int fd, gs_header* h, char* payload) {
+    if (read_full(fd, h, sizeof(*h)) < 0 || read_full(fd, payload, h->len) < 0) {
+        return -1;
+    }
+    payload[h->len] = '\0';
+    return 0;
+}
+
+
+static char* test_load() {
+    printf("*** test_load\n");
+    write_file(graph_path,
+               "# a -> b -> c -> d, and a shortcut a -> c\n"
+               "node a 42.0 -83.0\nnode b 43.0 -83.0\nnode c 44.0 -83.0\nnode d 45.0 -83.0\n"
+               "\n"
+               "edge a b 1.5\nedge b c 2.25\nedge a c 4\nedge c d 1\n");
+    write_file(table_path, "cat dog\nlong a value with spaces\r\n# not a key\n");
+    graph* G = load_graph(graph_path);
+    mu_assert("error, graph not loaded", G != NULL && G->N->count == 4);
+    mu_assert("error, expecting 2 edges from a", find_neighbours(G->E, "a")->count == 2);
+    mu_assert("error, unexpected location", *find_node(G->N, "c")->location->lat == 44.0f);
+    delete_graph(G);
+    ht_hash_table* ht = load_table(table_path);
+    mu_assert("error, table not loaded", ht != NULL && ht->count == 2);
+    mu_assert("error, unexpected value", strings_equal(ht_search(ht, "long"), "a value with spaces"));
+    ht_del_hash_table(ht);
+
+    char bad_path[] = "/tmp/graph_server_test_bad.XXXXXX";
+    write_file(bad_path, "node a 42.0 -83.0\nedge a\n");
+    printf("(expecting a malformed line)\n");
+    mu_assert("error, malformed graph should fail", load_graph(bad_path) == NULL);
+    unlink(bad_path);
+    mu_assert("error, missing file should fail", load_table("/nonexistent/table") == NULL);
+    return 0;
+}
+
+
+static char* test_pipelined_requests() {
+    printf("*** test_pipelined_requests\n");
+    graph* G = load_graph(graph_path);
+    ht_hash_table* ht = load_table(table_path);
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    gs_server* s = gs_server_new(socket_path, ht, g);
+    mu_assert("error, server not created", s != NULL);
+    gs_server_start(s, 2);
+    const int fd = gs_connect(socket_path);
+    mu_assert("error, connect failed", fd >= 0);
+
+    // Every request in a single write
+    char buf[8 * (sizeof(gs_header) + GS_MAX_PAYLOAD)];
+    size_t len = 0;
+    len += gs_put_request(buf + len, 1, GS_GET, "cat", NULL);
+    len += gs_put_request(buf + len, 2, GS_GET, "cow", NULL);
+    len += gs_put_request(buf + len, 3, GS_NODE, "b", NULL);
+    len += gs_put_request(buf + len, 4, GS_ROUTE, "a", "d");
+    len += gs_put_request(buf + len, 5, GS_ROUTE, "d", "a");
+    len += gs_put_request(buf + len, 6, 99, "a", NULL);
+    mu_assert("error, write failed", write(fd, buf, len) == (ssize_t)len);
+
+    gs_header h;
+    char payload[GS_MAX_PAYLOAD + 1];
+    float f[2];
+    read_response(fd, &h, payload);
+    mu_assert("error, expecting value of cat", h.id == 1 && h.code == GS_OK
+              && strings_equal(payload, "dog"));
+    read_response(fd, &h, payload);
+    mu_assert("error, cow is not a key", h.id == 2 && h.code == GS_NOT_FOUND && h.len == 0);
+    read_response(fd, &h, payload);
+    memcpy(f, payload, sizeof(f));
+    mu_assert("error, unexpected location of b", h.id == 3 && h.code == GS_OK
+              && f[0] == 43.0f && f[1] == -83.0f);
+    read_response(fd, &h, payload);
+    memcpy(f, payload, sizeof(float));
+    mu_assert("error, a -> d should be 4.75", h.id == 4 && h.code == GS_OK && f[0] == 4.75f);
+    read_response(fd, &h, payload);
+    mu_assert("error, d -> a is unreachable", h.id == 5 && h.code == GS_NOT_FOUND);
+    read_response(fd, &h, payload);
+    mu_assert("error, unknown op", h.id == 6 && h.code == GS_BAD_REQUEST);
+
+    // A request split across writes is answered once complete
+    len = gs_put_request(buf, 7, GS_ROUTE, "b", "d");
+    mu_assert("error, write failed", write(fd, buf, 5) == 5);
+    usleep(10000);
+    mu_assert("error, write failed", write(fd, buf + 5, len - 5) == (ssize_t)len - 5);
+    read_response(fd, &h, payload);
+    memcpy(f, payload, sizeof(float));
+    mu_assert("error, b -> d should be 3.25", h.id == 7 && f[0] == 3.25f);
+
+    // Keys the server would refuse are not encoded
+    char long_key[GS_MAX_KEY + 2];
+    memset(long_key, 'k', GS_MAX_KEY + 1);
+    long_key[GS_MAX_KEY + 1] = '\0';
+    mu_assert("error, long key encoded", gs_put_request(buf, 8, GS_GET, long_key, NULL) == 0);
+    mu_assert("error, long key encoded", gs_put_request(buf, 8, GS_ROUTE, "a", long_key) == 0);
+    long_key[GS_MAX_KEY] = '\0';
+    mu_assert("error, longest key refused",
+              gs_put_request(buf, 8, GS_ROUTE, long_key, long_key)
+              == sizeof(gs_header) + GS_MAX_PAYLOAD);
+
+    // An oversized request drops the connection
+    gs_header bad = {GS_MAX_PAYLOAD + 1, 8, GS_GET, {0}};
+    mu_assert("error, write failed", write(fd, &bad, sizeof(bad)) == sizeof(bad));
+    mu_assert("error, connection should be closed", read(fd, buf, 1) == 0);
+    close(fd);
+
+    // Left open when the server goes away
+    mu_assert("error, connect failed", gs_connect(socket_path) >= 0);
+    gs_server_del(s);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    ht_del_hash_table(ht);
+    return 0;
+}
+
+
+static char* all_tests() {
+    printf("*** Runnng all tests...\n");
+    mu_run_test(test_load);
+    mu_run_test(test_pipelined_requests);
+    return 0;
+}
+
+
+int main() {
+    printf("*** Graph Server Unit tests\n");
+    snprintf(socket_path, sizeof(socket_path), "/tmp/graph_server_test.%d.sock", (int)getpid());
+    char* result = all_tests();
+    unlink(graph_path);
+    unlink(table_path);
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf("all tests passed\n");
+    }
+    printf("%d tests run\n", tests_run);
+    return result != 0;
+}
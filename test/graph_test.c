@@ -0,0 +1,716 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/graph_compressed.h"
+#include "../include/graph_elements.h"
+#include "../include/graph_isochrone.h"
+#include "../include/graph_kernels.h"
+#include "../include/graph_rank.h"
+#include "../include/graph_reorder.h"
+#include "../include/graph_updates.h"
+
+// MinUnit testing framework. http://www.jera.com/techinfo/jtns/jtn002.html
+#define mu_assert(message, test) do { if (!(test)) return message; } while (0)
+#define mu_run_test(test) do { char *message = test(); tests_run++; \
+                            if (message) return message; } while (0)
+#define strings_equal(a, b) strcmp(a, b) == 0
+
+
+int tests_run = 0;
+
+
+static float* distance(const float d) {
+    float* p = malloc(sizeof(float));
+    *p = d;
+    return p;
+}
+
+// a -> b (1.5), b -> c (2.25), a -> c (5, then replaced by 4),
+// c -> d (1) and an isolated e.
+static graph* small_graph() {
+    graph* G = create_graph();
+    const char* keys[] = {"a", "b", "c", "d", "e"};
+    for (int i = 0; i < 5; i++) {
+        add_node(G->N, new_node(keys[i], new_gps(42.0f + i, -83.0f)));
+    }
+    add_edge(G->E, "a", new_neighbour("b", distance(1.5f)));
+    add_edge(G->E, "b", new_neighbour("c", distance(2.25f)));
+    add_edge(G->E, "a", new_neighbour("c", distance(5.0f)));
+    add_edge(G->E, "a", new_neighbour("c", distance(4.0f)));
+    add_edge(G->E, "c", new_neighbour("d", distance(1.0f)));
+    return G;
+}
+
+
+static char* test_nodes_and_edges() {
+    printf("*** test_nodes_and_edges\n");
+    graph* G = small_graph();
+    mu_assert("error, expecting 5 nodes", G->N->count == 5);
+    node* n = find_node(G->N, "c");
+    mu_assert("error, node c not found", n && strings_equal(n->key, "c"));
+    mu_assert("error, unexpected location", *n->location->lat == 44.0f);
+    mu_assert("error, invalid key should return NULL", find_node(G->N, "z") == NULL);
+
+    neighbours* ns = find_neighbours(G->E, "a");
+    mu_assert("error, expecting 2 edges from a", ns && ns->count == 2);
+    neighbour* ac = find_neighbour(ns, "c");
+    mu_assert("error, edge a -> c not replaced", ac && *ac->distance == 4.0f);
+    mu_assert("error, e has no edges", find_neighbours(G->E, "e") == NULL);
+    delete_graph(G);
+    return 0;
+}
+
+
+static char* test_tables_resize() {
+    printf("*** test_tables_resize\n");
+    graph* G = create_graph();
+    for (int i = 0; i < 1000; i++) {
+        char key[16];
+        snprintf(key, 16, "n%d", i);
+        add_node(G->N, new_node(key, NULL));
+        add_edge(G->E, "hub", new_neighbour(key, distance(i)));
+    }
+    mu_assert("error, expecting 1000 nodes", G->N->count == 1000);
+    mu_assert("error, nodes table did not grow", G->N->size > 1000);
+    neighbours* ns = find_neighbours(G->E, "hub");
+    mu_assert("error, expecting 1000 edges", ns->count == 1000);
+    neighbour* n = find_neighbour(ns, "n999");
+    mu_assert("error, unexpected distance", n && *n->distance == 999.0f);
+    delete_graph(G);
+    return 0;
+}
+
+
+static char* test_csr_directed() {
+    printf("*** test_csr_directed\n");
+    graph* G = small_graph();
+    gk_u_dir_graph* g = gk_u_dir_build(G);
+    mu_assert("error, expecting 5 vertices", g->csr.n == 5);
+    mu_assert("error, expecting 4 edges", g->csr.m == 4);
+    const int a = gk_vertex(&g->csr, "a");
+    mu_assert("error, vertex maps to wrong node", strings_equal(g->csr.nodes[a]->key, "a"));
+    mu_assert("error, unknown key should be -1", gk_vertex(&g->csr, "z") == -1);
+
+    int hops[5];
+    mu_assert("error, expecting 4 reached", gk_u_dir_bfs(g, a, hops) == 4);
+    mu_assert("error, d is 2 hops from a", hops[gk_vertex(&g->csr, "d")] == 2);
+    mu_assert("error, e is unreachable", hops[gk_vertex(&g->csr, "e")] == -1);
+    mu_assert("error, edges point one way",
+              gk_u_dir_bfs(g, gk_vertex(&g->csr, "d"), hops) == 1);
+    gk_u_dir_free(g);
+    delete_graph(G);
+    return 0;
+}
+
+
+static char* test_csr_undirected() {
+    printf("*** test_csr_undirected\n");
+    graph* G = small_graph();
+    gk_u_undir_graph* g = gk_u_undir_build(G);
+    mu_assert("error, expecting 8 edges", g->csr.m == 8);
+    for (int v = 0; v < g->csr.n; v++) {
+        for (int e = g->csr.offsets[v] + 1; e < g->csr.offsets[v + 1]; e++) {
+            mu_assert("error, row not sorted", g->csr.targets[e - 1] < g->csr.targets[e]);
+        }
+    }
+    int hops[5];
+    mu_assert("error, expecting 4 reached",
+              gk_u_undir_bfs(g, gk_vertex(&g->csr, "d"), hops) == 4);
+    mu_assert("error, a is 2 hops from d", hops[gk_vertex(&g->csr, "a")] == 2);
+    gk_u_undir_free(g);
+    delete_graph(G);
+    return 0;
+}
+
+
+static char* test_sssp_float() {
+    printf("*** test_sssp_float\n");
+    graph* G = small_graph();
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    float dist[5];
+    const int settled = gk_f32_dir_sssp(g, gk_vertex(&g->csr, "a"), dist);
+    mu_assert("error, expecting 4 settled", settled == 4);
+    mu_assert("error, a -> c should be 3.75", dist[gk_vertex(&g->csr, "c")] == 3.75f);
+    mu_assert("error, a -> d should be 4.75", dist[gk_vertex(&g->csr, "d")] == 4.75f);
+    mu_assert("error, e is unreachable", isinf(dist[gk_vertex(&g->csr, "e")]));
+    gk_f32_dir_free(g);
+
+    // Negative and NaN distances are refused by the weighted variants
+    add_edge(G->E, "d", new_neighbour("e", distance(-1.0f)));
+    mu_assert("error, negative distance accepted", gk_f32_dir_build(G) == NULL);
+    mu_assert("error, negative distance accepted", gk_u32_undir_build(G) == NULL);
+    gk_u_dir_graph* u = gk_u_dir_build(G);
+    mu_assert("error, unweighted build should ignore distances", u != NULL && u->csr.m == 5);
+    gk_u_dir_free(u);
+    delete_graph(G);
+    G = small_graph();
+    add_edge(G->E, "d", new_neighbour("e", distance(NAN)));
+    mu_assert("error, NaN distance accepted", gk_f32_undir_build(G) == NULL);
+    delete_graph(G);
+    return 0;
+}
+
+
+static char* test_sssp_u32() {
+    printf("*** test_sssp_u32\n");
+    graph* G = small_graph();
+    gk_u32_undir_graph* g = gk_u32_undir_build(G);
+    uint64_t dist[5];
+    gk_u32_undir_sssp(g, gk_vertex(&g->csr, "d"), dist);
+    // Rounded weights: a-b 2, b-c 2, a-c 4, c-d 1
+    mu_assert("error, d -> a should be 5", dist[gk_vertex(&g->csr, "a")] == 5);
+    mu_assert("error, d -> b should be 3", dist[gk_vertex(&g->csr, "b")] == 3);
+    mu_assert("error, e is unreachable", dist[gk_vertex(&g->csr, "e")] == UINT64_MAX);
+    gk_u32_undir_free(g);
+    delete_graph(G);
+    return 0;
+}
+
+
+// `side` x `side` grid with unit streets to the right and below.
+static graph* grid_graph(const int side) {
+    graph* G = create_graph();
+    char key[16];
+    char other[16];
+    for (int i = 0; i < side * side; i++) {
+        snprintf(key, 16, "g%d", i);
+        add_node(G->N, new_node(key, new_gps(i / side, i % side)));
+    }
+    for (int i = 0; i < side * side; i++) {
+        snprintf(key, 16, "g%d", i);
+        if (i % side + 1 < side) {
+            snprintf(other, 16, "g%d", i + 1);
+            add_edge(G->E, key, new_neighbour(other, distance(1.0f)));
+        }
+        if (i + side < side * side) {
+            snprintf(other, 16, "g%d", i + side);
+            add_edge(G->E, key, new_neighbour(other, distance(2.0f)));
+        }
+    }
+    return G;
+}
+
+
+// Relabelled graphs must keep every key's distance from "g0".
+static char* check_reorder(int* (*order)(const gk_csr*)) {
+    graph* G = grid_graph(20);
+    gk_f32_undir_graph* g = gk_f32_undir_build(G);
+    float before[400];
+    float after[400];
+    gk_f32_undir_sssp(g, gk_vertex(&g->csr, "g0"), before);
+    float* by_key = malloc(sizeof(float) * 400);
+    for (int i = 0; i < 400; i++) {
+        char key[16];
+        snprintf(key, 16, "g%d", i);
+        by_key[i] = before[gk_vertex(&g->csr, key)];
+    }
+    const double bandwidth = gk_bandwidth(&g->csr);
+
+    int* perm = order(&g->csr);
+    char seen[400] = {0};
+    for (int v = 0; v < 400; v++) {
+        mu_assert("error, not a permutation", perm[v] >= 0 && perm[v] < 400 && !seen[perm[v]]);
+        seen[perm[v]] = 1;
+    }
+    gk_permute(&g->csr, g->weights, sizeof(float), perm);
+    mu_assert("error, order did not reduce bandwidth", gk_bandwidth(&g->csr) < bandwidth);
+    gk_f32_undir_sssp(g, gk_vertex(&g->csr, "g0"), after);
+    for (int i = 0; i < 400; i++) {
+        char key[16];
+        snprintf(key, 16, "g%d", i);
+        const int v = gk_vertex(&g->csr, key);
+        mu_assert("error, node moved without its id", strings_equal(g->csr.nodes[v]->key, key));
+        mu_assert("error, distance changed by relabelling", after[v] == by_key[i]);
+    }
+    free(by_key);
+    free(perm);
+    gk_f32_undir_free(g);
+    delete_graph(G);
+    return 0;
+}
+
+static char* test_reorder_hilbert() {
+    printf("*** test_reorder_hilbert\n");
+    return check_reorder(gk_order_hilbert);
+}
+
+static char* test_reorder_rcm() {
+    printf("*** test_reorder_rcm\n");
+    return check_reorder(gk_order_rcm);
+}
+
+
+static char* test_live_updates() {
+    printf("*** test_live_updates\n");
+    graph* G = small_graph();
+    gu_graph* gu = gu_new(gk_f32_dir_build(G), 4);
+    const int reader = gu_register_reader(gu);
+    const int a = gk_vertex(&gu->topology, "a");
+    const int d = gk_vertex(&gu->topology, "d");
+    float dist[5];
+
+    // An open snapshot keeps its weights while updates are applied
+    const gk_f32_dir_graph* before = gu_read_begin(gu, reader);
+    mu_assert("error, enqueue failed", gu_enqueue_keys(gu, "a", "c", 1.0f) == 0);
+    mu_assert("error, unknown edge should still queue", gu_enqueue_keys(gu, "d", "a", 1.0f) == 0);
+    mu_assert("error, unknown node should fail", gu_enqueue_keys(gu, "z", "a", 1.0f) == -1);
+    mu_assert("error, negative weight should fail", gu_enqueue_keys(gu, "a", "c", -1.0f) == -1);
+    mu_assert("error, NaN weight should fail", gu_enqueue(gu, a, d, NAN) == -1);
+    mu_assert("error, expecting 2 drained", gu_apply(gu, 16) == 2);
+    mu_assert("error, expecting 1 applied, 1 dropped", gu->applied == 1 && gu->dropped == 1);
+    gk_f32_dir_sssp(before, a, dist);
+    mu_assert("error, snapshot changed under reader", dist[d] == 4.75f);
+    mu_assert("error, version reclaimed while read", gu->reclaimed == 0);
+    gu_read_end(gu, reader);
+
+    const gk_f32_dir_graph* after = gu_read_begin(gu, reader);
+    gk_f32_dir_sssp(after, a, dist);
+    mu_assert("error, update not visible", dist[d] == 2.0f);
+    gu_read_end(gu, reader);
+    gu_apply(gu, 16);
+    mu_assert("error, old version not reclaimed", gu->reclaimed == 1);
+
+    // The queue is bounded
+    for (int i = 0; i < 4; i++) {
+        mu_assert("error, enqueue failed", gu_enqueue(gu, a, d, 1.0f) == 0);
+    }
+    mu_assert("error, full queue should fail", gu_enqueue(gu, a, d, 1.0f) == -1);
+
+    // Registering past the last slot fails without counting a reader
+    for (int i = 1; i < GU_MAX_READERS; i++) {
+        mu_assert("error, registration failed", gu_register_reader(gu) == i);
+    }
+    mu_assert("error, expecting no slot left", gu_register_reader(gu) == -1);
+    mu_assert("error, expecting no slot left", gu_register_reader(gu) == -1);
+    mu_assert("error, readers overcounted", atomic_load(&gu->num_readers) == GU_MAX_READERS);
+    gu_apply(gu, 16);
+    gu_del(gu);
+    delete_graph(G);
+    return 0;
+}
+
+
+// Every row of `g` must decode to the targets and, within rounding, the
+// weights of `csr`.
+static char* check_rows(const gc_graph* g, const gk_csr* csr, const float* weights) {
+    gc_iter it;
+    int target;
+    float weight;
+    for (int v = 0; v < csr->n; v++) {
+        const int degree = csr->offsets[v + 1] - csr->offsets[v];
+        mu_assert("error, wrong degree", gc_degree(g, v) == degree);
+        gc_neighbours(g, v, &it);
+        for (int e = csr->offsets[v]; e < csr->offsets[v + 1]; e++) {
+            mu_assert("error, row ended early", gc_next(&it, &target, &weight));
+            mu_assert("error, wrong target", target == csr->targets[e]);
+            const float expected = weights != NULL ? weights[e] : 1.0f;
+            mu_assert("error, weight off by more than rounding",
+                      fabsf(weight - expected) <= g->weight_scale / 2);
+        }
+        mu_assert("error, row too long", !gc_next(&it, &target, &weight));
+    }
+    return 0;
+}
+
+static char* test_compressed() {
+    printf("*** test_compressed\n");
+    graph* G = grid_graph(20);
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    int* perm = gk_order_hilbert(&g->csr);
+    gk_permute(&g->csr, g->weights, sizeof(float), perm);
+    gc_graph* c = gc_build(&g->csr, g->weights);
+    char* message = check_rows(c, &g->csr, g->weights);
+    if (message) {
+        return message;
+    }
+    mu_assert("error, larger than the CSR",
+              gc_bytes(c) < (size_t)(c->n + 1) * sizeof(int) + (size_t)c->m * 2 * sizeof(float));
+
+    const int src = gc_vertex(c, "g0");
+    int hops[400];
+    int expected_hops[400];
+    float dist[400];
+    float expected_dist[400];
+    mu_assert("error, expecting 400 reached", gc_bfs(c, src, hops) == 400);
+    gk_f32_dir_bfs(g, src, expected_hops);
+    gk_f32_dir_sssp(g, src, expected_dist);
+    mu_assert("error, expecting 400 settled", gc_sssp(c, src, dist) == 400);
+    for (int v = 0; v < 400; v++) {
+        mu_assert("error, hops differ", hops[v] == expected_hops[v]);
+        mu_assert("error, distance differs", fabsf(dist[v] - expected_dist[v]) < 0.01f);
+    }
+    gc_free(c);
+
+    c = gc_build(&g->csr, NULL);
+    message = check_rows(c, &g->csr, NULL);
+    if (message) {
+        return message;
+    }
+    gc_sssp(c, src, dist);
+    mu_assert("error, unweighted distance should be hops", dist[gc_vertex(c, "g399")] == 38);
+    gc_free(c);
+    free(perm);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    return 0;
+}
+
+// Gaps of one, two and three bytes, backwards first gaps, empty rows
+// and rows ending mid block.
+static char* test_compressed_gaps() {
+    printf("*** test_compressed_gaps\n");
+    const int n = 70000;
+    gk_csr csr;
+    csr.n = n;
+    csr.N = create_nodes();
+    csr.nodes = calloc(n, sizeof(node*));
+    csr.bucket_ids = malloc(sizeof(int) * csr.N->size);
+    csr.offsets = calloc(n + 1, sizeof(int));
+    int targets[] = {1, 2, 300, 301, 69999, 0, 5, 68000, 69998};
+    csr.targets = targets;
+    csr.m = 9;
+    for (int v = 0; v <= n; v++) {
+        csr.offsets[v] = v == 0 ? 0 : v < 12 ? 5 : v < n ? 7 : 9;
+    }
+    float weights[] = {0, 1, 2, 3, 4, 5, 6, 7, 100};
+    gc_graph* c = gc_build(&csr, weights);
+    char* message = check_rows(c, &csr, weights);
+    mu_assert("error, degree of an empty row", gc_degree(c, 5) == 0);
+    gc_free(c);
+    free(csr.offsets);
+    free(csr.bucket_ids);
+    free(csr.nodes);
+    delete_nodes(csr.N);
+    return message;
+}
+
+
+static char* test_delta_stepping() {
+    printf("*** test_delta_stepping\n");
+    graph* G = small_graph();
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    gi_searcher* s = gi_new(g, 0, 2);
+    float dist[5];
+    mu_assert("error, expecting 4 reached", gi_sssp(s, gk_vertex(&g->csr, "a"), dist) == 4);
+    mu_assert("error, a -> d should be 4.75", dist[gk_vertex(&g->csr, "d")] == 4.75f);
+    mu_assert("error, e is unreachable", isinf(dist[gk_vertex(&g->csr, "e")]));
+    gi_del(s);
+    // Distances billions of widths away share the last bucket
+    s = gi_new(g, 1e-9f, 2);
+    mu_assert("error, expecting 4 reached", gi_sssp(s, gk_vertex(&g->csr, "a"), dist) == 4);
+    mu_assert("error, a -> d should be 4.75", dist[gk_vertex(&g->csr, "d")] == 4.75f);
+    gi_del(s);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+
+    // Every delta and thread count agrees with Dijkstra
+    G = grid_graph(30);
+    g = gk_f32_dir_build(G);
+    float* expected = malloc(sizeof(float) * g->csr.n);
+    float* actual = malloc(sizeof(float) * g->csr.n);
+    const float deltas[] = {0, 0.5f, 7.0f};
+    const int threads[] = {1, 4};
+    char* message = 0;
+    for (int d = 0; d < 3 && !message; d++) {
+        for (int t = 0; t < 2 && !message; t++) {
+            s = gi_new(g, deltas[d], threads[t]);
+            for (int src = 0; src < g->csr.n && !message; src += 97) {
+                const int settled = gk_f32_dir_sssp(g, src, expected);
+                if (gi_sssp(s, src, actual) != settled) {
+                    message = "error, reached count differs from Dijkstra";
+                }
+                for (int v = 0; v < g->csr.n && !message; v++) {
+                    if (actual[v] != expected[v]) {
+                        message = "error, distance differs from Dijkstra";
+                    }
+                }
+            }
+            gi_del(s);
+        }
+    }
+    free(expected);
+    free(actual);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    return message;
+}
+
+
+static char* test_isochrone() {
+    printf("*** test_isochrone\n");
+    // Unit streets to the right, 2 downwards: within 3 of the corner are
+    // 4 nodes of the first row and 2 of the second
+    graph* G = grid_graph(10);
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    gi_searcher* s = gi_new(g, 0, 3);
+    gi_area iso;
+    for (int round = 0; round < 2; round++) {
+        const int count = gi_isochrone(s, gk_vertex(&g->csr, "g0"), 3, &iso);
+        mu_assert("error, expecting 6 nodes", count == 6 && iso.count == 6);
+        float sum = 0;
+        for (int i = 0; i < iso.count; i++) {
+            sum += iso.dist[i];
+            mu_assert("error, node past the budget", iso.dist[i] <= 3);
+        }
+        mu_assert("error, unexpected distances", sum == 0 + 1 + 2 + 3 + 2 + 3);
+        mu_assert("error, unexpected bounding box", iso.min_lat == 0 && iso.max_lat == 1
+                  && iso.min_lon == 0 && iso.max_lon == 3);
+        gi_area_free(&iso);
+    }
+    // Nothing leaves the far corner
+    gi_isochrone(s, gk_vertex(&g->csr, "g99"), 100, &iso);
+    mu_assert("error, expecting only the source", iso.count == 1 && iso.dist[0] == 0);
+    gi_area_free(&iso);
+    gi_del(s);
+    gk_f32_dir_free(g);
+
+    // Nodes without a location are reached but stay out of the box
+    add_node(G->N, new_node("nowhere", NULL));
+    add_edge(G->E, "g0", new_neighbour("nowhere", distance(1)));
+    add_edge(G->E, "nowhere", new_neighbour("g0", distance(1)));
+    g = gk_f32_dir_build(G);
+    s = gi_new(g, 0, 2);
+    mu_assert("error, expecting 7 nodes", gi_isochrone(s, gk_vertex(&g->csr, "g0"), 3, &iso) == 7);
+    mu_assert("error, unexpected bounding box", iso.min_lat == 0 && iso.max_lat == 1
+              && iso.min_lon == 0 && iso.max_lon == 3);
+    gi_area_free(&iso);
+    gi_isochrone(s, gk_vertex(&g->csr, "nowhere"), 0, &iso);
+    mu_assert("error, expecting an empty box", iso.count == 1 && isinf(iso.min_lat));
+    gi_area_free(&iso);
+    gi_del(s);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    return 0;
+}
+
+
+// Power iteration in doubles, with dangling vertices spreading their
+// rank evenly.
+static void pagerank_reference(const gk_csr* csr, double* expected) {
+    const int n = csr->n;
+    double* next = malloc(sizeof(double) * n);
+    for (int v = 0; v < n; v++) {
+        expected[v] = 1.0 / n;
+    }
+    for (int it = 0; it < 200; it++) {
+        double dangling = 0;
+        for (int v = 0; v < n; v++) {
+            next[v] = 0;
+            dangling += csr->offsets[v + 1] == csr->offsets[v] ? expected[v] : 0;
+        }
+        for (int u = 0; u < n; u++) {
+            const int degree = csr->offsets[u + 1] - csr->offsets[u];
+            for (int e = csr->offsets[u]; e < csr->offsets[u + 1]; e++) {
+                next[csr->targets[e]] += expected[u] / degree;
+            }
+        }
+        for (int v = 0; v < n; v++) {
+            expected[v] = (1 - GR_DAMPING + GR_DAMPING * dangling) / n + GR_DAMPING * next[v];
+        }
+    }
+    free(next);
+}
+
+static char* test_pagerank() {
+    printf("*** test_pagerank\n");
+    // Against the reference, with d and e dangling
+    graph* G = small_graph();
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    const int n = g->csr.n;
+    double expected[5];
+    pagerank_reference(&g->csr, expected);
+    float rank[5];
+    for (int threads = 1; threads <= 3; threads += 2) {
+        gr_ranker* r = gr_new(&g->csr, g->weights, threads);
+        const int iterations = gr_pagerank(r, 0, 0, 100, rank);
+        mu_assert("error, expecting convergence", iterations < 100 && r->delta < GR_TOLERANCE);
+        float sum = 0;
+        for (int v = 0; v < n; v++) {
+            mu_assert("error, rank differs", fabs(rank[v] - expected[v]) < 1e-5);
+            sum += rank[v];
+        }
+        mu_assert("error, ranks should sum to 1", fabsf(sum - 1) < 1e-5f);
+        gr_del(r);
+    }
+    gk_f32_dir_free(g);
+    delete_graph(G);
+
+    // Hubs with 8 and 11 in-edges, summed 8 at a time in
+    // graph_avx2_test with the rest of the 11 left to the scalar tail
+    G = create_graph();
+    char keys[13][8];
+    for (int i = 0; i < 13; i++) {
+        snprintf(keys[i], 8, i < 11 ? "s%d" : "h%d", i < 11 ? i : i == 11 ? 8 : 11);
+        add_node(G->N, new_node(keys[i], new_gps(42.0f + i, -83.0f)));
+    }
+    for (int i = 0; i < 11; i++) {
+        add_edge(G->E, keys[i], new_neighbour("h11", distance(1.0f)));
+        if (i < 8) {
+            add_edge(G->E, keys[i], new_neighbour("h8", distance(1.0f)));
+        }
+    }
+    add_edge(G->E, "h11", new_neighbour("s0", distance(1.0f)));
+    add_edge(G->E, "h8", new_neighbour("s9", distance(1.0f)));
+    add_edge(G->E, "h8", new_neighbour("s10", distance(1.0f)));
+    g = gk_f32_dir_build(G);
+    double hub_expected[13];
+    float hub_rank[13];
+    pagerank_reference(&g->csr, hub_expected);
+    gr_ranker* r = gr_new(&g->csr, g->weights, 1);
+    gr_pagerank(r, 0, 0, 100, hub_rank);
+    const int h11 = gk_vertex(&g->csr, "h11");
+    mu_assert("error, expecting 11 in-edges at the hub",
+              r->in_offsets[h11 + 1] - r->in_offsets[h11] == 11);
+    gr_del(r);
+    for (int v = 0; v < g->csr.n; v++) {
+        mu_assert("error, hub rank differs", fabs(hub_rank[v] - hub_expected[v]) < 1e-5);
+    }
+    gk_f32_dir_free(g);
+    delete_graph(G);
+
+    // Thread count only changes who computes each vertex
+    G = grid_graph(30);
+    g = gk_f32_dir_build(G);
+    float* serial = malloc(sizeof(float) * g->csr.n);
+    float* parallel = malloc(sizeof(float) * g->csr.n);
+    r = gr_new(&g->csr, g->weights, 1);
+    gr_pagerank(r, 0, 0, 100, serial);
+    gr_del(r);
+    r = gr_new(&g->csr, g->weights, 4);
+    gr_pagerank(r, 0, 0, 100, parallel);
+    char* message = 0;
+    for (int v = 0; v < g->csr.n && !message; v++) {
+        if (fabsf(serial[v] - parallel[v]) > 1e-6f * serial[v]) {
+            message = "error, ranks differ between thread counts";
+        }
+    }
+    gr_del(r);
+    free(serial);
+    free(parallel);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    return message;
+}
+
+
+static char* test_betweenness() {
+    printf("*** test_betweenness\n");
+    // Two-way path p0 - p4: the middle lies on 8 of the ordered pairs
+    graph* G = create_graph();
+    char key[16];
+    char other[16];
+    for (int i = 0; i < 5; i++) {
+        snprintf(key, 16, "p%d", i);
+        add_node(G->N, new_node(key, new_gps(0, i)));
+    }
+    for (int i = 0; i + 1 < 5; i++) {
+        snprintf(key, 16, "p%d", i);
+        snprintf(other, 16, "p%d", i + 1);
+        add_edge(G->E, key, new_neighbour(other, distance(1.0f)));
+        add_edge(G->E, other, new_neighbour(key, distance(1.0f)));
+    }
+    gk_f32_dir_graph* g = gk_f32_dir_build(G);
+    gr_ranker* r = gr_new(&g->csr, g->weights, 2);
+    float scores[5];
+    gr_betweenness(r, 0, 1, scores, NULL);
+    const float path[] = {0, 6, 8, 6, 0};
+    for (int i = 0; i < 5; i++) {
+        snprintf(key, 16, "p%d", i);
+        mu_assert("error, wrong path betweenness", scores[gk_vertex(&g->csr, key)] == path[i]);
+    }
+    gr_del(r);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+
+    // Diamond s -> x, y -> t: the two ways split s -> t evenly
+    G = create_graph();
+    const char* keys[] = {"s", "x", "y", "t"};
+    for (int i = 0; i < 4; i++) {
+        add_node(G->N, new_node(keys[i], new_gps(i, 0)));
+    }
+    add_edge(G->E, "s", new_neighbour("x", distance(1.0f)));
+    add_edge(G->E, "s", new_neighbour("y", distance(1.0f)));
+    add_edge(G->E, "x", new_neighbour("t", distance(1.0f)));
+    add_edge(G->E, "y", new_neighbour("t", distance(1.0f)));
+    g = gk_f32_dir_build(G);
+    r = gr_new(&g->csr, g->weights, 1);
+    float edges[4];
+    gr_betweenness(r, 0, 1, scores, edges);
+    mu_assert("error, x should carry half", scores[gk_vertex(&g->csr, "x")] == 0.5f);
+    mu_assert("error, y should carry half", scores[gk_vertex(&g->csr, "y")] == 0.5f);
+    for (int e = 0; e < 4; e++) {
+        mu_assert("error, every edge carries its own pair and half of s -> t", edges[e] == 1.5f);
+    }
+    gr_del(r);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+
+    // Sampling a third of the sources estimates the total
+    G = grid_graph(30);
+    g = gk_f32_dir_build(G);
+    float* exact = malloc(sizeof(float) * g->csr.n);
+    float* parallel = malloc(sizeof(float) * g->csr.n);
+    float* sampled = malloc(sizeof(float) * g->csr.n);
+    r = gr_new(&g->csr, g->weights, 1);
+    gr_betweenness(r, 0, 1, exact, NULL);
+    gr_del(r);
+    r = gr_new(&g->csr, g->weights, 3);
+    gr_betweenness(r, 0, 1, parallel, NULL);
+    gr_betweenness(r, g->csr.n / 3, 7, sampled, NULL);
+    double exact_sum = 0;
+    double sampled_sum = 0;
+    char* message = 0;
+    for (int v = 0; v < g->csr.n && !message; v++) {
+        if (fabsf(exact[v] - parallel[v]) > 1e-4f * exact[v]) {
+            message = "error, scores differ between thread counts";
+        }
+        exact_sum += exact[v];
+        sampled_sum += sampled[v];
+    }
+    if (!message && fabs(sampled_sum - exact_sum) > 0.2 * exact_sum) {
+        message = "error, sampled estimate too far off";
+    }
+    gr_del(r);
+    free(exact);
+    free(parallel);
+    free(sampled);
+    gk_f32_dir_free(g);
+    delete_graph(G);
+    return message;
+}
+
+
+static char* all_tests() {
+    printf("*** Runnng all tests...\n");
+    mu_run_test(test_nodes_and_edges);
+    mu_run_test(test_tables_resize);
+    mu_run_test(test_csr_directed);
+    mu_run_test(test_csr_undirected);
+    mu_run_test(test_sssp_float);
+    mu_run_test(test_sssp_u32);
+    mu_run_test(test_reorder_hilbert);
+    mu_run_test(test_reorder_rcm);
+    mu_run_test(test_live_updates);
+    mu_run_test(test_compressed);
+    mu_run_test(test_compressed_gaps);
+    mu_run_test(test_delta_stepping);
+    mu_run_test(test_isochrone);
+    mu_run_test(test_pagerank);
+    mu_run_test(test_betweenness);
+    return 0;
+}
+
+
+int main() {
+    printf("*** Graph Unit tests\n");
+    char* result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf("all tests passed\n");
+    }
+    printf("%d tests run\n", tests_run);
+    return result != 0;
+}
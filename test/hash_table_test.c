@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "../include/hash_table.h"
+#include "../include/xmalloc.h"
 
 // MinUnit testing framework. http://www.jera.com/techinfo/jtns/jtn002.html
 #define mu_assert(message, test) do { if (!(test)) return message; } while (0)
@@ -169,6 +171,362 @@ static char* test_resize_down() {
 }
 
 
+static char* test_delete_past_deleted_bucket() {
+    printf("*** test_delete_past_deleted_bucket\n");
+    // "bz" and "4" collide, so "4" sits behind "bz" in the chain.
+    ht_hash_table* ht = ht_new();
+    ht_insert(ht, "bz", "bz value");
+    ht_insert(ht, "4", "4 value");
+    ht_delete(ht, "bz");
+    ht_delete(ht, "4");
+    mu_assert("error, value != NULL", ht_search(ht, "4") == NULL);
+    mu_assert("error, expecting ht->count == 0", ht->count == 0);
+    ht_delete(ht, "missing");
+    mu_assert("error, missing key changed count", ht->count == 0);
+    ht_del_hash_table(ht);
+    return 0;
+}
+
+
+static char* test_long_keys() {
+    printf("*** test_long_keys\n");
+    ht_hash_table* ht = ht_new();
+    for (int i = 0; i < 1000; i++) {
+        char key[64];
+        snprintf(key, 64, "a rather long key to hash number %d", i);
+        ht_insert(ht, key, "value");
+    }
+    mu_assert("error, expecting ht->count == 1000", ht->count == 1000);
+    char* value = ht_search(ht, "a rather long key to hash number 999");
+    mu_assert("error, unexpected value", value && strings_equal(value, "value"));
+    ht_del_hash_table(ht);
+    return 0;
+}
+
+
+static char* test_inline_and_heap_strings() {
+    printf("*** test_inline_and_heap_strings\n");
+    ht_hash_table* ht = ht_new();
+    const char* long_key = "a key well beyond the inline buffer";
+    const char* long_value = "a value well beyond the inline buffer";
+    ht_insert(ht, "short", long_value);
+    ht_insert(ht, long_key, "v");
+    ht_insert(ht, "shorter", "v2");
+
+    mu_assert("error, unexpected value",
+              strings_equal(ht_search(ht, "short"), long_value));
+    mu_assert("error, unexpected value", strings_equal(ht_search(ht, long_key), "v"));
+    mu_assert("error, prefix should not match", ht_search(ht, "shor") == NULL);
+    for (int i = 0; i < ht->size; i++) {
+        ht_item* item = ht->items[i];
+        if (item != NULL && strings_equal(item->key, "short")) {
+            mu_assert("error, wrong length byte", item->key_len == 5);
+#if HT_INLINE_LEN > 0
+            mu_assert("error, short key not inline", item->key == item->inline_key);
+            mu_assert("error, long value not on heap", item->value != item->inline_value);
+#endif
+        }
+    }
+    ht_delete(ht, long_key);
+    mu_assert("error, value != NULL", ht_search(ht, long_key) == NULL);
+    ht_del_hash_table(ht);
+    return 0;
+}
+
+
+static char* test_probe_sequence() {
+    printf("*** test_probe_sequence\n");
+    int index;
+    int step;
+    ht_probe_start("some key", 101, &index, &step);
+    for (int attempt = 0; attempt < 300; attempt++) {
+        mu_assert("error, probe sequences differ", index == ht_hash("some key", 101, attempt));
+        index = ht_probe_next(index, step, 101);
+    }
+    return 0;
+}
+
+
+static char* test_filter() {
+    printf("*** test_filter\n");
+    ht_hash_table* ht = ht_new();
+    char key[16];
+    for (int i = 0; i < 20; i++) {
+        snprintf(key, 16, "k%d", i);
+        ht_insert(ht, key, "value");
+    }
+    ht_enable_filter(ht, 10);
+    // Keys inserted before and after enabling, across resizes
+    for (int i = 20; i < 5000; i++) {
+        snprintf(key, 16, "k%d", i);
+        ht_insert(ht, key, "value");
+    }
+    for (int i = 0; i < 5000; i++) {
+        snprintf(key, 16, "k%d", i);
+        mu_assert("error, filter lost a key", ht_search(ht, key) != NULL);
+    }
+    int false_positives = 0;
+    for (int i = 0; i < 10000; i++) {
+        snprintf(key, 16, "miss%d", i);
+        mu_assert("error, missing key found", ht_search(ht, key) == NULL);
+        false_positives += ht_filter_may_contain(ht->filter, ht_hash64(key));
+    }
+    mu_assert("error, expecting under 2% false positives", false_positives < 200);
+#ifdef HT_STATS
+    mu_assert("error, rejects not counted",
+              ht->stats.filter_rejects == (unsigned long)(10000 - false_positives));
+#endif
+    ht_delete(ht, "k7");
+    mu_assert("error, deleted key found", ht_search(ht, "k7") == NULL);
+    ht_insert(ht, "k7", "again");
+    mu_assert("error, reinserted key lost", strings_equal(ht_search(ht, "k7"), "again"));
+    ht_disable_filter(ht);
+    mu_assert("error, filter still enabled", ht->filter == NULL);
+    mu_assert("error, key lost without filter", ht_search(ht, "k4999") != NULL);
+    ht_del_hash_table(ht);
+    return 0;
+}
+
+
+static char* test_delete_churn() {
+    printf("*** test_delete_churn\n");
+    ht_hash_table* ht = ht_new();
+    char key[16];
+    // Tombstones alone never trigger a resize, so they must be reused
+    // or compacted before they fill the table
+    for (int i = 0; i < 10000; i++) {
+        snprintf(key, 16, "k%d", i);
+        ht_insert(ht, key, "value");
+        ht_delete(ht, key);
+        mu_assert("error, tombstones not compacted", ht->deleted * 100 / ht->size <= 71);
+    }
+    mu_assert("error, expecting empty table", ht->count == 0);
+    mu_assert("error, deleted key found", ht_search(ht, "k9999") == NULL);
+    ht_del_hash_table(ht);
+    return 0;
+}
+
+
+static char* test_large_buckets() {
+    printf("*** test_large_buckets\n");
+    // Every policy ends up with zeroed, writable memory, whatever the
+    // system supports
+    const int policies[][2] = {{XL_HUGE_THP, XL_NUMA_DEFAULT}, {XL_HUGE_TLB, XL_NUMA_LOCAL},
+                               {XL_HUGE_NONE, XL_NUMA_INTERLEAVE}};
+    xlarge_stats before;
+    xlarge_stats after;
+    for (int p = 0; p < 3; p++) {
+        xlarge_policy(policies[p][0], policies[p][1]);
+        xlarge_get_stats(&before);
+        const size_t count = (3 << 20) / sizeof(long);
+        long* a = xcalloc_large(count, sizeof(long));
+        xlarge_get_stats(&after);
+        mu_assert("error, expecting a mapping", after.mapped == before.mapped + 1);
+        mu_assert("error, mapping not whole huge pages", after.bytes - before.bytes == 4 << 20);
+        mu_assert("error, mapping not aligned", ((size_t)a & (XL_THRESHOLD - 1)) == 0);
+        for (size_t i = 0; i < count; i += 4096 / sizeof(long)) {
+            mu_assert("error, expecting zeroes", a[i] == 0);
+            a[i] = (long)i;
+        }
+        mu_assert("error, lost a write", a[count - 512] == (long)(count - 512));
+        xfree_large(a, count, sizeof(long));
+        xlarge_get_stats(&after);
+        mu_assert("error, mapping not released", after.bytes == before.bytes);
+    }
+    xlarge_policy(XL_HUGE_THP, XL_NUMA_DEFAULT);
+
+    // Small arrays stay on the heap
+    xlarge_get_stats(&before);
+    char* small = xcalloc_large(1000, 1);
+    xfree_large(small, 1000, 1);
+    xlarge_get_stats(&after);
+    mu_assert("error, small array mapped", after.mapped == before.mapped);
+
+    // A table growing past the threshold moves its buckets to mappings
+    ht_hash_table* ht = ht_new();
+    char key[16];
+    for (int i = 0; i < 300000; i++) {
+        snprintf(key, 16, "k%d", i);
+        ht_insert(ht, key, key);
+    }
+    xlarge_get_stats(&after);
+    mu_assert("error, expecting mapped buckets", after.mapped > before.mapped
+              && after.bytes >= (size_t)ht->size * sizeof(ht_item*));
+    for (int i = 0; i < 300000; i += 7) {
+        snprintf(key, 16, "k%d", i);
+        const char* value = ht_search(ht, key);
+        mu_assert("error, item lost in a resize", value != NULL && strcmp(value, key) == 0);
+    }
+    ht_del_hash_table(ht);
+    xlarge_get_stats(&after);
+    mu_assert("error, buckets not unmapped", after.bytes == before.bytes);
+    return 0;
+}
+
+
+static char* test_cache_eviction() {
+    printf("*** test_cache_eviction\n");
+    ht_hash_table* ht = ht_new();
+    ht_enable_cache(ht, 100, 0);
+    char key[16];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, 16, "k%d", i);
+        ht_insert(ht, key, "value");
+        mu_assert("error, entry budget exceeded", ht->count <= 100);
+    }
+    mu_assert("error, expecting a full cache", ht->count == 100);
+    mu_assert("error, expecting 900 evictions", ht->cache->evictions == 900);
+    mu_assert("error, last insert evicted", ht_search(ht, "k999") != NULL);
+    mu_assert("error, hit not counted", ht->cache->hits == 1);
+    ht_search(ht, "k0");
+    mu_assert("error, miss not counted", ht->cache->misses == 1);
+
+    // Replacing a value keeps the byte count exact
+    ht_enable_cache(ht, 100, 0);
+    const size_t bytes = ht->cache->bytes;
+    ht_insert(ht, "k999", "a value too long to be stored inline");
+    ht_insert(ht, "k999", "value");
+    mu_assert("error, bytes not accounted", ht->cache->bytes == bytes);
+    ht_del_hash_table(ht);
+
+    ht = ht_new();
+    ht_enable_cache(ht, 0, 4096);
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, 16, "k%d", i);
+        ht_insert(ht, key, "value");
+        mu_assert("error, byte budget exceeded", ht->cache->bytes <= 4096);
+    }
+    mu_assert("error, cache emptied", (size_t)ht->count > 4096 / (2 * sizeof(ht_item)));
+    ht_del_hash_table(ht);
+    return 0;
+}
+
+
+static char* test_cache_scan_resistance() {
+    printf("*** test_cache_scan_resistance\n");
+    ht_hash_table* ht = ht_new();
+    ht_enable_cache(ht, 100, 0);
+    char key[16];
+    for (int i = 0; i < 20; i++) {
+        snprintf(key, 16, "hot%d", i);
+        ht_insert(ht, key, "value");
+    }
+    // Each round scans more new keys than the cache has room for beside
+    // the hot ones, which would flush them from an LRU
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 20; i++) {
+            snprintf(key, 16, "hot%d", i);
+            mu_assert("error, hot key evicted by scan", ht_search(ht, key) != NULL);
+        }
+        for (int i = 0; i < 100; i++) {
+            snprintf(key, 16, "scan%d", round * 100 + i);
+            ht_insert(ht, key, "value");
+        }
+    }
+    ht_del_hash_table(ht);
+    return 0;
+}
+
+
+static char* test_cache_ttl() {
+    printf("*** test_cache_ttl\n");
+    ht_hash_table* ht = ht_new();
+    ht_enable_cache(ht, 0, 0);
+    ht_insert_ttl(ht, "short", "value", 20);
+    ht_insert_ttl(ht, "long", "value", 60000);
+    ht_insert(ht, "forever", "value");
+    mu_assert("error, expired too early", ht_search(ht, "short") != NULL);
+    usleep(40000);
+    mu_assert("error, expecting expiry", ht_search(ht, "short") == NULL);
+    mu_assert("error, expiry not counted", ht->cache->expirations == 1);
+    mu_assert("error, long ttl expired", ht_search(ht, "long") != NULL);
+    mu_assert("error, no ttl expired", ht_search(ht, "forever") != NULL);
+    // A plain insert clears the TTL of the key it replaces
+    ht_insert_ttl(ht, "short", "value", 20);
+    ht_insert(ht, "short", "value");
+    usleep(40000);
+    mu_assert("error, replaced ttl still applied", ht_search(ht, "short") != NULL);
+    mu_assert("error, expecting 3 items", ht->count == 3);
+    ht_del_hash_table(ht);
+    return 0;
+}
+
+
+#ifdef HT_STATS
+static char* test_stats() {
+    printf("*** test_stats\n");
+    ht_hash_table* ht = ht_new();
+    for (int i = 0; i < 39; i++) {
+        char key[10];
+        snprintf(key, 10, "%d", i);
+        ht_insert(ht, key, "value");
+    }
+    ht_search(ht, "0");
+    ht_search(ht, "missing");
+
+    unsigned long inserts = 0;
+    unsigned long searches = 0;
+    for (int b = 0; b < HT_STATS_PROBE_BINS; b++) {
+        inserts += ht->stats.insert_probes[b];
+        searches += ht->stats.search_probes[b];
+    }
+    mu_assert("error, expecting 39 recorded inserts", inserts == 39);
+    mu_assert("error, expecting 2 recorded searches", searches == 2);
+    mu_assert("error, expecting 1 resize", ht->stats.resizes == 1);
+    mu_assert("error, bytes not accounted", ht->stats.bytes > 101 * sizeof(ht_item*));
+    mu_assert("error, peak below current", ht->stats.peak_bytes >= ht->stats.bytes);
+
+    const unsigned long bytes = ht->stats.bytes;
+    ht_delete(ht, "0");
+    mu_assert("error, delete not accounted", ht->stats.bytes < bytes);
+
+    ht_stats_dump(ht, stdout);
+    ht_del_hash_table(ht);
+    return 0;
+}
+
+
+static char* test_churn_near_threshold() {
+    printf("*** test_churn_near_threshold\n");
+    // A full cache of 71 in 101 buckets leaves a tombstone per eviction,
+    // which must not rehash the table on nearly every insert
+    ht_hash_table* ht = ht_new();
+    ht_enable_cache(ht, 71, 0);
+    char key[16];
+    for (int i = 0; i < 71; i++) {
+        snprintf(key, 16, "k%d", i);
+        ht_insert(ht, key, "value");
+    }
+    unsigned long resizes = ht->stats.resizes;
+    for (int i = 0; i < 2000; i++) {
+        snprintf(key, 16, "n%d", i);
+        ht_insert(ht, key, "value");
+    }
+    mu_assert("error, expecting a full cache", ht->count == 71);
+    mu_assert("error, cache churn rehashes too often", ht->stats.resizes - resizes < 50);
+    ht_del_hash_table(ht);
+
+    // Likewise a plain table kept at 70 live items by delete and insert
+    ht = ht_new();
+    for (int i = 0; i < 70; i++) {
+        snprintf(key, 16, "%d", i);
+        ht_insert(ht, key, "value");
+    }
+    resizes = ht->stats.resizes;
+    for (int i = 70; i < 2070; i++) {
+        snprintf(key, 16, "%d", i - 70);
+        ht_delete(ht, key);
+        snprintf(key, 16, "%d", i);
+        ht_insert(ht, key, "value");
+    }
+    mu_assert("error, expecting 70 items", ht->count == 70);
+    mu_assert("error, churn rehashes too often", ht->stats.resizes - resizes < 50);
+    ht_del_hash_table(ht);
+    return 0;
+}
+#endif
+
+
 static char* all_tests() {
     printf("*** Runnng all tests...\n");
     mu_run_test(test_insert);
@@ -180,6 +538,20 @@ static char* all_tests() {
     mu_run_test(test_delete);
     mu_run_test(test_resize_up);
     mu_run_test(test_resize_down);
+    mu_run_test(test_delete_past_deleted_bucket);
+    mu_run_test(test_long_keys);
+    mu_run_test(test_inline_and_heap_strings);
+    mu_run_test(test_probe_sequence);
+    mu_run_test(test_filter);
+    mu_run_test(test_delete_churn);
+    mu_run_test(test_large_buckets);
+    mu_run_test(test_cache_eviction);
+    mu_run_test(test_cache_scan_resistance);
+    mu_run_test(test_cache_ttl);
+#ifdef HT_STATS
+    mu_run_test(test_stats);
+    mu_run_test(test_churn_near_threshold);
+#endif
     return 0;
 }
 
@@ -0,0 +1,269 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/hash_table.h"
+#include "../include/ht_hamt.h"
+
+// MinUnit testing framework. http://www.jera.com/techinfo/jtns/jtn002.html
+#define mu_assert(message, test) do { if (!(test)) return message; } while (0)
+#define mu_run_test(test) do { char *message = test(); tests_run++; \
+                            if (message) return message; } while (0)
+#define strings_equal(a, b) strcmp(a, b) == 0
+
+
+int tests_run = 0;
+
+
+static int value_is(const ht_hamt* h, const char* key, const char* value) {
+    const char* found = ht_hamt_search(h, key);
+    return value ? found && strings_equal(found, value) : found == NULL;
+}
+
+static void count_entry(const char* key, const char* value, void* arg) {
+    (void)key;
+    (void)value;
+    (*(int*)arg)++;
+}
+
+// Every entry of a version is in `ht`, with the same value.
+static void check_entry(const char* key, const char* value, void* arg) {
+    const char* expected = ht_search(arg, key);
+    if (!expected || strcmp(expected, value) != 0) {
+        fprintf(stderr, "entry %s=%s not expected\n", key, value);
+        exit(1);
+    }
+}
+
+static void copy_entry(const char* key, const char* value, void* arg) {
+    ht_insert(arg, key, value);
+}
+
+
+static char* test_insert_and_search() {
+    printf("*** test_insert_and_search\n");
+    ht_hamt* h = ht_hamt_new();
+    mu_assert("error, empty map finds a key", ht_hamt_search(h, "k") == NULL);
+    for (int i = 0; i < 20000; i++) {
+        char key[16];
+        snprintf(key, 16, "%d", i);
+        ht_hamt_insert(h, key, key);
+    }
+    mu_assert("error, expecting 20000 entries", h->count == 20000);
+    mu_assert("error, unexpected value", value_is(h, "4321", "4321"));
+    mu_assert("error, invalid key should return NULL", value_is(h, "invalid", NULL));
+
+    ht_hamt_insert(h, "4321", "a value long enough to need more room than the key");
+    mu_assert("error, update added an entry", h->count == 20000);
+    mu_assert("error, value not updated",
+              value_is(h, "4321", "a value long enough to need more room than the key"));
+
+    int visited = 0;
+    ht_hamt_foreach(h, count_entry, &visited);
+    mu_assert("error, foreach missed entries", visited == 20000);
+    ht_hamt_del(h);
+    return 0;
+}
+
+
+static char* test_delete() {
+    printf("*** test_delete\n");
+    ht_hamt* h = ht_hamt_new();
+    for (int i = 0; i < 5000; i++) {
+        char key[16];
+        snprintf(key, 16, "%d", i);
+        ht_hamt_insert(h, key, "value");
+    }
+    for (int i = 0; i < 5000; i += 2) {
+        char key[16];
+        snprintf(key, 16, "%d", i);
+        ht_hamt_delete(h, key);
+    }
+    ht_hamt_delete(h, "absent");
+    mu_assert("error, expecting 2500 entries", h->count == 2500);
+    for (int i = 0; i < 5000; i++) {
+        char key[16];
+        snprintf(key, 16, "%d", i);
+        mu_assert("error, wrong entry after delete", value_is(h, key, i % 2 ? "value" : NULL));
+    }
+    for (int i = 1; i < 5000; i += 2) {
+        char key[16];
+        snprintf(key, 16, "%d", i);
+        ht_hamt_delete(h, key);
+    }
+    mu_assert("error, expecting an empty map", h->count == 0 && h->root == NULL);
+    ht_hamt_insert(h, "k", "v");
+    mu_assert("error, reinsert failed", value_is(h, "k", "v") && h->count == 1);
+    ht_hamt_del(h);
+    return 0;
+}
+
+
+static char* test_snapshot() {
+    printf("*** test_snapshot\n");
+    ht_hamt* h = ht_hamt_new();
+    for (int i = 0; i < 5000; i++) {
+        char key[16];
+        snprintf(key, 16, "%d", i);
+        ht_hamt_insert(h, key, "old");
+    }
+    ht_hamt* snap = ht_hamt_snapshot(h);
+    mu_assert("error, snapshot copied the root", snap->root == h->root && snap->count == 5000);
+
+    // Updates, deletes and inserts after the snapshot don't show in it
+    for (int i = 0; i < 5000; i++) {
+        char key[16];
+        snprintf(key, 16, "%d", i);
+        if (i % 4 == 0) {
+            ht_hamt_delete(h, key);
+        } else if (i % 4 == 1) {
+            ht_hamt_insert(h, key, "new");
+        }
+        snprintf(key, 16, "n%d", i);
+        ht_hamt_insert(h, key, "new");
+    }
+    mu_assert("error, snapshot changed", snap->count == 5000);
+    for (int i = 0; i < 5000; i++) {
+        char key[16];
+        snprintf(key, 16, "%d", i);
+        mu_assert("error, snapshot changed", value_is(snap, key, "old"));
+        mu_assert("error, wrong value after snapshot",
+                  value_is(h, key, i % 4 == 0 ? NULL : i % 4 == 1 ? "new" : "old"));
+        snprintf(key, 16, "n%d", i);
+        mu_assert("error, insert leaked into snapshot", value_is(snap, key, NULL));
+    }
+    mu_assert("error, wrong count after snapshot", h->count == 8750);
+
+    // The snapshot outlives the version it was taken from
+    ht_hamt* later = ht_hamt_snapshot(h);
+    ht_hamt_rollback(h, snap);
+    mu_assert("error, rollback failed", h->count == 5000 && value_is(h, "0", "old")
+                                        && value_is(h, "n0", NULL));
+    ht_hamt_insert(h, "0", "rolled");
+    mu_assert("error, change after rollback leaked", value_is(snap, "0", "old")
+                                                     && value_is(later, "0", NULL));
+    ht_hamt_del(h);
+    ht_hamt_del(snap);
+    mu_assert("error, later snapshot damaged", later->count == 8750 && value_is(later, "1", "new")
+                                               && value_is(later, "n4999", "new"));
+    ht_hamt_del(later);
+    return 0;
+}
+
+
+static char* test_churn() {
+    printf("*** test_churn\n");
+    enum { num_snapshots = 4 };
+    ht_hamt* h = ht_hamt_new();
+    ht_hash_table* ref = ht_new();
+    ht_hamt* snaps[num_snapshots];
+    ht_hash_table* refs[num_snapshots];
+    uint64_t seed = 42;
+    for (int round = 0; round < num_snapshots; round++) {
+        for (int i = 0; i < 20000; i++) {
+            seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+            char key[16];
+            char value[16];
+            snprintf(key, 16, "%d", (int)((seed >> 33) % 5000));
+            snprintf(value, 16, "%d.%d", round, i);
+            if ((seed >> 20) % 3 == 0) {
+                ht_hamt_delete(h, key);
+                ht_delete(ref, key);
+            } else {
+                ht_hamt_insert(h, key, value);
+                ht_insert(ref, key, value);
+            }
+        }
+        snaps[round] = ht_hamt_snapshot(h);
+        refs[round] = ht_new();
+        ht_hamt_foreach(h, copy_entry, refs[round]);
+        mu_assert("error, count differs from table", h->count == ref->count);
+    }
+    ht_hamt_del(h);
+    for (int round = 0; round < num_snapshots; round++) {
+        int visited = 0;
+        ht_hamt_foreach(snaps[round], count_entry, &visited);
+        mu_assert("error, snapshot count differs",
+                  visited == refs[round]->count && snaps[round]->count == visited);
+        ht_hamt_foreach(snaps[round], check_entry, refs[round]);
+        ht_hamt_del(snaps[round]);
+        ht_del_hash_table(refs[round]);
+    }
+    ht_del_hash_table(ref);
+    return 0;
+}
+
+
+static ht_hamt* shared;
+
+static void* read_snapshot(void* arg) {
+    ht_hamt* snap = arg;
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 2000; i++) {
+            char key[16];
+            snprintf(key, 16, "%d", i);
+            if (!value_is(snap, key, "old")) {
+                return "snapshot changed under a reader";
+            }
+        }
+    }
+    ht_hamt_del(snap);
+    return NULL;
+}
+
+static char* test_snapshot_threads() {
+    printf("*** test_snapshot_threads\n");
+    shared = ht_hamt_new();
+    for (int i = 0; i < 2000; i++) {
+        char key[16];
+        snprintf(key, 16, "%d", i);
+        ht_hamt_insert(shared, key, "old");
+    }
+    // Readers release their snapshots while the writer keeps copying
+    pthread_t threads[2];
+    for (int t = 0; t < 2; t++) {
+        pthread_create(&threads[t], NULL, read_snapshot, ht_hamt_snapshot(shared));
+    }
+    for (int round = 0; round < 20; round++) {
+        for (int i = 0; i < 2000; i++) {
+            char key[16];
+            snprintf(key, 16, "%d", i);
+            ht_hamt_insert(shared, key, "new");
+        }
+    }
+    char* failure = NULL;
+    for (int t = 0; t < 2; t++) {
+        void* result;
+        pthread_join(threads[t], &result);
+        failure = result ? result : failure;
+    }
+    mu_assert("error, snapshot changed under a reader", failure == NULL);
+    mu_assert("error, writer lost updates", shared->count == 2000 && value_is(shared, "7", "new"));
+    ht_hamt_del(shared);
+    return 0;
+}
+
+
+static char* all_tests() {
+    printf("*** Runnng all tests...\n");
+    mu_run_test(test_insert_and_search);
+    mu_run_test(test_delete);
+    mu_run_test(test_snapshot);
+    mu_run_test(test_churn);
+    mu_run_test(test_snapshot_threads);
+    return 0;
+}
+
+
+int main() {
+    printf("*** Persistent Map Unit tests\n");
+    char* result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf("all tests passed\n");
+    }
+    printf("%d tests run\n", tests_run);
+    return result != 0;
+}
@@ -0,0 +1,129 @@
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../include/ht_sharded.h"
+
+// MinUnit testing framework. http://www.jera.com/techinfo/jtns/jtn002.html
+#define mu_assert(message, test) do { if (!(test)) return message; } while (0)
+#define mu_run_test(test) do { char *message = test(); tests_run++; \
+                            if (message) return message; } while (0)
+#define strings_equal(a, b) strcmp(a, b) == 0
+
+
+int tests_run = 0;
+
+
+static char* test_insert_and_search() {
+    printf("*** test_insert_and_search\n");
+    ht_sharded_table* sh = ht_sharded_new(3);
+    mu_assert("error, expecting 8 shards", sh->num_shards == 8);
+    for (int i = 0; i < 5000; i++) {
+        char key[16];
+        snprintf(key, 16, "%d", i);
+        ht_sharded_insert(sh, key, key);
+    }
+    mu_assert("error, expecting 5000 items", ht_sharded_count(sh) == 5000);
+    char* value = ht_sharded_search(sh, "4321");
+    mu_assert("error, unexpected value", value && strings_equal(value, "4321"));
+    free(value);
+    mu_assert("error, invalid key should return NULL",
+              ht_sharded_search(sh, "invalid") == NULL);
+    ht_sharded_del(sh);
+    return 0;
+}
+
+
+static char* test_shards_resize_independently() {
+    printf("*** test_shards_resize_independently\n");
+    ht_sharded_table* sh = ht_sharded_new(2);
+    int used = 0;
+    for (int i = 0; i < 2000; i++) {
+        char key[16];
+        snprintf(key, 16, "%d", i);
+        ht_sharded_insert(sh, key, "value");
+    }
+    for (int i = 0; i < sh->num_shards; i++) {
+        ht_hash_table* ht = sh->shards[i].table;
+        mu_assert("error, shard over its load limit", ht->count * 100 / ht->size <= 71);
+        if (ht->count > 0) {
+            used++;
+        }
+    }
+    mu_assert("error, keys not spread over shards", used == sh->num_shards);
+    ht_sharded_del(sh);
+    return 0;
+}
+
+
+static char* test_delete() {
+    printf("*** test_delete\n");
+    ht_sharded_table* sh = ht_sharded_new(4);
+    ht_sharded_insert(sh, "k", "v");
+    mu_assert("error, shard out of range",
+              ht_sharded_shard_of(sh, "k") >= 0 && ht_sharded_shard_of(sh, "k") < 16);
+    ht_sharded_delete(sh, "k");
+    mu_assert("error, value != NULL", ht_sharded_search(sh, "k") == NULL);
+    mu_assert("error, expecting count == 0", ht_sharded_count(sh) == 0);
+    ht_sharded_del(sh);
+    return 0;
+}
+
+
+static ht_sharded_table* shared;
+
+static void* insert_range(void* arg) {
+    const long base = (long)arg;
+    for (long i = base; i < base + 1000; i++) {
+        char key[16];
+        snprintf(key, 16, "%ld", i);
+        ht_sharded_insert(shared, key, "value");
+    }
+    return NULL;
+}
+
+static char* test_concurrent_inserts() {
+    printf("*** test_concurrent_inserts\n");
+    int cpus[] = {0};
+    shared = ht_sharded_new_affine(4, cpus, 1, 4000);
+    mu_assert("error, shard has no owner", shared->shards[5].cpu == 0);
+    mu_assert("error, shards not cache line aligned", (uintptr_t)shared->shards % 64 == 0);
+    // Each shard is presized for its share
+    mu_assert("error, shard not presized",
+              shared->shards[5].table->size * 70 / 100 >= 4000 / 16);
+    pthread_t threads[4];
+    for (long t = 0; t < 4; t++) {
+        pthread_create(&threads[t], NULL, insert_range, (void*)(t * 1000));
+    }
+    for (int t = 0; t < 4; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    mu_assert("error, expecting 4000 items", ht_sharded_count(shared) == 4000);
+    ht_sharded_del(shared);
+    return 0;
+}
+
+
+static char* all_tests() {
+    printf("*** Runnng all tests...\n");
+    mu_run_test(test_insert_and_search);
+    mu_run_test(test_shards_resize_independently);
+    mu_run_test(test_delete);
+    mu_run_test(test_concurrent_inserts);
+    return 0;
+}
+
+
+int main() {
+    printf("*** Sharded Hash Table Unit tests\n");
+    char* result = all_tests();
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf("all tests passed\n");
+    }
+    printf("%d tests run\n", tests_run);
+    return result != 0;
+}
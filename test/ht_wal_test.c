@@ -0,0 +1,232 @@
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../include/ht_wal.h"
+
+// MinUnit testing framework. http://www.jera.com/techinfo/jtns/jtn002.html
+#define mu_assert(message, test) do { if (!(test)) return message; } while (0)
+#define mu_run_test(test) do { char *message = test(); tests_run++; \
+                            if (message) return message; } while (0)
+#define strings_equal(a, b) strcmp(a, b) == 0
+
+
+int tests_run = 0;
+
+static char dir[] = "/tmp/ht_wal_test.XXXXXX";
+static char log_path[64];
+static char ckpt_path[64];
+
+
+static void remove_logs() {
+    unlink(log_path);
+    unlink(ckpt_path);
+}
+
+static long file_size(const char* path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+static int value_is(ht_wal* w, const char* key, const char* expected) {
+    char* value = ht_wal_search(w, key);
+    const int same = value != NULL && expected != NULL ? strings_equal(value, expected)
+                                                       : value == expected;
+    free(value);
+    return same;
+}
+
+
+static char* test_replay() {
+    printf("*** test_replay\n");
+    remove_logs();
+    ht_wal* w = ht_wal_open(log_path, 1, 0);
+    mu_assert("error, log not opened", w != NULL);
+    mu_assert("error, insert failed", ht_wal_insert(w, "a", "1") == 0);
+    ht_wal_insert(w, "b", "2");
+    ht_wal_insert(w, "a", "a value too long to be stored inline in an item");
+    ht_wal_delete(w, "b");
+    ht_wal_insert(w, "c", "");
+    ht_wal_close(w);
+
+    w = ht_wal_open(log_path, 1, 0);
+    mu_assert("error, log not reopened", w != NULL);
+    mu_assert("error, expecting 2 items", w->table->count == 2);
+    mu_assert("error, overwrite lost",
+              value_is(w, "a", "a value too long to be stored inline in an item"));
+    mu_assert("error, delete lost", value_is(w, "b", NULL));
+    mu_assert("error, empty value lost", value_is(w, "c", ""));
+    ht_wal_close(w);
+    return 0;
+}
+
+
+static char* test_torn_tail() {
+    printf("*** test_torn_tail\n");
+    remove_logs();
+    ht_wal* w = ht_wal_open(log_path, 1, 0);
+    ht_wal_insert(w, "kept", "value");
+    ht_wal_insert(w, "torn", "value");
+    ht_wal_close(w);
+    // Cut the last record short, as a crash mid-write would
+    const long size = file_size(log_path);
+    mu_assert("error, truncate failed", truncate(log_path, size - 3) == 0);
+
+    printf("(expecting a dropped tail)\n");
+    w = ht_wal_open(log_path, 1, 0);
+    mu_assert("error, log not reopened", w != NULL);
+    mu_assert("error, intact record lost", value_is(w, "kept", "value"));
+    mu_assert("error, torn record applied", value_is(w, "torn", NULL));
+    ht_wal_insert(w, "after", "value");
+    ht_wal_close(w);
+
+    w = ht_wal_open(log_path, 1, 0);
+    mu_assert("error, record after tail lost", value_is(w, "after", "value"));
+    mu_assert("error, expecting 2 items", w->table->count == 2);
+    ht_wal_close(w);
+
+    const int fd = open(log_path, O_WRONLY | O_TRUNC);
+    mu_assert("error, write failed", write(fd, "garbage!", 8) == 8);
+    close(fd);
+    printf("(expecting not a log)\n");
+    mu_assert("error, garbage should fail", ht_wal_open(log_path, 1, 0) == NULL);
+    return 0;
+}
+
+
+static char* test_checkpoint() {
+    printf("*** test_checkpoint\n");
+    remove_logs();
+    ht_wal* w = ht_wal_open(log_path, 1, 4096);
+    char key[16];
+    for (int i = 0; i < 1000; i++) {
+        snprintf(key, 16, "k%d", i);
+        ht_wal_insert(w, key, key);
+        mu_assert("error, log outgrew its budget", file_size(log_path) <= 4096 + 64);
+    }
+    for (int i = 0; i < 1000; i += 2) {
+        snprintf(key, 16, "k%d", i);
+        ht_wal_delete(w, key);
+    }
+    mu_assert("error, expecting checkpoints", w->checkpoints > 0);
+    ht_wal_close(w);
+
+    w = ht_wal_open(log_path, 1, 0);
+    mu_assert("error, expecting 500 items", w->table->count == 500);
+    mu_assert("error, checkpointed item lost", value_is(w, "k1", "k1"));
+    mu_assert("error, deleted item found", value_is(w, "k998", NULL));
+    // An explicit checkpoint leaves an empty log
+    mu_assert("error, checkpoint failed", ht_wal_checkpoint(w) == 0);
+    mu_assert("error, log not truncated", file_size(log_path) == 8);
+    ht_wal_close(w);
+    w = ht_wal_open(log_path, 1, 0);
+    mu_assert("error, expecting 500 items after checkpoint", w->table->count == 500);
+    ht_wal_close(w);
+
+    // A damaged checkpoint fails the open rather than losing the rest
+    // of the table at the next checkpoint
+    const int fd = open(ckpt_path, O_RDWR);
+    const off_t middle = file_size(ckpt_path) / 2;
+    char byte;
+    mu_assert("error, read failed", pread(fd, &byte, 1, middle) == 1);
+    byte ^= 0x20;
+    mu_assert("error, write failed", pwrite(fd, &byte, 1, middle) == 1);
+    close(fd);
+    printf("(expecting a corrupt checkpoint)\n");
+    mu_assert("error, corrupt checkpoint opened", ht_wal_open(log_path, 1, 0) == NULL);
+    return 0;
+}
+
+
+typedef struct {
+    ht_wal* w;
+    int id;
+} writer_args;
+
+static void* writer(void* arg) {
+    writer_args* a = arg;
+    char key[24];
+    for (int i = 0; i < 200; i++) {
+        snprintf(key, sizeof(key), "t%d:%d", a->id, i);
+        ht_wal_insert(a->w, key, "value");
+    }
+    return NULL;
+}
+
+static char* test_group_commit() {
+    printf("*** test_group_commit\n");
+    remove_logs();
+    ht_wal* w = ht_wal_open(log_path, 1, 0);
+    pthread_t threads[8];
+    writer_args args[8];
+    for (int i = 0; i < 8; i++) {
+        args[i].w = w;
+        args[i].id = i;
+        pthread_create(&threads[i], NULL, writer, &args[i]);
+    }
+    for (int i = 0; i < 8; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    mu_assert("error, expecting 1600 items", w->table->count == 1600);
+    mu_assert("error, expecting shared commits", w->commits < 1600);
+    ht_wal_close(w);
+    w = ht_wal_open(log_path, 1, 0);
+    mu_assert("error, expecting 1600 replayed items", w->table->count == 1600);
+    mu_assert("error, item lost", value_is(w, "t7:199", "value"));
+    ht_wal_close(w);
+    return 0;
+}
+
+
+static char* test_failed_write() {
+    printf("*** test_failed_write\n");
+    remove_logs();
+    ht_wal* w = ht_wal_open(log_path, 1, 0);
+    mu_assert("error, insert failed", ht_wal_insert(w, "a", "1") == 0);
+    // Every write to the log now fails with ENOSPC
+    const int full = open("/dev/full", O_WRONLY | O_CLOEXEC);
+    mu_assert("error, /dev/full not opened", full >= 0);
+    dup2(full, w->fd);
+    close(full);
+    mu_assert("error, expecting a failed insert", ht_wal_insert(w, "a", "2") == -1);
+    mu_assert("error, expecting a failed delete", ht_wal_delete(w, "a") == -1);
+    mu_assert("error, lost change applied", value_is(w, "a", "1") && w->table->count == 1);
+    mu_assert("error, failed log accepted a write", ht_wal_insert(w, "b", "1") == -1);
+    ht_wal_close(w);
+    return 0;
+}
+
+
+static char* all_tests() {
+    printf("*** Runnng all tests...\n");
+    mu_run_test(test_replay);
+    mu_run_test(test_torn_tail);
+    mu_run_test(test_checkpoint);
+    mu_run_test(test_group_commit);
+    mu_run_test(test_failed_write);
+    return 0;
+}
+
+
+int main() {
+    printf("*** Write-Ahead Log Unit tests\n");
+    if (mkdtemp(dir) == NULL) {
+        return 1;
+    }
+    snprintf(log_path, sizeof(log_path), "%s/log", dir);
+    snprintf(ckpt_path, sizeof(ckpt_path), "%s/log.ckpt", dir);
+    char* result = all_tests();
+    remove_logs();
+    rmdir(dir);
+    if (result != 0) {
+        printf("%s\n", result);
+    } else {
+        printf("all tests passed\n");
+    }
+    printf("%d tests run\n", tests_run);
+    return result != 0;
+}